@@ -0,0 +1,290 @@
+#include "tga/tga.hpp"
+#include "tga/tga_vulkan/tga_vulkan.hpp"
+
+#include <chrono>
+#include <sstream>
+
+//Microbenchmarks for the hot paths of the Vulkan backend
+//usage: tga_bench [--window] [--iterations N] [--output results.json]
+//Results are written as a JSON array, one object per measurement
+
+struct Timer
+{
+    Timer():startTime(std::chrono::high_resolution_clock::now())
+    {}
+    void reset()
+    {
+      startTime = std::chrono::high_resolution_clock::now();
+    }
+    double deltaTimeMicro()
+    {
+      auto endTime = std::chrono::high_resolution_clock::now();
+      return std::chrono::duration<double,std::micro>(endTime-startTime).count();
+    }
+    private:
+    std::chrono::high_resolution_clock::time_point startTime;
+};
+
+static std::vector<char> readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+    size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    file.close();
+    return buffer;
+}
+
+struct Result{
+    std::string benchmark;
+    std::string variant;
+    size_t bytes;
+    std::vector<double> samplesMicro;
+    uint32_t opsPerSample;
+};
+
+class Bench{
+    tga::TGAVulkan tgav;
+    bool windowed;
+    uint32_t iterations;
+    std::vector<Result> results;
+    tga::Shader vertShader;
+    tga::Shader fragShader;
+    tga::Shader textureShader;
+
+    public:
+    Bench(bool _windowed, uint32_t _iterations):
+        tgav(tga::TGAVulkanInfo(!_windowed,false,false,false)),windowed(_windowed),iterations(_iterations)
+    {
+        vertShader = loadShader("shaders/rectangleVert.spv",tga::ShaderType::vertex);
+        fragShader = loadShader("shaders/rectangleFrag.spv",tga::ShaderType::fragment);
+        textureShader = loadShader("shaders/textureFrag.spv",tga::ShaderType::fragment);
+    }
+
+    ~Bench()
+    {
+        tgav.free(vertShader);
+        tgav.free(fragShader);
+        tgav.free(textureShader);
+    }
+
+    tga::Shader loadShader(const std::string& filename, tga::ShaderType type)
+    {
+        auto shaderData = readFile(filename);
+        return tgav.createShader({type,(uint8_t*)shaderData.data(),shaderData.size()});
+    }
+
+    void run()
+    {
+        benchCreateBuffer();
+        benchCreateTexture();
+        benchUpdateBuffer();
+        benchCreateRenderPass();
+        benchDrawRecording();
+        benchCreateInputSet();
+        benchPresent();
+    }
+
+    void benchCreateBuffer()
+    {
+        for(size_t size : {size_t(256),size_t(4096),size_t(65536),size_t(1)<<20,size_t(16)<<20}){
+            std::vector<uint8_t> data(size,1);
+            Result result{"createBuffer","with_data",size,{},1};
+            for(uint32_t i = 0; i < iterations; i++){
+                Timer timer;
+                auto buffer = tgav.createBuffer({tga::BufferUsage::vertex,data.data(),data.size()});
+                result.samplesMicro.push_back(timer.deltaTimeMicro());
+                tgav.free(buffer);
+            }
+            results.push_back(result);
+        }
+    }
+
+    void benchCreateTexture()
+    {
+        for(uint32_t extent : {64u,256u,1024u,2048u}){
+            std::vector<uint8_t> data(size_t(extent)*extent*4,1);
+            Result result{"createTexture","r8g8b8a8_unorm",data.size(),{},1};
+            for(uint32_t i = 0; i < iterations; i++){
+                Timer timer;
+                auto texture = tgav.createTexture({extent,extent,data.data(),data.size(),tga::Format::r8g8b8a8_unorm});
+                result.samplesMicro.push_back(timer.deltaTimeMicro());
+                tgav.free(texture);
+            }
+            results.push_back(result);
+        }
+    }
+
+    void benchUpdateBuffer()
+    {
+        //Sizes up to 64KiB that are a multiple of 4 take the quick path, all others go through a staging buffer
+        std::vector<std::pair<size_t,std::string>> cases{{256,"quick"},{4096,"quick"},{65536,"quick"},
+            {65540,"staging"},{size_t(1)<<20,"staging"},{size_t(16)<<20,"staging"}};
+        for(auto &[size, path] : cases){
+            std::vector<uint8_t> data(size,1);
+            auto buffer = tgav.createBuffer({tga::BufferUsage::uniform,nullptr,size});
+            Result result{"updateBuffer",path,size,{},1};
+            for(uint32_t i = 0; i < iterations; i++){
+                Timer timer;
+                tgav.updateBuffer(buffer,data.data(),data.size(),0);
+                result.samplesMicro.push_back(timer.deltaTimeMicro());
+            }
+            tgav.free(buffer);
+            results.push_back(result);
+        }
+    }
+
+    void benchCreateRenderPass()
+    {
+        auto target = tgav.createTexture({256,256,nullptr,0,tga::Format::r8g8b8a8_unorm});
+        Result result{"createRenderPass","vertex_fragment",0,{},1};
+        for(uint32_t i = 0; i < iterations; i++){
+            Timer timer;
+            auto renderPass = tgav.createRenderPass({{vertShader,fragShader},target});
+            result.samplesMicro.push_back(timer.deltaTimeMicro());
+            tgav.free(renderPass);
+        }
+        results.push_back(result);
+        tgav.free(target);
+    }
+
+    void benchDrawRecording()
+    {
+        const uint32_t drawCount = 10000;
+        auto target = tgav.createTexture({256,256,nullptr,0,tga::Format::r8g8b8a8_unorm});
+        auto renderPass = tgav.createRenderPass({{vertShader,fragShader},target});
+        std::vector<uint32_t> indices{0,1,2};
+        auto indexBuffer = tgav.createBuffer({tga::BufferUsage::index,(uint8_t*)indices.data(),indices.size()*sizeof(uint32_t)});
+
+        Result drawResult{"recordDraw","draw",0,{},drawCount};
+        Result indexedResult{"recordDraw","drawIndexed",0,{},drawCount};
+        for(uint32_t i = 0; i < iterations; i++){
+            tgav.beginCommandBuffer({});
+            tgav.setRenderPass(renderPass,0);
+            Timer timer;
+            for(uint32_t d = 0; d < drawCount; d++)
+                tgav.draw(3,0);
+            drawResult.samplesMicro.push_back(timer.deltaTimeMicro());
+            tgav.bindIndexBuffer(indexBuffer);
+            timer.reset();
+            for(uint32_t d = 0; d < drawCount; d++)
+                tgav.drawIndexed(3,0,0);
+            indexedResult.samplesMicro.push_back(timer.deltaTimeMicro());
+            tgav.free(tgav.endCommandBuffer());
+        }
+        results.push_back(drawResult);
+        results.push_back(indexedResult);
+        tgav.free(indexBuffer);
+        tgav.free(renderPass);
+        tgav.free(target);
+    }
+
+    void benchCreateInputSet()
+    {
+        auto target = tgav.createTexture({256,256,nullptr,0,tga::Format::r8g8b8a8_unorm});
+        auto sampled = tgav.createTexture({256,256,nullptr,0,tga::Format::r8g8b8a8_unorm});
+        tga::RenderPassInfo passInfo({vertShader,textureShader},target);
+        passInfo.inputLayout.setLayouts.emplace_back(tga::SetLayout({{tga::BindingType::sampler2D,1}}));
+        auto renderPass = tgav.createRenderPass(passInfo);
+        Result result{"createInputSet","sampler2D",0,{},1};
+        for(uint32_t i = 0; i < iterations; i++){
+            Timer timer;
+            auto inputSet = tgav.createInputSet({renderPass,0,{{sampled,0,0}}});
+            result.samplesMicro.push_back(timer.deltaTimeMicro());
+            tgav.free(inputSet);
+        }
+        results.push_back(result);
+        tgav.free(renderPass);
+        tgav.free(sampled);
+        tgav.free(target);
+    }
+
+    void benchPresent()
+    {
+        if(!windowed)
+            return;
+        auto window = tgav.createWindow({1280,720,tga::PresentMode::immediate});
+        auto renderPass = tgav.createRenderPass({{vertShader,fragShader},window,{},tga::ClearOperation::all});
+        std::vector<tga::CommandBuffer> cmdBuffers{};
+        for(uint32_t i = 0; i < tgav.backbufferCount(window); i++){
+            tgav.beginCommandBuffer({});
+            tgav.setRenderPass(renderPass,i);
+            tgav.draw(3,0);
+            cmdBuffers.emplace_back(tgav.endCommandBuffer());
+        }
+        Result result{"present","immediate",0,{},1};
+        for(uint32_t i = 0; i < iterations; i++){
+            auto frame = tgav.nextFrame(window);
+            tgav.execute(cmdBuffers[frame]);
+            Timer timer;
+            tgav.present(window);
+            result.samplesMicro.push_back(timer.deltaTimeMicro());
+        }
+        results.push_back(result);
+        for(auto &cmdBuffer : cmdBuffers)
+            tgav.free(cmdBuffer);
+        tgav.free(renderPass);
+        tgav.free(window);
+    }
+
+    void write(std::ostream &out)
+    {
+        out << "[\n";
+        for(size_t r = 0; r < results.size(); r++){
+            auto samples = results[r].samplesMicro;
+            std::sort(samples.begin(),samples.end());
+            double sum = 0;
+            for(auto sample : samples)
+                sum += sample;
+            double mean = samples.empty()?0:sum/samples.size();
+            auto percentile = [&](double p){return samples.empty()?0:samples[size_t(p*(samples.size()-1))];};
+            double perOp = mean/results[r].opsPerSample;
+            out << "  {\"benchmark\": \"" << results[r].benchmark << "\", \"variant\": \"" << results[r].variant
+                << "\", \"bytes\": " << results[r].bytes << ", \"samples\": " << samples.size()
+                << ", \"ops_per_sample\": " << results[r].opsPerSample
+                << ", \"mean_us\": " << mean << ", \"median_us\": " << percentile(0.5)
+                << ", \"p95_us\": " << percentile(0.95) << ", \"min_us\": " << percentile(0)
+                << ", \"per_op_us\": " << perOp;
+            if(results[r].bytes > 0 && mean > 0)
+                out << ", \"mib_per_s\": " << (double(results[r].bytes)/(1024.*1024.))/(mean/1e6);
+            out << "}" << (r+1 < results.size()?",":"") << '\n';
+        }
+        out << "]\n";
+    }
+};
+
+int main(int argc, char **argv)
+{
+    bool windowed = false;
+    uint32_t iterations = 50;
+    std::string output{};
+    for(int i = 1; i < argc; i++){
+        std::string arg(argv[i]);
+        if(arg == "--window")
+            windowed = true;
+        else if(arg == "--iterations" && i+1 < argc)
+            iterations = uint32_t(std::stoul(argv[++i]));
+        else if(arg == "--output" && i+1 < argc)
+            output = argv[++i];
+    }
+    try
+    {
+        Bench bench(windowed,iterations);
+        bench.run();
+        if(output.empty()){
+            bench.write(std::cout);
+        }
+        else{
+            std::ofstream file(output);
+            bench.write(file);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+}
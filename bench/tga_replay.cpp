@@ -0,0 +1,39 @@
+#include "tga/tga.hpp"
+#include "tga/tga_vulkan/tga_vulkan.hpp"
+#include "tga/tga_capture.hpp"
+
+//Replays a capture written by tga::CaptureInterface against TGAVulkan as fast as possible
+//usage: tga_replay capture.tgacap [--headless] [--repeat N]
+//--headless only replays captures that never create a window, others are rejected at their first createWindow
+int main(int argc, char **argv)
+{
+    if(argc < 2){
+        std::cerr << "usage: tga_replay capture.tgacap [--headless] [--repeat N]\n";
+        return 1;
+    }
+    std::string captureFile(argv[1]);
+    bool headless = false;
+    uint32_t repeat = 1;
+    for(int i = 2; i < argc; i++){
+        std::string arg(argv[i]);
+        if(arg == "--headless")
+            headless = true;
+        else if(arg == "--repeat" && i+1 < argc)
+            repeat = uint32_t(std::stoul(argv[++i]));
+    }
+    try
+    {
+        tga::TGAVulkan tgav(tga::TGAVulkanInfo(headless,false,false,false));
+        std::cout << "run,calls,frames,payload_bytes,frame_divergences,seconds,calls_per_second\n";
+        for(uint32_t run = 0; run < repeat; run++){
+            auto stats = tga::replayCapture(tgav,captureFile);
+            std::cout << run << ',' << stats.calls << ',' << stats.frames << ',' << stats.payloadBytes << ','
+                << stats.frameDivergences << ',' << stats.seconds << ',' << (stats.seconds > 0?stats.calls/stats.seconds:0.) << '\n';
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,280 @@
+#include "tga/tga.hpp"
+#include "tga/tga_vulkan/tga_vulkan.hpp"
+
+#include <chrono>
+#include <sstream>
+
+//Scene scale stress test, sweeps object, material, texture and pass counts one at a time
+//usage: tga_stress [--window] [--frames N] [--extent N] [--output results.csv] [--trace trace.json]
+//Every frame re-records its command buffer like an application with a dynamic scene would
+//Headless, a frame ends when a readback submitted after it has completed
+
+struct Timer
+{
+    Timer():startTime(std::chrono::high_resolution_clock::now())
+    {}
+    void reset()
+    {
+      startTime = std::chrono::high_resolution_clock::now();
+    }
+    double deltaTimeMilli()
+    {
+      auto endTime = std::chrono::high_resolution_clock::now();
+      return std::chrono::duration<double,std::milli>(endTime-startTime).count();
+    }
+    private:
+    std::chrono::high_resolution_clock::time_point startTime;
+};
+
+static std::vector<char> readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+    size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    file.close();
+    return buffer;
+}
+
+struct SceneConfig{
+    uint32_t objects;
+    uint32_t materials;
+    uint32_t textures;
+    uint32_t passes;
+};
+
+struct Percentiles{
+    double p50, p95, p99;
+};
+
+static Percentiles percentiles(std::vector<double> samples)
+{
+    if(samples.empty())
+        return {0,0,0};
+    std::sort(samples.begin(),samples.end());
+    auto at = [&](double p){return samples[size_t(p*(samples.size()-1)+0.5)];};
+    return {at(0.5),at(0.95),at(0.99)};
+}
+
+struct ConfigResult{
+    SceneConfig config;
+    double setupMilli;
+    Percentiles frame;
+    Percentiles record;
+};
+
+class Stress{
+    tga::TGAVulkan tgav;
+    bool windowed;
+    uint32_t frames;
+    uint32_t warmupFrames;
+    uint32_t extent;
+    tga::Shader vertShader;
+    tga::Shader textureShader;
+
+    public:
+    Stress(bool _windowed, uint32_t _frames, uint32_t _extent, bool tracing):
+        tgav(tga::TGAVulkanInfo(!_windowed,false,tracing,false)),windowed(_windowed),frames(_frames),warmupFrames(10),extent(_extent)
+    {
+        vertShader = loadShader("shaders/rectangleVert.spv",tga::ShaderType::vertex);
+        textureShader = loadShader("shaders/textureFrag.spv",tga::ShaderType::fragment);
+    }
+
+    ~Stress()
+    {
+        tgav.free(vertShader);
+        tgav.free(textureShader);
+    }
+
+    tga::Shader loadShader(const std::string& filename, tga::ShaderType type)
+    {
+        auto shaderData = readFile(filename);
+        return tgav.createShader({type,(uint8_t*)shaderData.data(),shaderData.size()});
+    }
+
+    void writeTrace(const std::string &fileName)
+    {
+        tgav.writeTrace(fileName);
+    }
+
+    ConfigResult run(const SceneConfig &config)
+    {
+        Timer setupTimer;
+        std::vector<uint8_t> texels(64*64*4);
+        std::vector<tga::Texture> textures{};
+        for(uint32_t t = 0; t < config.textures; t++){
+            std::fill(texels.begin(),texels.end(),uint8_t(t*37));
+            textures.push_back(tgav.createTexture({64,64,texels.data(),texels.size(),tga::Format::r8g8b8a8_unorm}));
+        }
+
+        //Every object draws one triangle, the vertex shader derives the positions from the vertex index
+        std::vector<uint32_t> indices(size_t(config.objects)*3);
+        for(size_t i = 0; i < indices.size(); i++)
+            indices[i] = uint32_t(i%3);
+        auto indexBuffer = tgav.createBuffer({tga::BufferUsage::index,(uint8_t*)indices.data(),indices.size()*sizeof(uint32_t)});
+
+        //The first passes render offscreen, the last one into the window when there is one
+        tga::Window window{};
+        std::vector<tga::Texture> targets{};
+        std::vector<tga::RenderPass> renderPasses{};
+        if(windowed)
+            window = tgav.createWindow({extent,extent,tga::PresentMode::immediate});
+        for(uint32_t p = 0; p < config.passes; p++){
+            std::variant<tga::Texture,tga::Window> renderTarget;
+            if(windowed && p+1 == config.passes){
+                renderTarget = window;
+            }
+            else{
+                targets.push_back(tgav.createTexture({extent,extent,nullptr,0,tga::Format::r8g8b8a8_unorm}));
+                renderTarget = targets.back();
+            }
+            tga::RenderPassInfo passInfo({vertShader,textureShader},renderTarget,{},tga::ClearOperation::all);
+            passInfo.inputLayout.setLayouts.emplace_back(tga::SetLayout({{tga::BindingType::sampler2D,1}}));
+            renderPasses.push_back(tgav.createRenderPass(passInfo));
+        }
+
+        //A material is an input set per pass that samples one of the textures
+        std::vector<std::vector<tga::InputSet>> materials(config.passes);
+        for(uint32_t p = 0; p < config.passes; p++)
+            for(uint32_t m = 0; m < config.materials; m++)
+                materials[p].push_back(tgav.createInputSet({renderPasses[p],0,{{textures[m%config.textures],0,0}}}));
+
+        //Fence buffer for headless frame synchronization
+        auto syncBuffer = tgav.createBuffer({tga::BufferUsage::uniform,nullptr,4});
+        double setupMilli = setupTimer.deltaTimeMilli();
+
+        std::vector<double> frameTimes{};
+        std::vector<double> recordTimes{};
+        //Objects are sorted by material, the way a renderer batches its draws
+        uint32_t objectsPerPass = std::max(config.objects/config.passes,1u);
+        for(uint32_t frame = 0; frame < warmupFrames+frames; frame++){
+            Timer frameTimer;
+            uint32_t framebufferIndex = windowed?tgav.nextFrame(window):0;
+
+            Timer recordTimer;
+            tgav.beginCommandBuffer({});
+            for(uint32_t p = 0; p < config.passes; p++){
+                tgav.setRenderPass(renderPasses[p],(windowed && p+1 == config.passes)?framebufferIndex:0);
+                tgav.bindIndexBuffer(indexBuffer);
+                uint32_t boundMaterial = ~0u;
+                for(uint32_t o = 0; o < objectsPerPass; o++){
+                    uint32_t material = uint32_t(uint64_t(o)*config.materials/objectsPerPass);
+                    if(material != boundMaterial){
+                        tgav.bindInputSet(materials[p][material]);
+                        boundMaterial = material;
+                    }
+                    tgav.drawIndexed(3,((p*objectsPerPass+o)%config.objects)*3,0);
+                }
+            }
+            auto cmdBuffer = tgav.endCommandBuffer();
+            double recordMilli = recordTimer.deltaTimeMilli();
+
+            tgav.execute(cmdBuffer);
+            if(windowed){
+                tgav.present(window);
+            }
+            else{
+                auto readback = tgav.readBuffer(syncBuffer,4,0);
+                tgav.readbackData(readback);
+                tgav.free(readback);
+            }
+            tgav.free(cmdBuffer);
+
+            if(frame >= warmupFrames){
+                frameTimes.push_back(frameTimer.deltaTimeMilli());
+                recordTimes.push_back(recordMilli);
+            }
+        }
+
+        tgav.free(syncBuffer);
+        for(auto &passMaterials : materials)
+            for(auto &inputSet : passMaterials)
+                tgav.free(inputSet);
+        for(auto &renderPass : renderPasses)
+            tgav.free(renderPass);
+        for(auto &target : targets)
+            tgav.free(target);
+        if(windowed)
+            tgav.free(window);
+        tgav.free(indexBuffer);
+        for(auto &texture : textures)
+            tgav.free(texture);
+
+        return {config,setupMilli,percentiles(frameTimes),percentiles(recordTimes)};
+    }
+};
+
+static void writeCSV(std::ostream &out, const std::vector<ConfigResult> &results)
+{
+    out << "objects,materials,textures,passes,setup_ms,frame_p50_ms,frame_p95_ms,frame_p99_ms,record_p50_ms,record_p95_ms,record_p99_ms\n";
+    for(auto &result : results){
+        out << result.config.objects << ',' << result.config.materials << ',' << result.config.textures << ','
+            << result.config.passes << ',' << result.setupMilli << ','
+            << result.frame.p50 << ',' << result.frame.p95 << ',' << result.frame.p99 << ','
+            << result.record.p50 << ',' << result.record.p95 << ',' << result.record.p99 << '\n';
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool windowed = false;
+    uint32_t frames = 200;
+    uint32_t extent = 256;
+    std::string output{};
+    std::string trace{};
+    for(int i = 1; i < argc; i++){
+        std::string arg(argv[i]);
+        if(arg == "--window")
+            windowed = true;
+        else if(arg == "--frames" && i+1 < argc)
+            frames = uint32_t(std::stoul(argv[++i]));
+        else if(arg == "--extent" && i+1 < argc)
+            extent = uint32_t(std::stoul(argv[++i]));
+        else if(arg == "--output" && i+1 < argc)
+            output = argv[++i];
+        else if(arg == "--trace" && i+1 < argc)
+            trace = argv[++i];
+    }
+
+    //Each sweep scales one dimension of the base scene up to production like sizes
+    const SceneConfig base{1000,16,16,1};
+    std::vector<SceneConfig> configs{base};
+    for(uint32_t objects : {100u,10000u,50000u,200000u})
+        configs.push_back({objects,base.materials,base.textures,base.passes});
+    for(uint32_t materials : {1u,128u,1024u})
+        configs.push_back({base.objects,materials,base.textures,base.passes});
+    for(uint32_t textures : {1u,256u,2048u})
+        configs.push_back({base.objects,base.materials,textures,base.passes});
+    for(uint32_t passes : {2u,4u,8u})
+        configs.push_back({base.objects,base.materials,base.textures,passes});
+
+    try
+    {
+        Stress stress(windowed,frames,extent,!trace.empty());
+        std::vector<ConfigResult> results{};
+        for(auto &config : configs){
+            results.push_back(stress.run(config));
+            auto &result = results.back();
+            std::cerr << "objects " << config.objects << " materials " << config.materials << " textures " << config.textures
+                << " passes " << config.passes << ": frame p50 " << result.frame.p50 << "ms p99 " << result.frame.p99
+                << "ms, record p50 " << result.record.p50 << "ms\n";
+        }
+        if(!trace.empty())
+            stress.writeTrace(trace);
+        if(output.empty()){
+            writeCSV(std::cout,results);
+        }
+        else{
+            std::ofstream file(output);
+            writeCSV(file,results);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+}
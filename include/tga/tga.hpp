@@ -204,6 +204,31 @@ namespace tga
         TgaCommandBuffer handle;
     };
 
+    struct Readback{
+        Readback():handle(TGA_NULL_HANDLE){}
+        Readback(std::nullptr_t):handle(TGA_NULL_HANDLE){}
+        Readback(TgaReadback tgaReadback):handle(tgaReadback){}
+        Readback& operator=(TgaReadback tgaReadback)
+        {
+            handle = tgaReadback;
+            return *this;
+        }
+        operator TgaReadback() const
+        {
+            return handle;
+        }
+        explicit operator bool() const
+        {
+            return handle != TGA_NULL_HANDLE;
+        }
+        bool operator !() const
+        {
+            return handle == TGA_NULL_HANDLE;
+        }
+        private:
+        TgaReadback handle;
+    };
+
     //enum classes
     enum class ShaderType{
         undefined,
@@ -221,7 +246,8 @@ namespace tga
         undefined = 0x0,
         uniform = 0x1,
         vertex = 0x2,
-        index = 0x4
+        index = 0x4,
+        storage = 0x8
     };
     inline BufferUsage operator|(BufferUsage a, BufferUsage b)
     {
@@ -272,6 +298,26 @@ namespace tga
         r8g8b8a8_srgb,
         r8g8b8a8_unorm,
         r8g8b8a8_snorm,
+        r16_uint,
+        r16_sint,
+        r16_unorm,
+        r16_snorm,
+        r16_sfloat,
+        r16g16_uint,
+        r16g16_sint,
+        r16g16_unorm,
+        r16g16_snorm,
+        r16g16_sfloat,
+        r16g16b16_uint,
+        r16g16b16_sint,
+        r16g16b16_unorm,
+        r16g16b16_snorm,
+        r16g16b16_sfloat,
+        r16g16b16a16_uint,
+        r16g16b16a16_sint,
+        r16g16b16a16_unorm,
+        r16g16b16a16_snorm,
+        r16g16b16a16_sfloat,
         r32_uint,
         r32_sint,
         r32_sfloat,
@@ -283,7 +329,16 @@ namespace tga
         r32g32b32_sfloat,
         r32g32b32a32_uint,
         r32g32b32a32_sint,
-        r32g32b32a32_sfloat
+        r32g32b32a32_sfloat,
+        a2b10g10r10_uint_pack32,
+        a2b10g10r10_unorm_pack32,
+        a2b10g10r10_snorm_pack32,
+        b10g11r11_ufloat_pack32
+    };
+
+    enum class IndexType{
+        uint32,
+        uint16
     };
 
     enum class CompareOperation{
@@ -311,9 +366,39 @@ namespace tga
         all
     };
 
+    //Multisampled passes render into per pass attachments that are resolved into the targets at the end of the pass.
+    //Multisampled passes have to clear their color targets, the previous content of the targets is not loaded.
+    //Counts the device does not support fall back to the highest supported one
+    enum class SampleCount{
+        x1,
+        x2,
+        x4,
+        x8
+    };
+
+    enum class DepthFormat{
+        automatic, //No depth when the pass does not test depth, otherwise the most precise supported format
+        none,
+        d16,
+        d32
+    };
+
+    enum class LoadOperation{
+        load,
+        clear,
+        discard
+    };
+
+    enum class StoreOperation{
+        store,
+        discard
+    };
+
     enum class BindingType{
         uniformBuffer,
-        sampler2D
+        sampler2D,
+        inputAttachment,
+        storageBuffer
     };
 
     enum class CullMode{
@@ -366,6 +451,32 @@ namespace tga
             frontFace(_frontFace),cullMode(_cullMode),polygonMode(_polygonMode){}
     };
 
+    //Depth that is neither loaded nor stored lives in transient memory shared by all passes with the same extent and format,
+    //depth that is kept between passes belongs to the render target. ClearOperation::depth and ::all override the load operation
+    struct DepthConfig{
+        DepthFormat format;
+        LoadOperation loadOperation;
+        StoreOperation storeOperation;
+        DepthConfig(DepthFormat _format = DepthFormat::automatic, LoadOperation _loadOperation = LoadOperation::load,
+                    StoreOperation _storeOperation = StoreOperation::store):
+            format(_format),loadOperation(_loadOperation),storeOperation(_storeOperation){}
+    };
+
+    //A further texture written by the same pass. ClearOperation::color and ::all override the load operation
+    struct ColorTarget{
+        Texture texture;
+        LoadOperation loadOperation;
+        StoreOperation storeOperation;
+        bool blendEnabled;
+        BlendFactor srcBlend;
+        BlendFactor dstBlend;
+        ColorTarget(Texture _texture = Texture(), LoadOperation _loadOperation = LoadOperation::load,
+                    StoreOperation _storeOperation = StoreOperation::store, bool _blendEnabled = false,
+                    BlendFactor _srcBlend = BlendFactor::srcAlpha, BlendFactor _dstBlend = BlendFactor::oneMinusSrcAlpha):
+            texture(_texture),loadOperation(_loadOperation),storeOperation(_storeOperation),blendEnabled(_blendEnabled),
+            srcBlend(_srcBlend),dstBlend(_dstBlend){}
+    };
+
     struct BindingLayout{
         BindingType type;
         uint32_t count;
@@ -382,6 +493,23 @@ namespace tga
         InputLayout(const std::vector<SetLayout> &_setLayouts = {}):setLayouts(_setLayouts){}
     };
 
+    //Attachment 0 is the render target, followed by the additional targets and then the intermediate attachments of the render pass.
+    //Input attachments are bound by the render pass in the set after the ones of inputLayout, binding and
+    //input_attachment_index i refer to inputAttachments[i]
+    struct SubpassInfo{
+        std::vector<Shader> shaderStages;
+        std::vector<uint32_t> colorAttachments;
+        std::vector<uint32_t> inputAttachments;
+        VertexLayout vertexLayout;
+        RasterizerConfig rasterizerConfig;
+        InputLayout inputLayout;
+        SubpassInfo(std::vector<Shader> const &_shaderStages = std::vector<Shader>(), std::vector<uint32_t> const &_colorAttachments = {0},
+                    std::vector<uint32_t> const &_inputAttachments = {}, VertexLayout _vertexLayout = VertexLayout(),
+                    RasterizerConfig _rasterizerConfig = RasterizerConfig(), InputLayout _inputLayout = InputLayout()):
+            shaderStages(_shaderStages),colorAttachments(_colorAttachments),inputAttachments(_inputAttachments),
+            vertexLayout(_vertexLayout),rasterizerConfig(_rasterizerConfig),inputLayout(_inputLayout){}
+    };
+
     struct Binding{
         std::variant<Buffer, Texture> resource;
         uint32_t slot;
@@ -425,23 +553,38 @@ namespace tga
                 SamplerMode _samplerMode = SamplerMode::nearest, RepeatMode _repeateMode = RepeatMode::clampBorder):
         width(_width), height(_height), data(_data.data()), dataSize(_data.size()), format(_format), samplerMode(_samplerMode),repeatMode(_repeateMode){}
     };
+    //What a texture was created with
+    struct TextureProperties{
+        uint32_t width;
+        uint32_t height;
+        Format format;
+    };
+    //nextFrame waits until at most maxQueuedFrames presented frames are still executing, 0 lets present wait for its frame.
+    //Data a queued frame reads must not change before that wait, e.g. by keeping one uniform buffer per queued frame.
+    //frameRateLimit additionally spaces the returns of nextFrame on the CPU, 0 does not limit
     struct WindowInfo{
         uint32_t width;
         uint32_t height;
         PresentMode presentMode;
         uint32_t framebufferCount;
-        WindowInfo(uint32_t _width = 0, uint32_t _height = 0, PresentMode _presentMode = PresentMode::immediate,uint32_t _framebufferCount=0):
-            width(_width), height(_height), presentMode(_presentMode),framebufferCount(_framebufferCount){}
+        uint32_t maxQueuedFrames;
+        uint32_t frameRateLimit;
+        WindowInfo(uint32_t _width = 0, uint32_t _height = 0, PresentMode _presentMode = PresentMode::immediate,uint32_t _framebufferCount=0,
+                    uint32_t _maxQueuedFrames = 0, uint32_t _frameRateLimit = 0):
+            width(_width), height(_height), presentMode(_presentMode),framebufferCount(_framebufferCount),
+            maxQueuedFrames(_maxQueuedFrames),frameRateLimit(_frameRateLimit){}
     };
 
     struct InputSetInfo{
         RenderPass targetRenderPass;
         uint32_t setIndex;
         std::vector<Binding> bindings;
-        InputSetInfo(RenderPass _targetRenderPass,uint32_t _setIndex, std::vector<Binding> const &_bindings):
-            targetRenderPass(_targetRenderPass),setIndex(_setIndex),bindings(_bindings){}
+        uint32_t subpass;
+        InputSetInfo(RenderPass _targetRenderPass,uint32_t _setIndex, std::vector<Binding> const &_bindings, uint32_t _subpass = 0):
+            targetRenderPass(_targetRenderPass),setIndex(_setIndex),bindings(_bindings),subpass(_subpass){}
     };
 
+    //A pass whose only shader stage is a compute shader is a compute pass, it has no render target and records dispatches
     struct RenderPassInfo{
         std::vector<Shader> shaderStages;
         std::variant<Texture, Window> renderTarget;
@@ -449,15 +592,34 @@ namespace tga
         VertexLayout vertexLayout;
         RasterizerConfig rasterizerConfig;
         InputLayout inputLayout;
+        DepthConfig depthConfig;
+        //Intermediate attachments only live inside the render pass and have the extent of the render target.
+        //Without subpasses the pass has a single one made of shaderStages, vertexLayout, rasterizerConfig and inputLayout
+        std::vector<Format> intermediateAttachments;
+        std::vector<SubpassInfo> subpasses;
+        //Written next to the render target, e.g. the layers of a G-buffer. They need the extent of the render target
+        std::vector<ColorTarget> additionalTargets;
+        SampleCount sampleCount;
         RenderPassInfo(std::vector<Shader> const &_shaderStages = std::vector<Shader>(), 
                     std::variant<Texture, Window> _renderTarget = Texture(), VertexLayout _vertexLayout = VertexLayout(),
                     ClearOperation _clearOperations = ClearOperation::none,
-                    RasterizerConfig _rasterizerConfig = RasterizerConfig(), InputLayout _inputLayout = InputLayout()):
+                    RasterizerConfig _rasterizerConfig = RasterizerConfig(), InputLayout _inputLayout = InputLayout(),
+                    DepthConfig _depthConfig = DepthConfig(), std::vector<Format> const &_intermediateAttachments = {},
+                    std::vector<SubpassInfo> const &_subpasses = {}, std::vector<ColorTarget> const &_additionalTargets = {},
+                    SampleCount _sampleCount = SampleCount::x1):
             shaderStages(_shaderStages),renderTarget(_renderTarget),clearOperations(_clearOperations),
-            vertexLayout(_vertexLayout),rasterizerConfig(_rasterizerConfig),inputLayout(_inputLayout){}
+            vertexLayout(_vertexLayout),rasterizerConfig(_rasterizerConfig),inputLayout(_inputLayout),depthConfig(_depthConfig),
+            intermediateAttachments(_intermediateAttachments),subpasses(_subpasses),additionalTargets(_additionalTargets),
+            sampleCount(_sampleCount){}
     };
+    //Async compute command buffers contain only compute passes and run on a dedicated compute queue where the device has one.
+    //Later graphics command buffers wait for their results unless they are created with waitsForCompute = false,
+    //those overlap with the compute work and must not use its buffers or the textures it samples
     struct CommandBufferInfo{
-        CommandBufferInfo(){}
+        bool asyncCompute;
+        bool waitsForCompute;
+        CommandBufferInfo(bool _asyncCompute = false, bool _waitsForCompute = true):
+            asyncCompute(_asyncCompute),waitsForCompute(_waitsForCompute){}
     };
 
     //What you interact with
@@ -475,16 +637,26 @@ namespace tga
         //Commands
         virtual void beginCommandBuffer(const CommandBufferInfo &commandBufferInfo) = 0;
         virtual void setRenderPass(RenderPass renderPass, uint32_t framebufferIndex) = 0;
+        virtual void nextSubpass() = 0;
         virtual void bindVertexBuffer(Buffer buffer) = 0;
-        virtual void bindIndexBuffer(Buffer buffer) = 0;
+        virtual void bindIndexBuffer(Buffer buffer, IndexType indexType = IndexType::uint32) = 0;
         virtual void bindInputSet(InputSet inputSet) = 0;
         virtual void draw(uint32_t vertexCount, uint32_t firstVertex) = 0;
         virtual void drawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset) = 0;                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                             
+        virtual void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) = 0;
         virtual CommandBuffer endCommandBuffer() = 0;
         virtual void execute(CommandBuffer commandBuffer) = 0;
 
         virtual void updateBuffer(Buffer buffer, uint8_t const *data, size_t dataSize, uint32_t offset) = 0;
 
+        //Readback, the copy is submitted right away and the data stays valid until the Readback is freed
+        virtual Readback readBuffer(Buffer buffer, size_t dataSize, uint32_t offset) = 0;
+        virtual Readback readTexture(Texture texture) = 0;
+        virtual bool readbackReady(Readback readback) = 0;
+        virtual std::pair<uint8_t const*, size_t> readbackData(Readback readback) = 0;
+
+        virtual TextureProperties textureProperties(Texture texture) = 0;
+
         //Window functions;
         virtual uint32_t backbufferCount(Window window) = 0;
         virtual uint32_t nextFrame(Window window) = 0;
@@ -494,6 +666,11 @@ namespace tga
         virtual bool windowShouldClose(Window window) = 0;
         virtual bool keyDown(Window window, Key key) = 0;
         virtual std::pair<int, int> mousePosition(Window window) = 0;
+        //Pumps window system events without waiting for a backbuffer, nextFrame pumps as well.
+        //Events are buffered per window until they are taken, oldest first
+        virtual void pollInput() = 0;
+        virtual std::vector<InputEvent> takeInputEvents(Window window) = 0;
+        virtual InputSnapshot inputSnapshot(Window window) = 0;
 
 
         //Freedom
@@ -504,5 +681,6 @@ namespace tga
         virtual void free(InputSet inputSet) = 0;
         virtual void free(RenderPass renderPass) = 0;
         virtual void free(CommandBuffer commandBuffer) = 0;
+        virtual void free(Readback readback) = 0;
     };
 }
@@ -14,5 +14,8 @@ namespace tga{
         virtual bool windowShouldClose(Window window) = 0;
         virtual bool keyDown(Window window, Key key) = 0;
         virtual std::pair<int, int> mousePosition(Window window) = 0;
+        virtual void pollEvents() = 0;
+        virtual std::vector<InputEvent> takeInputEvents(Window window) = 0;
+        virtual InputSnapshot inputSnapshot(Window window) = 0;
     };
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include "tga.hpp"
+
+namespace tga
+{
+    enum class AssetType{
+        buffer,
+        texture,
+        shader
+    };
+
+    enum class AssetCompression{
+        none,
+        lz //Byte oriented LZ77, decompresses at memory speed. Blobs that do not shrink are stored uncompressed
+    };
+
+    struct AssetEntry{
+        std::string name;
+        AssetType type;
+        AssetCompression compression;
+        uint64_t offset; //Of the stored blob inside the pack, aligned to AssetPack::blobAlignment
+        uint64_t storedSize;
+        uint64_t size;
+        BufferUsage bufferUsage;
+        ShaderType shaderType;
+        uint32_t width;
+        uint32_t height;
+        Format format;
+        SamplerMode samplerMode;
+        RepeatMode repeatMode;
+    };
+
+    //Collects GPU-ready blobs and writes them with a table of contents, the infos are the ones later passed to the create functions
+    class AssetPackWriter{
+        public:
+        AssetPackWriter(const std::string &fileName);
+        ~AssetPackWriter();
+        void add(const std::string &name, const BufferInfo &bufferInfo, AssetCompression compression = AssetCompression::none);
+        void add(const std::string &name, const TextureInfo &textureInfo, AssetCompression compression = AssetCompression::lz);
+        void add(const std::string &name, const ShaderInfo &shaderInfo, AssetCompression compression = AssetCompression::none);
+        //Writes the table of contents, called by the destructor otherwise
+        void finish();
+
+        private:
+        void writeBlob(AssetEntry &entry, uint8_t const *data, size_t dataSize);
+
+        std::ofstream file;
+        uint64_t fileSize;
+        std::vector<AssetEntry> entries;
+        bool finished;
+    };
+
+    //Memory maps a pack, infos of uncompressed blobs point straight into the mapping and can be handed to the create functions.
+    //Compressed blobs are decompressed on first access and kept until the pack is closed or release is called.
+    //Pointers stay valid as long as the pack is open
+    class AssetPack{
+        public:
+        static constexpr uint64_t blobAlignment = 256;
+
+        AssetPack(const std::string &fileName);
+        ~AssetPack();
+        AssetPack(const AssetPack&) = delete;
+        AssetPack& operator=(const AssetPack&) = delete;
+
+        bool contains(const std::string &name) const;
+        const AssetEntry& entry(const std::string &name) const;
+        const std::vector<AssetEntry>& entries() const;
+        std::pair<uint8_t const*, size_t> data(const std::string &name);
+        BufferInfo bufferInfo(const std::string &name);
+        TextureInfo textureInfo(const std::string &name);
+        ShaderInfo shaderInfo(const std::string &name);
+        //Drops the decompressed copy of a blob, infos obtained for it before become invalid
+        void release(const std::string &name);
+
+        private:
+        const AssetEntry& entryOfType(const std::string &name, AssetType type) const;
+        void unmap();
+
+        uint8_t const *mapping;
+        size_t mappingSize;
+        std::vector<AssetEntry> tableOfContents;
+        std::unordered_map<std::string, size_t> entryIndices;
+        std::unordered_map<std::string, std::vector<uint8_t>> decompressed;
+    };
+
+    std::vector<uint8_t> compressLZ(uint8_t const *data, size_t dataSize);
+    //Throws if the stream is corrupt or does not decompress to exactly dataSize bytes
+    void decompressLZ(uint8_t const *src, size_t srcSize, uint8_t *data, size_t dataSize);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "tga.hpp"
+
+namespace tga
+{
+    //Forwards every call to the wrapped interface and serializes it, including shader, buffer and texture payloads,
+    //into a binary capture file. Handles are stored as per type sequence numbers, results of queries are stored as well
+    class CaptureInterface : public Interface{
+        public:
+        CaptureInterface(Interface &target, const std::string &captureFile);
+        ~CaptureInterface();
+
+        Shader createShader(const ShaderInfo &shaderInfo) override;
+        Buffer createBuffer(const BufferInfo &bufferInfo) override;
+        Texture createTexture(const TextureInfo &textureInfo) override;
+        Window createWindow(const WindowInfo &windowInfo) override;
+        InputSet createInputSet(const InputSetInfo &inputSetInfo) override;
+        RenderPass createRenderPass(const RenderPassInfo &renderPassInfo) override;
+
+        void beginCommandBuffer(const CommandBufferInfo &commandBufferInfo) override;
+        void setRenderPass(RenderPass renderPass, uint32_t framebufferIndex) override;
+        void nextSubpass() override;
+        void bindVertexBuffer(Buffer buffer) override;
+        void bindIndexBuffer(Buffer buffer, IndexType indexType = IndexType::uint32) override;
+        void bindInputSet(InputSet inputSet) override;
+        void draw(uint32_t vertexCount, uint32_t firstVertex) override;
+        void drawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset) override;
+        void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
+        CommandBuffer endCommandBuffer() override;
+        void execute(CommandBuffer commandBuffer) override;
+
+        void updateBuffer(Buffer buffer, uint8_t const *data, size_t dataSize, uint32_t offset) override;
+
+        Readback readBuffer(Buffer buffer, size_t dataSize, uint32_t offset) override;
+        Readback readTexture(Texture texture) override;
+        bool readbackReady(Readback readback) override;
+        std::pair<uint8_t const*, size_t> readbackData(Readback readback) override;
+
+        TextureProperties textureProperties(Texture texture) override;
+
+        uint32_t backbufferCount(Window window) override;
+        uint32_t nextFrame(Window window) override;
+        void present(Window window) override;
+        void setWindowTitel(Window window, const std::string &title) override;
+
+        bool windowShouldClose(Window window) override;
+        bool keyDown(Window window, Key key) override;
+        std::pair<int, int> mousePosition(Window window) override;
+        void pollInput() override;
+        std::vector<InputEvent> takeInputEvents(Window window) override;
+        InputSnapshot inputSnapshot(Window window) override;
+
+        void free(Shader shader) override;
+        void free(Buffer buffer) override;
+        void free(Texture texture) override;
+        void free(Window window) override;
+        void free(InputSet inputSet) override;
+        void free(RenderPass renderPass) override;
+        void free(CommandBuffer commandBuffer) override;
+        void free(Readback readback) override;
+
+        //Bytes written to the capture so far
+        uint64_t captureSize() const;
+
+        private:
+        //Maps live handles to the sequence numbers used in the capture file
+        struct HandleIds{
+            std::unordered_map<uint64_t, uint64_t> ids;
+            uint64_t nextId = 1;
+            uint64_t add(uint64_t handle);
+            uint64_t get(uint64_t handle) const;
+            uint64_t remove(uint64_t handle);
+        };
+        void writeCall(uint8_t call);
+        void writeVarint(uint64_t value);
+        void writeBytes(uint8_t const *data, size_t size);
+        void writeString(const std::string &string);
+        void writeVertexLayout(const VertexLayout &vertexLayout);
+        void writeRasterizerConfig(const RasterizerConfig &rasterizerConfig);
+        void writeInputLayout(const InputLayout &inputLayout);
+
+        Interface &target;
+        std::ofstream file;
+        uint64_t bytesWritten;
+        HandleIds shaderIds, bufferIds, textureIds, windowIds, inputSetIds, renderPassIds, commandBufferIds, readbackIds;
+    };
+
+    struct ReplayStats{
+        uint64_t calls;
+        uint64_t frames;
+        uint64_t payloadBytes;
+        uint64_t frameDivergences; //nextFrame returned a different backbuffer than during capture
+        double seconds;
+    };
+
+    //Re-issues every call of a capture file against tgai as fast as possible.
+    //Input queries are not re-issued, the application already acted on their captured results.
+    //Captures that create windows need a target with window support, e.g. not a headless TGAVulkan
+    ReplayStats replayCapture(Interface &tgai, const std::string &captureFile);
+}
@@ -19,6 +19,7 @@ TGA_DEFINE_NON_DISPATCHABLE_HANDLE(TgaWindow)
 TGA_DEFINE_NON_DISPATCHABLE_HANDLE(TgaInputSet)
 TGA_DEFINE_NON_DISPATCHABLE_HANDLE(TgaRenderPass)
 TGA_DEFINE_NON_DISPATCHABLE_HANDLE(TgaCommandBuffer)
+TGA_DEFINE_NON_DISPATCHABLE_HANDLE(TgaReadback)
 
 #ifdef __cplusplus
 }
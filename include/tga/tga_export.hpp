@@ -0,0 +1,105 @@
+#pragma once
+#include "tga.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace tga
+{
+    enum class ExportFormat{
+        raw,
+        png
+    };
+
+    //Extent and format are taken from each exported texture, png needs 1 to 4 channels with 8 bit each
+    struct ExportInfo{
+        std::string filePattern; //printf style pattern that receives the frame number, e.g. "frame_%05u.png"
+        ExportFormat format;
+        uint32_t queueDepth; //Frames that may be in flight between rendering and encoding
+        uint32_t workerCount;
+        ExportInfo(std::string const &_filePattern = "frame_%05u.png", ExportFormat _format = ExportFormat::png,
+                    uint32_t _queueDepth = 3, uint32_t _workerCount = 2):
+            filePattern(_filePattern),format(_format),queueDepth(_queueDepth),workerCount(_workerCount){}
+    };
+
+    struct StageLatency{
+        double averageMilli;
+        double maxMilli;
+        StageLatency(double _averageMilli = 0, double _maxMilli = 0):
+            averageMilli(_averageMilli),maxMilli(_maxMilli){}
+    };
+
+    struct ExportStats{
+        uint64_t framesExported;
+        uint64_t framesFailed; //Frames whose encoding or writing failed on a worker
+        std::string lastError;
+        double framesPerSecond;
+        StageLatency readback;
+        StageLatency encode;
+        StageLatency write;
+    };
+
+    //Render -> async readback -> encoding on worker threads -> file write
+    //exportFrame only blocks once queueDepth frames are waiting on the GPU or on the workers.
+    //Textures that cannot be exported are rejected by exportFrame, failures on the workers are reported by stats
+    class FrameExporter{
+        public:
+        FrameExporter(Interface &tgai, const ExportInfo &exportInfo);
+        ~FrameExporter();
+        void exportFrame(Texture texture);
+        void finish();
+        ExportStats stats();
+
+        private:
+        using Clock = std::chrono::steady_clock;
+        struct PendingReadback{
+            Readback readback;
+            uint64_t frame;
+            uint32_t width;
+            uint32_t height;
+            uint32_t channels;
+            Clock::time_point submitTime;
+        };
+        struct EncodeJob{
+            std::vector<uint8_t> pixels;
+            uint64_t frame;
+            uint32_t width;
+            uint32_t height;
+            uint32_t channels;
+        };
+        struct StageAccumulator{
+            double sumMilli = 0;
+            double maxMilli = 0;
+            uint64_t count = 0;
+            void add(double milli);
+            StageLatency latency() const;
+        };
+
+        void collectReadback();
+        void workerLoop();
+        void encodeAndWrite(EncodeJob &job);
+
+        Interface &tgai;
+        ExportInfo exportInfo;
+        uint64_t nextFrame;
+        std::deque<PendingReadback> pending;
+        std::deque<EncodeJob> jobs;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobTaken;
+        bool stopping;
+        Clock::time_point firstFrameTime;
+        Clock::time_point lastWriteTime;
+        uint64_t framesWritten;
+        uint64_t framesFailed;
+        std::string lastError;
+        StageAccumulator readbackLatency;
+        StageAccumulator encodeLatency;
+        StageAccumulator writeLatency;
+    };
+
+    std::vector<uint8_t> encodePNG(uint8_t const *pixels, uint32_t width, uint32_t height, uint32_t channels);
+}
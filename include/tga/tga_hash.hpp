@@ -40,5 +40,10 @@
             return std::hash<uint64_t>()(reinterpret_cast<uint64_t>((TgaCommandBuffer)key));
         }
     };
+    template<> struct hash<tga::Readback>{
+        std::size_t operator()(const tga::Readback &key) const{
+            return std::hash<uint64_t>()(reinterpret_cast<uint64_t>((TgaReadback)key));
+        }
+    };
     
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <array>
+
 namespace tga{
 
 enum class Key{
@@ -126,4 +128,30 @@ enum class Key{
     Menu,
     Unknown
 };
+
+enum class InputEventType{
+    keyPress, //Mouse buttons are keys as well
+    keyRelease,
+    mouseMove
+};
+
+//Buffered by the window system as it receives them, time is in seconds since the window system was initialized
+struct InputEvent{
+    InputEventType type;
+    Key key;
+    double x; //Cursor position
+    double y;
+    double time;
+};
+
+//Input state after every pumped event, key lookups are array accesses
+struct InputSnapshot{
+    std::array<bool,size_t(Key::Unknown)+1> keys{};
+    double mouseX{0};
+    double mouseY{0};
+    bool keyDown(Key key) const
+    {
+        return keys[size_t(key)];
+    }
+};
 }
\ No newline at end of file
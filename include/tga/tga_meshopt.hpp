@@ -0,0 +1,43 @@
+#pragma once
+#include "tga.hpp"
+
+namespace tga
+{
+    //Interleaved vertices and a triangle list, ready for createBuffer once optimized
+    struct MeshData{
+        std::vector<uint8_t> vertices;
+        uint32_t vertexStride;
+        std::vector<uint32_t> indices;
+        MeshData(std::vector<uint8_t> const &_vertices = std::vector<uint8_t>(), uint32_t _vertexStride = 0,
+                    std::vector<uint32_t> const &_indices = std::vector<uint32_t>()):
+            vertices(_vertices),vertexStride(_vertexStride),indices(_indices){}
+    };
+
+    struct MeshOptimizeInfo{
+        uint32_t cacheSize; //Post-transform cache entries, used for ordering and for the reported ACMR
+        uint32_t positionOffset; //Offset of an r32g32b32_sfloat position inside a vertex, used for overdraw ordering
+        float overdrawThreshold; //Cluster ordering is kept only while the ACMR stays within this factor of the cache order
+        uint32_t workerCount; //Threads used by optimizeMeshes, 0 uses one per hardware thread
+        MeshOptimizeInfo(uint32_t _cacheSize = 16, uint32_t _positionOffset = 0, float _overdrawThreshold = 1.05f, uint32_t _workerCount = 0):
+            cacheSize(_cacheSize),positionOffset(_positionOffset),overdrawThreshold(_overdrawThreshold),workerCount(_workerCount){}
+    };
+
+    struct MeshOptimizeStats{
+        uint32_t inputVertices;
+        uint32_t outputVertices;
+        uint32_t triangles;
+        uint32_t clusters;
+        double acmrBefore; //Average cache misses per triangle in a FIFO cache of cacheSize entries
+        double acmrAfter;
+    };
+
+    //Deduplicates vertices, reorders triangles for the vertex cache, orders triangle clusters against overdraw
+    //and finally reorders the vertices into fetch order. Vertices no index refers to are dropped
+    MeshOptimizeStats optimizeMesh(MeshData &mesh, const MeshOptimizeInfo &optimizeInfo = MeshOptimizeInfo());
+    //Optimizes independent meshes in parallel, stats are in the order of meshes
+    std::vector<MeshOptimizeStats> optimizeMeshes(std::vector<MeshData> &meshes, const MeshOptimizeInfo &optimizeInfo = MeshOptimizeInfo());
+
+    double vertexCacheACMR(const std::vector<uint32_t> &indices, uint32_t cacheSize = 16);
+    //Index buffer data in the narrowest IndexType that can address vertexCount vertices
+    std::vector<uint8_t> packIndices(const std::vector<uint32_t> &indices, uint32_t vertexCount, IndexType &indexType);
+}
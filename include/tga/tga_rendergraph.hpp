@@ -0,0 +1,125 @@
+#pragma once
+#include "tga.hpp"
+
+namespace tga
+{
+    //Index into the resources declared for the current frame
+    struct GraphTexture{
+        uint32_t index;
+        explicit GraphTexture(uint32_t _index = ~0u):index(_index){}
+        explicit operator bool() const
+        {
+            return index != ~0u;
+        }
+    };
+
+    struct GraphTextureInfo{
+        uint32_t width;
+        uint32_t height;
+        Format format;
+        SamplerMode samplerMode;
+        RepeatMode repeatMode;
+        GraphTextureInfo(uint32_t _width = 0, uint32_t _height = 0, Format _format = Format::r8g8b8a8_unorm,
+                    SamplerMode _samplerMode = SamplerMode::linear, RepeatMode _repeatMode = RepeatMode::clampEdge):
+            width(_width),height(_height),format(_format),samplerMode(_samplerMode),repeatMode(_repeatMode){}
+    };
+
+    struct GraphBinding{
+        uint32_t setIndex;
+        std::variant<Buffer, GraphTexture> resource;
+        uint32_t slot;
+        uint32_t arrayElement;
+        GraphBinding(uint32_t _setIndex = 0, std::variant<Buffer, GraphTexture> _resource = Buffer(), uint32_t _slot = 0, uint32_t _arrayElement = 0):
+            setIndex(_setIndex),resource(_resource),slot(_slot),arrayElement(_arrayElement){}
+    };
+
+    //A pass renders into target and samples the textures named in bindings, input sets are created and bound by the graph.
+    //record is called between setRenderPass and the end of the pass to bind vertex/index buffers and draw
+    struct GraphPassInfo{
+        std::string name;
+        std::vector<Shader> shaderStages;
+        std::variant<GraphTexture, Window> target;
+        std::vector<GraphBinding> bindings;
+        std::function<void(Interface&)> record;
+        VertexLayout vertexLayout;
+        ClearOperation clearOperations;
+        RasterizerConfig rasterizerConfig;
+        InputLayout inputLayout;
+        DepthConfig depthConfig;
+        GraphPassInfo(std::string const &_name = "", std::vector<Shader> const &_shaderStages = std::vector<Shader>(),
+                    std::variant<GraphTexture, Window> _target = GraphTexture(), std::vector<GraphBinding> const &_bindings = {},
+                    std::function<void(Interface&)> _record = {}, VertexLayout _vertexLayout = VertexLayout(),
+                    ClearOperation _clearOperations = ClearOperation::none, RasterizerConfig _rasterizerConfig = RasterizerConfig(),
+                    InputLayout _inputLayout = InputLayout(), DepthConfig _depthConfig = DepthConfig()):
+            name(_name),shaderStages(_shaderStages),target(_target),bindings(_bindings),record(_record),vertexLayout(_vertexLayout),
+            clearOperations(_clearOperations),rasterizerConfig(_rasterizerConfig),inputLayout(_inputLayout),depthConfig(_depthConfig){}
+    };
+
+    struct GraphStats{
+        uint32_t declaredPasses;
+        uint32_t culledPasses;
+        uint32_t transientTextures;
+        uint32_t physicalTextures;
+        uint64_t transientBytes; //Without aliasing
+        uint64_t physicalBytes; //What is actually allocated for transients
+    };
+
+    //Per frame render graph on top of an Interface.
+    //Passes that do not contribute to an imported texture or a window are culled, the rest is ordered by their dependencies.
+    //Passes writing the same texture or window keep their declaration order.
+    //Transient textures with the same extent and format whose lifetimes do not overlap share one physical texture.
+    //Layout transitions and barriers between passes are left to the backend's state tracking
+    class RenderGraph{
+        public:
+        RenderGraph(Interface &tgai);
+        ~RenderGraph();
+
+        //Declaration, valid until the next reset
+        GraphTexture createTransient(const GraphTextureInfo &textureInfo);
+        GraphTexture importTexture(Texture texture);
+        void addPass(const GraphPassInfo &passInfo);
+        void reset();
+
+        //Culls, orders and assigns physical resources, render passes and input sets are cached between frames by pass name.
+        //A cached render pass is recreated when the target or the description of its pass changes
+        void compile();
+        CommandBuffer record(uint32_t framebufferIndex = 0);
+        GraphStats stats() const;
+        Texture physicalTexture(GraphTexture texture) const;
+
+        private:
+        struct ResourceEntry{
+            GraphTextureInfo info;
+            Texture imported;
+            Texture physical;
+            uint32_t firstUse;
+            uint32_t lastUse;
+        };
+        struct PhysicalTexture{
+            GraphTextureInfo info;
+            Texture texture;
+            bool used;
+        };
+        struct CachedPass{
+            RenderPassInfo renderPassInfo; //What renderPass was created from
+            std::vector<std::vector<Binding>> setBindings;
+            RenderPass renderPass;
+            std::vector<InputSet> inputSets;
+            bool used;
+        };
+        void cullPasses();
+        void orderPasses();
+        void assignPhysicalTextures();
+        void preparePass(const GraphPassInfo &pass);
+        void freeCachedPass(CachedPass &cachedPass);
+
+        Interface &tgai;
+        std::vector<ResourceEntry> resources;
+        std::vector<GraphPassInfo> passes;
+        std::vector<uint32_t> executionOrder;
+        std::vector<PhysicalTexture> physicalTextures;
+        std::unordered_map<std::string, CachedPass> cachedPasses;
+        GraphStats lastStats;
+        bool compiled;
+    };
+}
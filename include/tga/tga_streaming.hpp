@@ -0,0 +1,87 @@
+#pragma once
+#include "tga.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace tga
+{
+    struct StreamLoaderInfo{
+        uint32_t queueDepth; //Reads handed to the kernel or the workers at once
+        uint64_t memoryBudget; //Bytes of destination memory held by reads that were queued but not yet returned by poll
+        uint32_t workerCount; //Threads of the fallback
+        bool useIoUring; //Falls back to the worker threads if io_uring is not available
+        StreamLoaderInfo(uint32_t _queueDepth = 32, uint64_t _memoryBudget = uint64_t(256) << 20, uint32_t _workerCount = 4, bool _useIoUring = true):
+            queueDepth(_queueDepth),memoryBudget(_memoryBudget),workerCount(_workerCount),useIoUring(_useIoUring){}
+    };
+
+    struct StreamCompletion{
+        uint64_t userData;
+        uint8_t *destination;
+        size_t size;
+        int error; //errno of the failed read, 0 on success
+    };
+
+    //Reads file regions straight into caller provided memory, e.g. TGAVulkan::acquireStaging regions or the
+    //blobs of an uncompressed AssetPack entry, without copying through intermediate buffers.
+    //read only queues, submit hands all queued reads up to queueDepth to io_uring in a single call.
+    //Not thread safe, a loader belongs to the thread that streams
+    class StreamLoader{
+        public:
+        StreamLoader(const StreamLoaderInfo &loaderInfo = StreamLoaderInfo());
+        ~StreamLoader();
+        StreamLoader(const StreamLoader&) = delete;
+        StreamLoader& operator=(const StreamLoader&) = delete;
+
+        uint32_t openFile(const std::string &fileName);
+        //Returns false and queues nothing if the read does not fit into the memory budget.
+        //A read larger than the whole budget is accepted once nothing else is outstanding
+        bool read(uint32_t file, uint64_t offset, size_t size, uint8_t *destination, uint64_t userData);
+        void submit();
+        //Finished reads, frees their budget and submits queued reads. With wait it blocks until at least one read finished,
+        //unless nothing is outstanding
+        std::vector<StreamCompletion> poll(bool wait = false);
+
+        bool usesIoUring() const;
+        uint64_t bytesOutstanding() const;
+        size_t readsOutstanding() const;
+
+        private:
+        struct Request{
+            int fd;
+            uint64_t offset;
+            size_t size;
+            uint8_t *destination;
+            uint64_t userData;
+            size_t done;
+        };
+        struct Ring;
+
+        void submitRing();
+        void pollRing(bool wait, std::vector<StreamCompletion> &completions);
+        void submitWorkers();
+        void pollWorkers(bool wait, std::vector<StreamCompletion> &completions);
+        void workerLoop();
+
+        StreamLoaderInfo loaderInfo;
+        std::vector<int> files;
+        std::deque<Request> queued;
+        uint64_t bytesReserved;
+        size_t inFlight;
+
+        //io_uring, slots hold the requests the kernel is working on
+        std::unique_ptr<Ring> ring;
+        std::vector<Request> slots;
+        std::vector<uint32_t> freeSlots;
+
+        //Fallback
+        std::vector<std::thread> workers;
+        std::deque<Request> jobs;
+        std::vector<StreamCompletion> finished;
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        std::condition_variable jobFinished;
+        bool stopping;
+    };
+}
@@ -3,13 +3,160 @@
 #include "tga/tga_hash.hpp"
 #include "tga_vulkan_WSI.hpp"
 #include "tga_vulkan_util.hpp"
+#include <chrono>
 
 namespace tga{
 
+    //Lowest severity of messages the debug messenger prints, none installs no messenger
+    enum class DebugSeverity{
+        none,
+        error,
+        warning,
+        info,
+        verbose
+    };
+
+    enum class DeviceType{
+        any, //Discrete GPUs are preferred
+        discrete,
+        integrated,
+        virtualGpu,
+        cpu
+    };
+
+    //Which physical device to use, every criterion that is set has to match
+    struct DeviceSelection{
+        std::string name; //Part of the device name
+        std::array<uint8_t,VK_UUID_SIZE> uuid; //All zero matches any device
+        DeviceType type;
+        DeviceSelection(std::string const &_name = "", std::array<uint8_t,VK_UUID_SIZE> _uuid = {}, DeviceType _type = DeviceType::any):
+            name(_name),uuid(_uuid),type(_type){}
+    };
+
+    struct TGAVulkanInfo{
+        bool headless;
+        bool profiling;
+        bool tracing; //Records CPU and GPU spans for writeTrace
+        bool validation; //Skipped with a warning when the validation layer is not installed
+        DebugSeverity debugSeverity;
+        DeviceSelection deviceSelection;
+        vk::PhysicalDeviceFeatures features; //Enabled where the device supports them
+        TGAVulkanInfo(bool _headless = false, bool _profiling = false, bool _tracing = false, bool _validation = true,
+                    DebugSeverity _debugSeverity = DebugSeverity::warning, DeviceSelection const &_deviceSelection = DeviceSelection(),
+                    vk::PhysicalDeviceFeatures const &_features = vk::PhysicalDeviceFeatures()):
+            headless(_headless),profiling(_profiling),tracing(_tracing),validation(_validation),debugSeverity(_debugSeverity),
+            deviceSelection(_deviceSelection),features(_features){}
+    };
+
+    struct PassProfile{
+        RenderPass renderPass;
+        double gpuTimeMilli;
+        uint64_t vertexInvocations;
+        uint64_t fragmentInvocations;
+    };
+
+    struct FrameProfile{
+        uint64_t frame;
+        CommandBuffer commandBuffer;
+        std::vector<PassProfile> passes;
+    };
+
+    enum class InterfaceCall{
+        createShader,
+        createBuffer,
+        createTexture,
+        createWindow,
+        createInputSet,
+        createRenderPass,
+        beginCommandBuffer,
+        setRenderPass,
+        nextSubpass,
+        bindVertexBuffer,
+        bindIndexBuffer,
+        bindInputSet,
+        draw,
+        drawIndexed,
+        dispatch,
+        endCommandBuffer,
+        execute,
+        updateBuffer,
+        readBuffer,
+        readTexture,
+        readbackReady,
+        readbackData,
+        textureProperties,
+        backbufferCount,
+        nextFrame,
+        present,
+        setWindowTitel,
+        windowShouldClose,
+        keyDown,
+        mousePosition,
+        pollInput,
+        takeInputEvents,
+        inputSnapshot,
+        free,
+        count
+    };
+    const char* interfaceCallName(InterfaceCall call);
+
+    struct PerformanceCounters{
+        uint64_t queueSubmissions;
+        uint64_t waitIdles;
+        uint64_t oneTimeCommandBuffers;
+        uint64_t bytesUploaded;
+        uint64_t descriptorPoolsCreated;
+        uint64_t pipelinesCreated;
+        std::array<uint64_t,size_t(InterfaceCall::count)> callCounts;
+        std::array<double,size_t(InterfaceCall::count)> callTimeMilli;
+    };
+
+    const char* resourceKindName(ResourceKind kind);
+
+    struct MemoryUsage{
+        uint64_t deviceBytes;
+        uint64_t hostBytes;
+        uint32_t allocations;
+    };
+
+    struct ResourceAllocation{
+        ResourceKind kind;
+        uint64_t size;
+        uint32_t memoryType;
+        uint64_t resource;
+    };
+
+    struct LiveHandles{
+        size_t shaders;
+        size_t buffers;
+        size_t textures;
+        size_t windows;
+        size_t inputSets;
+        size_t renderPasses;
+        size_t commandBuffers;
+        size_t readbacks;
+    };
+
+    struct MemoryReport{
+        uint64_t deviceBytes;
+        uint64_t hostBytes;
+        std::array<MemoryUsage,size_t(ResourceKind::count)> byKind;
+        std::vector<uint64_t> bytesByMemoryType;
+        std::vector<ResourceAllocation> largestAllocations;
+        LiveHandles liveHandles;
+    };
+
+    //Persistently mapped upload memory, valid until it is handed to uploadStaging or releaseStaging
+    struct StagingRegion{
+        uint8_t *data;
+        size_t size;
+        uint64_t id;
+    };
+
     class TGAVulkan : public Interface{
         public:
         void test(Window window);
-        TGAVulkan();
+        TGAVulkan(const TGAVulkanInfo &tgaVulkanInfo = TGAVulkanInfo());
         ~TGAVulkan();
 
         Shader createShader(const ShaderInfo &shaderInfo) override;
@@ -21,16 +168,25 @@ namespace tga{
 
         void beginCommandBuffer(const CommandBufferInfo &commandBufferInfo) override;
         void setRenderPass(RenderPass renderPass, uint32_t frambufferIndex) override;
+        void nextSubpass() override;
         void bindVertexBuffer(Buffer buffer) override;
-        void bindIndexBuffer(Buffer buffer) override;
+        void bindIndexBuffer(Buffer buffer, IndexType indexType = IndexType::uint32) override;
         void bindInputSet(InputSet inputSet) override;
         void draw(uint32_t vertexCount, uint32_t firstVertex) override;
         void drawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset) override;   
+        void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
         CommandBuffer endCommandBuffer() override;
         void execute(CommandBuffer commandBuffer) override;
 
         void updateBuffer(Buffer buffer, uint8_t const *data, size_t dataSize, uint32_t offset) override;
 
+        Readback readBuffer(Buffer buffer, size_t dataSize, uint32_t offset) override;
+        Readback readTexture(Texture texture) override;
+        bool readbackReady(Readback readback) override;
+        std::pair<uint8_t const*, size_t> readbackData(Readback readback) override;
+
+        TextureProperties textureProperties(Texture texture) override;
+
         uint32_t backbufferCount(Window window) override;
         uint32_t nextFrame(Window window) override;
         void present(Window window) override;
@@ -39,6 +195,9 @@ namespace tga{
         bool windowShouldClose(Window window) override;
         bool keyDown(Window window, Key key) override;
         std::pair<int, int> mousePosition(Window window) override;
+        void pollInput() override;
+        std::vector<InputEvent> takeInputEvents(Window window) override;
+        InputSnapshot inputSnapshot(Window window) override;
 
         void free(Shader shader) override;
         void free(Buffer buffer) override;
@@ -47,61 +206,162 @@ namespace tga{
         void free(InputSet inputSet) override;
         void free(RenderPass renderPass) override;
         void free(CommandBuffer commandBuffer) override;
+        void free(Readback readback) override;
+
+        //Profiles of executions that already finished on the GPU, never waits
+        std::vector<FrameProfile> collectProfiles();
+
+        //Counters of the last completed frame and since creation, present ends a frame implicitly
+        const PerformanceCounters& frameCounters() const;
+        const PerformanceCounters& totalCounters() const;
+        void endFrame();
+
+        MemoryReport memoryReport(size_t largestCount = 10);
+        void printMemoryReport(std::ostream &out, size_t largestCount = 10);
+
+        //Writes the recorded spans as chrome://tracing / Perfetto JSON, waits for the GPU to finish first
+        void writeTrace(const std::string &fileName);
+        void clearTrace();
+
+        //Queued frames and present estimate of a window, schedule simulation against nextPresent to start it as late as possible
+        FramePacing framePacing(Window window);
+
+        //Asynchronous uploads, fill the region (e.g. by streaming file data into it) and hand it over.
+        //The copy is ordered before later executions, the region returns to a pool once the GPU has finished it
+        StagingRegion acquireStaging(size_t size);
+        void uploadStaging(const StagingRegion &region, Buffer buffer, uint32_t offset = 0);
+        void uploadStaging(const StagingRegion &region, Texture texture);
+        void releaseStaging(const StagingRegion &region);
 
         private:
+        struct CallTimer{
+            CallTimer(TGAVulkan &tgav, InterfaceCall call);
+            ~CallTimer();
+            TGAVulkan &tgav;
+            InterfaceCall call;
+            std::chrono::steady_clock::time_point start;
+        };
+        void countEvent(uint64_t PerformanceCounters::*counter, uint64_t amount = 1);
+        struct TraceSpan{
+            TraceSpan(TGAVulkan &tgav, const char *name);
+            ~TraceSpan();
+            TGAVulkan &tgav;
+            const char *name;
+            std::chrono::steady_clock::time_point start;
+        };
+        double traceMicro(std::chrono::steady_clock::time_point time);
+        double gpuTicksToTraceMicro(uint64_t ticks);
+        void addTraceEvent(std::string name, TraceTrack track, double startMicro, double durationMicro);
+        void calibrateTimestamps();
 
         
         //Vulkan Stuff
-        VulkanWSI wsi;
+        TGAVulkanInfo vulkanInfo;
+        std::unique_ptr<VulkanWSI> wsi;
         vk::Instance instance;
         vk::DebugUtilsMessengerEXT debugger;
         vk::PhysicalDevice pDevice;
         QueueIndices queueIndices;
+        bool dynamicRendering; //Single subpass passes are recorded with beginRendering instead of render pass objects
         vk::Device device;
         vk::Queue graphicsQueue;
         vk::Queue transferQueue;
+        vk::Queue computeQueue;
         vk::CommandPool transferCmdPool;
         vk::CommandPool graphicsCmdPool;
+        vk::CommandPool computeCmdPool;
 
         const std::vector<const char*> getInstanceExtentensions();
         const std::vector<const char*> getDeviceExtentensions();
         const std::vector<const char*> getLayers();
+        bool instanceExtensionSupported(const char *extension);
+        bool deviceExtensionSupported(const char *extension);
+        bool supportsDynamicRendering();
         vk::PhysicalDeviceFeatures getDeviceFeatures();
         uint32_t findQueueFamily(vk::QueueFlags mask,vk::QueueFlags flags);
         QueueIndices findQueueFamilies();
 
+        VulkanWSI& getWSI();
         vk::Instance createInstance();
         vk::DebugUtilsMessengerEXT createDebugger();
         vk::PhysicalDevice choseGPU();
         vk::Device createDevice();
         vk::CommandPool createCommandPool(uint32_t queueFamily, vk::CommandPoolCreateFlags flags = vk::CommandPoolCreateFlags());
-        uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
-        Buffer_TV allocateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+        uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties, vk::MemoryPropertyFlags preferredProperties = {});
+        vk::DeviceMemory allocateMemory(const vk::MemoryRequirements &requirements, vk::MemoryPropertyFlags properties, ResourceKind kind,
+            uint64_t resource, vk::MemoryPropertyFlags preferredProperties = {});
+        void freeMemory(vk::DeviceMemory memory);
+        Buffer_TV allocateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, ResourceKind kind,
+            vk::MemoryPropertyFlags preferredProperties = {});
         vk::Format findDepthFormat();
-        DepthBuffer_TV createDepthBuffer(uint32_t width, uint32_t height);
-        vk::RenderPass makeRenderPass(vk::Format colorFormat,ClearOperation clearOps, vk::ImageLayout layout);
+        DepthBuffer_TV createDepthBuffer(uint32_t width, uint32_t height, vk::Format format, vk::SampleCountFlagBits samples, bool transient);
+        std::optional<DepthKey_TV> acquireDepthBuffer(uint64_t owner, vk::Extent2D extent, vk::Format format, vk::SampleCountFlagBits samples,
+            const DepthConfig &depthConfig);
+        void releaseDepthBuffer(const DepthKey_TV &key);
+        Attachment_TV createIntermediateAttachment(vk::Extent2D extent, vk::Format format, vk::SampleCountFlagBits samples);
+        Attachment_TV createMultisampleAttachment(vk::Extent2D extent, vk::Format format, vk::SampleCountFlagBits samples);
+        std::vector<vk::AttachmentDescription> makeAttachments(const RenderPassInfo &renderPassInfo, const std::vector<vk::Format> &colorFormats,
+            vk::ImageLayout initialLayout, vk::ImageLayout finalLayout, vk::Format depthFormat, const std::vector<vk::Format> &intermediateFormats,
+            vk::SampleCountFlagBits samples);
+        //Throws before anything of the pass is created, makeRenderPass and makeSubpass rely on it
+        void validateSubpasses(const std::vector<SubpassInfo> &subpasses, uint32_t colorCount, uint32_t intermediateCount);
+        vk::RenderPass makeRenderPass(const std::vector<vk::AttachmentDescription> &attachments, uint32_t colorCount, uint32_t intermediateCount,
+            bool hasDepth, const std::vector<SubpassInfo> &subpasses);
         std::vector<vk::DescriptorSetLayout> decodeInputLayout(const InputLayout &inputLayout);
-        vk::Pipeline makeGraphicsPipeline(const RenderPassInfo &renderPassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass);
-        vk::Pipeline makePipeline(const RenderPassInfo &renderPassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass);
+        //pNext is chained into the pipeline, dynamic rendering passes the attachment formats that way
+        Subpass_TV makeSubpass(const SubpassInfo &subpassInfo, uint32_t subpass, vk::SampleCountFlagBits samples, vk::RenderPass renderPass,
+            const std::vector<ColorTarget> &additionalTargets, const std::vector<Attachment_TV> &intermediateAttachments, const void *pNext = nullptr);
+        vk::Pipeline makeGraphicsPipeline(const SubpassInfo &subpassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass, uint32_t subpass,
+            vk::SampleCountFlagBits samples, const std::vector<ColorTarget> &additionalTargets, const void *pNext);
+        vk::Pipeline makePipeline(const SubpassInfo &subpassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass, uint32_t subpass,
+            vk::SampleCountFlagBits samples, const std::vector<ColorTarget> &additionalTargets, const void *pNext);
         
 
         vk::CommandBuffer beginOneTimeCmdBuffer(vk::CommandPool &cmdPool);
         void endOneTimeCmdBuffer(vk::CommandBuffer &cmdBuffer,vk::CommandPool &cmdPool, vk::Queue &submitQueue);
 
         void fillBuffer(size_t size,const uint8_t *data,uint32_t offset,vk::Buffer target);
-        void transitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+        void createProfilingResources();
+        void harvestProfiles(CommandBuffer waitFor = CommandBuffer());
+        void bindSubpass(const RenderPass_TV &renderPass, uint32_t subpass);
+        void beginDynamicRendering(const RenderPass_TV &renderPass, uint32_t frameIndex);
+        void endDynamicRendering(const RenderPass_TV &renderPass, uint32_t frameIndex);
+        void finishRenderPass();
+        void transitionImageLayout(vk::CommandBuffer cmdBuffer, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+            vk::Format depthFormat = vk::Format::eUndefined);
+        ImageState_TV layoutState(vk::ImageLayout layout);
+        void requireTextureState(Texture texture, vk::ImageLayout layout, bool discardContent = false);
+        void flushBarriers();
         void fillTexture(size_t size,const uint8_t *data,uint32_t width, uint32_t height,vk::Image target);
+        Readback_TV acquireReadbackSlot(vk::DeviceSize size);
+        Readback submitReadback(Readback_TV &readback);
+        void checkStaging(const StagingRegion &region);
+        Staging_TV takeStaging(const StagingRegion &region);
+        void submitStaging(Staging_TV &staging, size_t size);
+        void recycleStaging();
+        //Graphics submissions take over the results of async compute executed before them unless waitForCompute is false
+        void submitGraphics(vk::CommandBuffer cmdBuffer, vk::Fence fence, bool waitForCompute = true, vk::Semaphore signal = vk::Semaphore());
+        void submitAsyncCompute(const CommandBuffer_TV &commandBuffer);
+        vk::ImageMemoryBarrier ownershipTransfer(Texture texture, uint32_t srcFamily, uint32_t dstFamily, vk::AccessFlags dstAccess);
+        ComputeSync_TV createComputeSync(const std::vector<Texture> &sampledTextures);
 
         //Convertes
         vk::BufferUsageFlags determineBufferFlags(tga::BufferUsage usage);
         vk::Format determineImageFormat(tga::Format format);
+        vk::DeviceSize determineFormatSize(vk::Format format);
         std::tuple<vk::Filter, vk::SamplerAddressMode> determineSamplerInfo(const TextureInfo &textureInfo);
         vk::ShaderStageFlagBits determineShaderStage(tga::ShaderType shaderType);
         std::vector<vk::VertexInputAttributeDescription> determineVertexAttributes(const std::vector<VertexAttribute> &attributes);
         vk::PipelineRasterizationStateCreateInfo determineRasterizerState(const RasterizerConfig &config);
         vk::CompareOp determineDepthCompareOp(CompareOperation compareOperation);
+        vk::Format determineDepthFormat(DepthFormat depthFormat, bool depthTested);
+        vk::PhysicalDeviceType determineDeviceType(DeviceType deviceType);
+        vk::SampleCountFlagBits determineSampleCount(SampleCount sampleCount, bool hasDepth);
+        vk::AttachmentLoadOp determineLoadOp(LoadOperation loadOperation);
+        vk::AttachmentStoreOp determineStoreOp(StoreOperation storeOperation);
         vk::BlendFactor determineBlendFactor(BlendFactor blendFactor);
         vk::PipelineColorBlendAttachmentState determineColorBlending(const RasterizerConfig &config);
+        vk::PipelineColorBlendAttachmentState determineColorBlending(bool blendEnabled, BlendFactor srcBlend, BlendFactor dstBlend);
         vk::DescriptorType determineDescriptorType(tga::BindingType bindingType);
         vk::AccessFlags layoutToAccessFlags(vk::ImageLayout layout);
         vk::PipelineStageFlags layoutToPipelineStageFlags(vk::ImageLayout layout);
@@ -116,12 +376,64 @@ namespace tga{
         std::unordered_map<InputSet, InputSet_TV> inputSets;
         std::unordered_map<RenderPass, RenderPass_TV> renderPasses;
         std::unordered_map<CommandBuffer, CommandBuffer_TV> commandBuffers;
-        std::unordered_map<Texture,DepthBuffer_TV> textureDepthBuffers;
-        std::unordered_map<Window,DepthBuffer_TV> windowDepthBuffers;
+        std::unordered_map<Readback, Readback_TV> readbacks;
+        std::vector<Readback_TV> readbackPool;
+        std::unordered_map<uint64_t, Staging_TV> stagingRegions;
+        std::vector<Staging_TV> stagingInFlight;
+        std::vector<Staging_TV> stagingPool;
+        uint64_t nextStagingId{1};
+        std::map<DepthKey_TV,DepthBuffer_TV> depthBuffers;
+        std::unordered_map<VkDeviceMemory,Allocation_TV> allocations;
+        std::vector<ComputeWait_TV> pendingComputeWaits;
+
+        //Profiling
+        static constexpr uint32_t maxProfiledPasses = 1024;
+        static constexpr size_t maxFinishedProfiles = 256;
+        vk::QueryPool timestampPool;
+        vk::QueryPool statisticsPool;
+        float timestampPeriod{1};
+        uint64_t timestampMask{0};
+        uint64_t frameCount{0};
+        std::vector<uint32_t> freeQuerySlots;
+        std::vector<vk::Fence> profileFences;
+        std::vector<PendingProfile_TV> pendingProfiles;
+        std::vector<FrameProfile> finishedProfiles;
+
+        //Tracing, GPU ticks are mapped to the CPU clock through the last calibration
+        static constexpr size_t maxTraceEvents = size_t(1)<<20;
+        std::vector<TraceEvent_TV> traceEvents;
+        uint64_t droppedTraceEvents{0};
+        std::chrono::steady_clock::time_point traceEpoch{std::chrono::steady_clock::now()};
+        std::chrono::steady_clock::time_point lastCalibration;
+        bool calibratedTimestamps{false};
+        uint64_t gpuCalibrationTicks{0};
+        double cpuCalibrationMicro{0};
+
+        //Counters
+        PerformanceCounters currentFrameCounters{};
+        PerformanceCounters lastFrameCounters{};
+        PerformanceCounters cumulativeCounters{};
 
+        //Textures rest in eShaderReadOnlyOptimal between command buffers, only the ones touched while recording are tracked
+        static constexpr vk::ImageLayout restingTextureLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        //Where graphics work may read what compute wrote
+        static constexpr vk::PipelineStageFlags computeResultStages = vk::PipelineStageFlagBits::eDrawIndirect|vk::PipelineStageFlagBits::eVertexInput|
+            vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader|vk::PipelineStageFlagBits::eComputeShader|
+            vk::PipelineStageFlagBits::eTransfer;
         struct RecordingData{
             vk::CommandBuffer cmdBuffer;
             RenderPass renderPass;
+            uint32_t subpass{0};
+            uint32_t frameIndex{0};
+            std::vector<PassQuery_TV> passQueries;
+            bool profilingPass{false};
+            bool asyncCompute{false};
+            bool waitsForCompute{true};
+            std::vector<Texture> computeTextures; //Sampled textures acquired by the compute queue
+            std::unordered_map<Texture, ImageState_TV> textureStates;
+            std::vector<vk::ImageMemoryBarrier> barriers;
+            vk::PipelineStageFlags barrierSrcStages;
+            vk::PipelineStageFlags barrierDstStages;
         }currentRecording;
     };
 }
\ No newline at end of file
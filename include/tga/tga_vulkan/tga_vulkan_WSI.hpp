@@ -2,6 +2,8 @@
 #include "tga/tga_WSI.hpp"
 #include "tga/tga_hash.hpp"
 #include "vulkan/vulkan.hpp"
+#include <deque>
+#include <chrono>
 
 namespace tga{
 
@@ -14,13 +16,28 @@ namespace tga{
         std::vector<vk::Image> images;
         std::vector<vk::ImageView> imageViews;
         std::any nativeHandle;
-        vk::Fence inFlightFence;
-        vk::Semaphore imageAvailableSemaphore;
-        vk::Semaphore renderFinishedSemaphore;
+        //One per frame that may be queued, frameSlot selects the ones of the current frame
+        std::vector<vk::Fence> inFlightFences;
+        std::vector<vk::Semaphore> imageAvailableSemaphores;
+        std::vector<vk::Semaphore> renderFinishedSemaphores;
+        uint32_t frameSlot;
         uint32_t currentFrameIndex;
+        uint32_t maxQueuedFrames;
+        std::chrono::steady_clock::duration minFrameInterval;
+        std::chrono::steady_clock::time_point lastFrameStart;
+        std::chrono::steady_clock::time_point lastPresent;
+        double frameIntervalMilli;
+        std::deque<InputEvent> inputEvents; //Filled by the window system callbacks
+        InputSnapshot input;
     };
 
 
+    struct FramePacing{
+        uint32_t queuedFrames; //Presented frames that are still executing
+        double frameIntervalMilli; //Smoothed time between presents
+        std::chrono::steady_clock::time_point nextPresent; //Estimate for the frame recorded now
+    };
+
     class VulkanWSI : public WSI
     {
         public:
@@ -39,6 +56,10 @@ namespace tga{
 
         bool keyDown(Window window, Key key) override;
         std::pair<int, int> mousePosition(Window window) override;
+        void pollEvents() override;
+        std::vector<InputEvent> takeInputEvents(Window window) override;
+        InputSnapshot inputSnapshot(Window window) override;
+        FramePacing framePacing(Window window);
 
 
 
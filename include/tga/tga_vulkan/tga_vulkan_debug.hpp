@@ -5,6 +5,14 @@
 
     PFN_vkCreateDebugUtilsMessengerEXT pfnVkCreateDebugUtilsMessengerEXT;
     PFN_vkDestroyDebugUtilsMessengerEXT pfnVkDestroyDebugUtilsMessengerEXT;
+    PFN_vkCmdBeginDebugUtilsLabelEXT pfnVkCmdBeginDebugUtilsLabelEXT;
+    PFN_vkCmdEndDebugUtilsLabelEXT pfnVkCmdEndDebugUtilsLabelEXT;
+    PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT;
+    PFN_vkGetCalibratedTimestampsEXT pfnVkGetCalibratedTimestampsEXT;
+#ifdef VK_KHR_dynamic_rendering
+    PFN_vkCmdBeginRenderingKHR pfnVkCmdBeginRenderingKHR;
+    PFN_vkCmdEndRenderingKHR pfnVkCmdEndRenderingKHR;
+#endif
 
     VKAPI_ATTR VkResult VKAPI_CALL vkCreateDebugUtilsMessengerEXT(
         VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
@@ -19,6 +27,48 @@
         return pfnVkDestroyDebugUtilsMessengerEXT(instance, messenger, pAllocator);
     }
 
+    VKAPI_ATTR void VKAPI_CALL vkCmdBeginDebugUtilsLabelEXT(
+        VkCommandBuffer commandBuffer, const VkDebugUtilsLabelEXT *pLabelInfo)
+    {
+        if(pfnVkCmdBeginDebugUtilsLabelEXT)
+            pfnVkCmdBeginDebugUtilsLabelEXT(commandBuffer, pLabelInfo);
+    }
+
+    VKAPI_ATTR void VKAPI_CALL vkCmdEndDebugUtilsLabelEXT(VkCommandBuffer commandBuffer)
+    {
+        if(pfnVkCmdEndDebugUtilsLabelEXT)
+            pfnVkCmdEndDebugUtilsLabelEXT(commandBuffer);
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(
+        VkPhysicalDevice physicalDevice, uint32_t *pTimeDomainCount, VkTimeDomainEXT *pTimeDomains)
+    {
+        if(!pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT)
+            return VK_ERROR_EXTENSION_NOT_PRESENT;
+        return pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, pTimeDomainCount, pTimeDomains);
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL vkGetCalibratedTimestampsEXT(
+        VkDevice device, uint32_t timestampCount, const VkCalibratedTimestampInfoEXT *pTimestampInfos,
+        uint64_t *pTimestamps, uint64_t *pMaxDeviation)
+    {
+        if(!pfnVkGetCalibratedTimestampsEXT)
+            return VK_ERROR_EXTENSION_NOT_PRESENT;
+        return pfnVkGetCalibratedTimestampsEXT(device, timestampCount, pTimestampInfos, pTimestamps, pMaxDeviation);
+    }
+
+#ifdef VK_KHR_dynamic_rendering
+    VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderingKHR(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR *pRenderingInfo)
+    {
+        pfnVkCmdBeginRenderingKHR(commandBuffer, pRenderingInfo);
+    }
+
+    VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderingKHR(VkCommandBuffer commandBuffer)
+    {
+        pfnVkCmdEndRenderingKHR(commandBuffer);
+    }
+#endif
+
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
         VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -32,7 +82,7 @@
     }
 namespace tga
 {
-    vk::DebugUtilsMessengerEXT createDebugMessenger(vk::Instance &instance)
+    vk::DebugUtilsMessengerEXT createDebugMessenger(vk::Instance &instance, vk::DebugUtilsMessageSeverityFlagsEXT severityFlags)
     {
         pfnVkCreateDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(instance.getProcAddr("vkCreateDebugUtilsMessengerEXT"));
         if(!pfnVkCreateDebugUtilsMessengerEXT) {
@@ -44,14 +94,31 @@ namespace tga
             std::cout << "GetInstanceProcAddr: Unable to find pfnVkDestroyDebugUtilsMessengerEXT function.\n";
             exit(1);
         }
-        vk::DebugUtilsMessageSeverityFlagsEXT severityFlags(
-            vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning|
-            vk::DebugUtilsMessageSeverityFlagBitsEXT::eError);
-            
         vk::DebugUtilsMessageTypeFlagsEXT messageTypeFlags(
             vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral|
             vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance|
             vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation);
         return instance.createDebugUtilsMessengerEXT(vk::DebugUtilsMessengerCreateInfoEXT( { }, severityFlags,messageTypeFlags, &debugCallback));
     }
+
+    void loadDebugLabelFunctions(vk::Instance &instance)
+    {
+        pfnVkCmdBeginDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(instance.getProcAddr("vkCmdBeginDebugUtilsLabelEXT"));
+        pfnVkCmdEndDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(instance.getProcAddr("vkCmdEndDebugUtilsLabelEXT"));
+    }
+
+    void loadCalibrationFunctions(vk::Instance &instance, vk::Device &device)
+    {
+        pfnVkGetPhysicalDeviceCalibrateableTimeDomainsEXT = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+            instance.getProcAddr("vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+        pfnVkGetCalibratedTimestampsEXT = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(device.getProcAddr("vkGetCalibratedTimestampsEXT"));
+    }
+
+#ifdef VK_KHR_dynamic_rendering
+    void loadDynamicRenderingFunctions(vk::Device &device)
+    {
+        pfnVkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(device.getProcAddr("vkCmdBeginRenderingKHR"));
+        pfnVkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(device.getProcAddr("vkCmdEndRenderingKHR"));
+    }
+#endif
 }
\ No newline at end of file
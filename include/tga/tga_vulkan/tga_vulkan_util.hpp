@@ -1,11 +1,13 @@
 #pragma once
 #include "vulkan/vulkan.hpp"
+#include <optional>
 
 namespace tga
 {
     struct QueueIndices{
         uint32_t graphics;
         uint32_t transfer;
+        uint32_t compute; //The graphics family when the device has no separate compute family
     };
 
     struct Shader_TV{
@@ -15,6 +17,7 @@ namespace tga
     struct Buffer_TV{
         vk::Buffer buffer;
         vk::DeviceMemory memory;
+        vk::DeviceSize size;
     };
 
     struct Texture_TV{
@@ -24,32 +27,152 @@ namespace tga
         vk::Sampler sampler;
         vk::Extent3D extent;
         vk::Format format;
+        tga::Format createFormat; //As passed to createTexture
     };
 
     struct DepthBuffer_TV{
         vk::Image image;
         vk::ImageView imageView;
         vk::DeviceMemory memory;
+        uint32_t users; //Render passes whose framebuffers use it
     };
 
+    //Owner is the render target for depth kept between passes and 0 for shared transient depth
+    using DepthKey_TV = std::tuple<uint64_t, uint32_t, uint32_t, vk::Format, vk::SampleCountFlagBits>;
+
+
+    enum class ResourceKind{
+        buffer,
+        texture,
+        depthBuffer,
+        attachment,
+        staging,
+        readback,
+        count
+    };
+
+    struct Allocation_TV{
+        ResourceKind kind;
+        vk::DeviceSize size;
+        uint32_t memoryType;
+        uint64_t resource;
+    };
 
     struct InputSet_TV{
         vk::DescriptorPool descriptorPool;
         vk::DescriptorSet descriptorSet;
+        uint32_t setIndex;
+        uint32_t subpass;
+        std::vector<Texture> textures; //Handed over to the compute queue when bound by async compute
     };
 
+    struct Attachment_TV{
+        vk::Image image;
+        vk::ImageView imageView;
+        vk::DeviceMemory memory;
+    };
+
+    struct ColorTarget_TV{
+        Texture texture;
+        bool discardContent;
+    };
+
+    struct Subpass_TV{
+        std::vector<vk::DescriptorSetLayout> setLayouts; //The input attachment set comes last when there is one
+        vk::PipelineLayout pipelineLayout;
+        vk::Pipeline pipeline;
+        vk::DescriptorPool inputAttachmentPool;
+        vk::DescriptorSet inputAttachmentSet;
+        std::vector<std::vector<vk::DescriptorType>> descriptorTypes; //Per set and binding of the input layout
+    };
+
+    //Textures have a single subresource, so their state is tracked per texture
+    struct ImageState_TV{
+        vk::ImageLayout layout;
+        vk::AccessFlags access;
+        vk::PipelineStageFlags stages;
+    };
 
     struct RenderPass_TV{
         std::vector<vk::Framebuffer> framebuffers;
         vk::RenderPass renderPass;
-        std::vector<vk::DescriptorSetLayout> setLayouts;
-        vk::PipelineLayout pipelineLayout;
-        vk::Pipeline pipeline;
+        std::vector<Subpass_TV> subpasses;
         vk::Extent2D area;
+        std::vector<ColorTarget_TV> targetTextures; //Texture color targets, backbuffers are not tracked
+        std::optional<DepthKey_TV> depthBuffer;
+        std::vector<Attachment_TV> intermediateAttachments;
+        std::vector<Attachment_TV> multisampleAttachments; //One per color target, resolved into it. Empty without MSAA
+        std::vector<vk::ClearValue> clearValues;
+        //Passes recorded with dynamic rendering have no render pass and framebuffers, they keep the attachments themselves
+        std::vector<vk::AttachmentDescription> attachments;
+        std::vector<std::vector<vk::ImageView>> attachmentViews; //Per framebuffer index, in attachment order
+        std::vector<vk::Image> backbuffers; //Transitioned around the pass when rendering to a window
+        uint32_t colorCount;
+        bool compute; //A single compute pipeline, nothing is rendered
+    };
+
+    struct PassQuery_TV{
+        RenderPass renderPass;
+        uint32_t querySlot;
+    };
+
+    //Async compute on a separate queue family. The graphics queue signals graphicsReleased after handing the sampled textures over,
+    //graphicsAcquire takes them back in the first graphics submission that waits for computeFinished
+    struct ComputeSync_TV{
+        vk::Semaphore graphicsReleased;
+        vk::Semaphore computeFinished;
+        vk::CommandBuffer graphicsRelease;
+        vk::CommandBuffer graphicsAcquire;
+    };
+
+    struct ComputeWait_TV{
+        vk::Semaphore semaphore;
+        vk::CommandBuffer acquire;
     };
 
     struct CommandBuffer_TV{
         vk::CommandBuffer cmdBuffer;
+        std::vector<PassQuery_TV> passQueries;
+        bool asyncCompute;
+        bool waitsForCompute;
+        std::optional<ComputeSync_TV> computeSync;
+    };
+
+    struct PendingProfile_TV{
+        vk::Fence fence;
+        CommandBuffer commandBuffer;
+        uint64_t frame;
+    };
+
+    enum class TraceTrack{
+        cpu,
+        gpu
+    };
+
+    struct TraceEvent_TV{
+        std::string name;
+        TraceTrack track;
+        double startMicro;
+        double durationMicro;
+    };
+
+    struct Readback_TV{
+        vk::Buffer buffer;
+        vk::DeviceMemory memory;
+        uint8_t *mapping;
+        vk::DeviceSize capacity;
+        vk::DeviceSize size;
+        vk::Fence fence;
+        vk::CommandBuffer cmdBuffer;
+    };
+
+    struct Staging_TV{
+        vk::Buffer buffer;
+        vk::DeviceMemory memory;
+        uint8_t *mapping;
+        vk::DeviceSize capacity;
+        vk::Fence fence;
+        vk::CommandBuffer cmdBuffer;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "tga/tga.hpp"
+#include "tga/tga_vulkan/tga_vulkan.hpp"
+#include "tga/tga_export.hpp"
+
+#include <chrono>
+
+static std::vector<char> readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+    size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    file.close();
+    return buffer;
+}
+
+//Renders frames headless into a texture and streams them to disk
+//usage: sandbox_export [frameCount] [png|raw] [queueDepth]
+int main(int argc, char **argv)
+{
+    try
+    {
+        uint32_t frameCount = argc > 1?uint32_t(std::stoul(argv[1])):120;
+        auto format = (argc > 2 && std::string(argv[2]) == "raw")?tga::ExportFormat::raw:tga::ExportFormat::png;
+        uint32_t queueDepth = argc > 3?uint32_t(std::stoul(argv[3])):3;
+        uint32_t width = 1280;
+        uint32_t height = 720;
+
+        tga::TGAVulkan tgav(tga::TGAVulkanInfo(true));
+        auto vertData = readFile("shaders/rectangleVert.spv");
+        auto fragData = readFile("shaders/rectangleFrag.spv");
+        auto vertShader = tgav.createShader({tga::ShaderType::vertex,(uint8_t*)vertData.data(),vertData.size()});
+        auto fragShader = tgav.createShader({tga::ShaderType::fragment,(uint8_t*)fragData.data(),fragData.size()});
+        auto renderTex = tgav.createTexture({width,height,nullptr,0,tga::Format::r8g8b8a8_unorm});
+        auto renderPass = tgav.createRenderPass({{vertShader,fragShader},renderTex,{},tga::ClearOperation::all});
+
+        tgav.beginCommandBuffer({});
+        tgav.setRenderPass(renderPass,0);
+        tgav.draw(3,0);
+        auto cmdBuffer = tgav.endCommandBuffer();
+
+        std::string pattern = format == tga::ExportFormat::png?"frame_%05u.png":"frame_%05u.raw";
+        tga::FrameExporter exporter(tgav,{pattern,format,queueDepth});
+        for(uint32_t i = 0; i < frameCount; i++){
+            tgav.execute(cmdBuffer);
+            exporter.exportFrame(renderTex);
+        }
+        exporter.finish();
+
+        auto stats = exporter.stats();
+        std::cout << "Exported " << stats.framesExported << " frames at " << stats.framesPerSecond << " fps\n";
+        if(stats.framesFailed > 0)
+            std::cerr << stats.framesFailed << " frames failed: " << stats.lastError << '\n';
+        std::cout << "readback avg/max ms: " << stats.readback.averageMilli << '/' << stats.readback.maxMilli << '\n';
+        std::cout << "encode   avg/max ms: " << stats.encode.averageMilli << '/' << stats.encode.maxMilli << '\n';
+        std::cout << "write    avg/max ms: " << stats.write.averageMilli << '/' << stats.write.maxMilli << '\n';
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+}
@@ -0,0 +1,80 @@
+#include "tga/tga.hpp"
+#include "tga/tga_vulkan/tga_vulkan.hpp"
+#include "tga/tga_rendergraph.hpp"
+
+static std::vector<char> readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+    size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    file.close();
+    return buffer;
+}
+
+//Post processing chain declared as a render graph every frame
+//The ping pong targets of the chain alias each other, the debug pass is never read and gets culled
+int main(void)
+{
+    try
+    {
+        uint32_t width = 1280;
+        uint32_t height = 720;
+        uint32_t postPasses = 4;
+
+        tga::TGAVulkan tgav{};
+        auto vertData = readFile("shaders/rectangleVert.spv");
+        auto fragData = readFile("shaders/rectangleFrag.spv");
+        auto textureData = readFile("shaders/textureFrag.spv");
+        auto vertShader = tgav.createShader({tga::ShaderType::vertex,(uint8_t*)vertData.data(),vertData.size()});
+        auto fragShader = tgav.createShader({tga::ShaderType::fragment,(uint8_t*)fragData.data(),fragData.size()});
+        auto textureShader = tgav.createShader({tga::ShaderType::fragment,(uint8_t*)textureData.data(),textureData.size()});
+        auto window = tgav.createWindow({width,height,tga::PresentMode::vsync});
+
+        tga::InputLayout sampleLayout({tga::SetLayout({{tga::BindingType::sampler2D,1}})});
+        auto drawTriangle = [](tga::Interface &tgai){tgai.draw(3,0);};
+
+        tga::RenderGraph graph(tgav);
+        bool printedStats = false;
+        while(!tgav.windowShouldClose(window)){
+            auto nextFrame = tgav.nextFrame(window);
+
+            graph.reset();
+            tga::GraphTextureInfo colorInfo(width,height,tga::Format::r8g8b8a8_unorm,tga::SamplerMode::linear);
+            auto scene = graph.createTransient(colorInfo);
+            graph.addPass({"scene",{vertShader,fragShader},scene,{},drawTriangle,{},tga::ClearOperation::all});
+            auto debug = graph.createTransient(colorInfo);
+            graph.addPass({"debug",{vertShader,fragShader},debug,{},drawTriangle,{},tga::ClearOperation::all});
+            auto source = scene;
+            for(uint32_t p = 0; p < postPasses; p++){
+                auto target = graph.createTransient(colorInfo);
+                graph.addPass({"post" + std::to_string(p),{vertShader,textureShader},target,{{0,source,0}},drawTriangle,
+                    {},tga::ClearOperation::none,{},sampleLayout});
+                source = target;
+            }
+            graph.addPass({"present",{vertShader,textureShader},window,{{0,source,0}},drawTriangle,
+                {},tga::ClearOperation::all,{},sampleLayout});
+            graph.compile();
+
+            if(!printedStats){
+                auto stats = graph.stats();
+                std::cout << "passes " << stats.declaredPasses << " culled " << stats.culledPasses
+                    << ", transient textures " << stats.transientTextures << " on " << stats.physicalTextures << " physical, "
+                    << stats.transientBytes/1024 << "KiB -> " << stats.physicalBytes/1024 << "KiB\n";
+                printedStats = true;
+            }
+
+            auto cmdBuffer = graph.record(nextFrame);
+            tgav.execute(cmdBuffer);
+            tgav.present(window);
+            tgav.free(cmdBuffer);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+    }
+}
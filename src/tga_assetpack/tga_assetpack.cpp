@@ -0,0 +1,440 @@
+#include "tga/tga_assetpack.hpp"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tga
+{
+    namespace
+    {
+        constexpr char packMagic[8] = {'T','G','A','P','A','C','K','1'};
+        //Magic, offset of the table of contents and entry count, padded to the first blob
+        constexpr size_t headerSize = sizeof(packMagic)+sizeof(uint64_t)+sizeof(uint32_t);
+
+        constexpr size_t minMatch = 4;
+        constexpr size_t maxOffset = 0xFFFF;
+        constexpr uint32_t hashBits = 16;
+
+        void writeLength(std::vector<uint8_t> &out, size_t length)
+        {
+            for(; length >= 255; length -= 255)
+                out.push_back(255);
+            out.push_back(uint8_t(length));
+        }
+
+        //Token with literal length and match length - minMatch in its nibbles, literals, 16 bit offset.
+        //The last sequence only carries literals
+        void writeSequence(std::vector<uint8_t> &out, uint8_t const *literals, size_t literalLength, size_t offset, size_t matchLength)
+        {
+            size_t matchCode = matchLength?matchLength-minMatch:0;
+            out.push_back(uint8_t((std::min<size_t>(literalLength,15) << 4) | std::min<size_t>(matchCode,15)));
+            if(literalLength >= 15)
+                writeLength(out,literalLength-15);
+            out.insert(out.end(),literals,literals+literalLength);
+            if(!matchLength)
+                return;
+            out.push_back(uint8_t(offset));
+            out.push_back(uint8_t(offset >> 8));
+            if(matchCode >= 15)
+                writeLength(out,matchCode-15);
+        }
+
+        struct TocWriter{
+            std::vector<uint8_t> bytes;
+            template<typename T>
+            void value(T v)
+            {
+                auto begin = reinterpret_cast<uint8_t const*>(&v);
+                bytes.insert(bytes.end(),begin,begin+sizeof(T));
+            }
+        };
+
+        struct TocReader{
+            uint8_t const *data;
+            size_t size;
+            size_t position;
+            template<typename T>
+            T value()
+            {
+                if(position+sizeof(T) > size)
+                    throw std::runtime_error("[TGA AssetPack] Table of contents is truncated");
+                T v;
+                std::memcpy(&v,data+position,sizeof(T));
+                position += sizeof(T);
+                return v;
+            }
+            std::string string(size_t length)
+            {
+                if(position+length > size)
+                    throw std::runtime_error("[TGA AssetPack] Table of contents is truncated");
+                std::string s(reinterpret_cast<char const*>(data+position),length);
+                position += length;
+                return s;
+            }
+        };
+    }
+
+    std::vector<uint8_t> compressLZ(uint8_t const *data, size_t dataSize)
+    {
+        std::vector<uint8_t> out{};
+        out.reserve(dataSize/2+16);
+        std::vector<size_t> lastPosition(size_t(1) << hashBits,~size_t(0));
+        size_t anchor = 0;
+        size_t position = 0;
+        while(position+minMatch <= dataSize){
+            uint32_t sequence;
+            std::memcpy(&sequence,data+position,sizeof(sequence));
+            auto &candidate = lastPosition[(sequence*2654435761u) >> (32-hashBits)];
+            size_t match = candidate;
+            candidate = position;
+            if(match == ~size_t(0) || position-match > maxOffset || std::memcmp(data+match,data+position,minMatch) != 0){
+                position++;
+                continue;
+            }
+            size_t matchLength = minMatch;
+            while(position+matchLength < dataSize && data[match+matchLength] == data[position+matchLength])
+                matchLength++;
+            writeSequence(out,data+anchor,position-anchor,position-match,matchLength);
+            position += matchLength;
+            anchor = position;
+        }
+        if(anchor < dataSize)
+            writeSequence(out,data+anchor,dataSize-anchor,0,0);
+        return out;
+    }
+
+    void decompressLZ(uint8_t const *src, size_t srcSize, uint8_t *data, size_t dataSize)
+    {
+        size_t in = 0;
+        size_t out = 0;
+        auto corrupt = [](){
+            return std::runtime_error("[TGA AssetPack] Compressed blob is corrupt");
+        };
+        auto readLength = [&](size_t length){
+            if(length < 15)
+                return length;
+            uint8_t next;
+            do{
+                if(in >= srcSize)
+                    throw corrupt();
+                next = src[in++];
+                length += next;
+            }while(next == 255);
+            return length;
+        };
+        while(in < srcSize){
+            uint8_t token = src[in++];
+            size_t literalLength = readLength(token >> 4);
+            if(literalLength > srcSize-in || literalLength > dataSize-out)
+                throw corrupt();
+            std::memcpy(data+out,src+in,literalLength);
+            in += literalLength;
+            out += literalLength;
+            if(in == srcSize)
+                break;
+            if(srcSize-in < 2)
+                throw corrupt();
+            size_t offset = size_t(src[in]) | (size_t(src[in+1]) << 8);
+            in += 2;
+            size_t matchLength = readLength(token & 0xF)+minMatch;
+            if(offset == 0 || offset > out || matchLength > dataSize-out)
+                throw corrupt();
+            //Matches may overlap the bytes they produce, so they are copied front to back
+            uint8_t *destination = data+out;
+            uint8_t const *source = destination-offset;
+            if(offset >= matchLength){
+                std::memcpy(destination,source,matchLength);
+            }
+            else{
+                for(size_t i = 0; i < matchLength; i++)
+                    destination[i] = source[i];
+            }
+            out += matchLength;
+        }
+        if(out != dataSize)
+            throw corrupt();
+    }
+
+    AssetPackWriter::AssetPackWriter(const std::string &fileName):
+        file(fileName,std::ios::binary|std::ios::trunc),fileSize(0),finished(false)
+    {
+        if(!file.is_open())
+            throw std::runtime_error("[TGA AssetPack] Could not open " + fileName);
+        //The header is rewritten once the table of contents is known
+        std::vector<uint8_t> header(AssetPack::blobAlignment,0);
+        file.write(reinterpret_cast<char const*>(header.data()),header.size());
+        fileSize = header.size();
+    }
+
+    AssetPackWriter::~AssetPackWriter()
+    {
+        //Destructors must not throw, call finish explicitly to see write errors
+        try{
+            finish();
+        }
+        catch(const std::exception &e){
+            std::cerr << e.what() << '\n';
+        }
+    }
+
+    void AssetPackWriter::writeBlob(AssetEntry &entry, uint8_t const *data, size_t dataSize)
+    {
+        for(auto &other : entries)
+            if(other.name == entry.name)
+                throw std::runtime_error("[TGA AssetPack] Asset " + entry.name + " was added twice");
+        if(finished)
+            throw std::runtime_error("[TGA AssetPack] Pack is already finished");
+        if(data == nullptr && dataSize > 0)
+            throw std::runtime_error("[TGA AssetPack] Asset " + entry.name + " has a size but no data");
+        std::vector<uint8_t> compressed{};
+        if(entry.compression == AssetCompression::lz){
+            compressed = compressLZ(data,dataSize);
+            if(compressed.size() < dataSize){
+                data = compressed.data();
+            }
+            else{
+                entry.compression = AssetCompression::none;
+            }
+        }
+        entry.size = dataSize;
+        entry.storedSize = entry.compression == AssetCompression::lz?compressed.size():dataSize;
+        //Aligned blobs can be handed to the upload path and copied with wide loads straight from the mapping
+        uint64_t padding = (AssetPack::blobAlignment-fileSize%AssetPack::blobAlignment)%AssetPack::blobAlignment;
+        std::vector<char> zeros(padding,0);
+        file.write(zeros.data(),zeros.size());
+        entry.offset = fileSize+padding;
+        file.write(reinterpret_cast<char const*>(data),entry.storedSize);
+        fileSize = entry.offset+entry.storedSize;
+        entries.push_back(entry);
+    }
+
+    void AssetPackWriter::add(const std::string &name, const BufferInfo &bufferInfo, AssetCompression compression)
+    {
+        AssetEntry entry{};
+        entry.name = name;
+        entry.type = AssetType::buffer;
+        entry.compression = compression;
+        entry.bufferUsage = bufferInfo.usage;
+        writeBlob(entry,bufferInfo.data,bufferInfo.dataSize);
+    }
+    void AssetPackWriter::add(const std::string &name, const TextureInfo &textureInfo, AssetCompression compression)
+    {
+        AssetEntry entry{};
+        entry.name = name;
+        entry.type = AssetType::texture;
+        entry.compression = compression;
+        entry.width = textureInfo.width;
+        entry.height = textureInfo.height;
+        entry.format = textureInfo.format;
+        entry.samplerMode = textureInfo.samplerMode;
+        entry.repeatMode = textureInfo.repeatMode;
+        writeBlob(entry,textureInfo.data,textureInfo.dataSize);
+    }
+    void AssetPackWriter::add(const std::string &name, const ShaderInfo &shaderInfo, AssetCompression compression)
+    {
+        AssetEntry entry{};
+        entry.name = name;
+        entry.type = AssetType::shader;
+        entry.compression = compression;
+        entry.shaderType = shaderInfo.type;
+        writeBlob(entry,shaderInfo.src,shaderInfo.srcSize);
+    }
+
+    void AssetPackWriter::finish()
+    {
+        if(finished)
+            return;
+        finished = true;
+        TocWriter toc{};
+        for(auto &entry : entries){
+            toc.value(uint32_t(entry.name.size()));
+            toc.bytes.insert(toc.bytes.end(),entry.name.begin(),entry.name.end());
+            toc.value(uint8_t(entry.type));
+            toc.value(uint8_t(entry.compression));
+            toc.value(entry.offset);
+            toc.value(entry.storedSize);
+            toc.value(entry.size);
+            toc.value(uint32_t(entry.bufferUsage));
+            toc.value(uint32_t(entry.shaderType));
+            toc.value(entry.width);
+            toc.value(entry.height);
+            toc.value(uint32_t(entry.format));
+            toc.value(uint32_t(entry.samplerMode));
+            toc.value(uint32_t(entry.repeatMode));
+        }
+        uint64_t tocOffset = fileSize;
+        file.write(reinterpret_cast<char const*>(toc.bytes.data()),toc.bytes.size());
+
+        TocWriter header{};
+        header.bytes.insert(header.bytes.end(),std::begin(packMagic),std::end(packMagic));
+        header.value(tocOffset);
+        header.value(uint32_t(entries.size()));
+        file.seekp(0);
+        file.write(reinterpret_cast<char const*>(header.bytes.data()),header.bytes.size());
+        file.close();
+        if(file.fail())
+            throw std::runtime_error("[TGA AssetPack] Writing the pack failed");
+    }
+
+    AssetPack::AssetPack(const std::string &fileName):mapping(nullptr),mappingSize(0)
+    {
+#ifdef _WIN32
+        HANDLE fileHandle = CreateFileA(fileName.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+        if(fileHandle == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("[TGA AssetPack] Could not open " + fileName);
+        LARGE_INTEGER size;
+        GetFileSizeEx(fileHandle,&size);
+        mappingSize = size_t(size.QuadPart);
+        HANDLE mappingHandle = mappingSize >= headerSize?CreateFileMappingA(fileHandle,nullptr,PAGE_READONLY,0,0,nullptr):nullptr;
+        if(mappingHandle){
+            mapping = static_cast<uint8_t const*>(MapViewOfFile(mappingHandle,FILE_MAP_READ,0,0,0));
+            CloseHandle(mappingHandle);
+        }
+        CloseHandle(fileHandle);
+#else
+        int fd = open(fileName.c_str(),O_RDONLY);
+        if(fd < 0)
+            throw std::runtime_error("[TGA AssetPack] Could not open " + fileName);
+        struct stat fileStat;
+        if(fstat(fd,&fileStat) == 0 && size_t(fileStat.st_size) >= headerSize){
+            mappingSize = size_t(fileStat.st_size);
+            void *address = mmap(nullptr,mappingSize,PROT_READ,MAP_PRIVATE,fd,0);
+            mapping = address == MAP_FAILED?nullptr:static_cast<uint8_t const*>(address);
+        }
+        //The mapping keeps the file alive
+        close(fd);
+#endif
+        if(!mapping)
+            throw std::runtime_error("[TGA AssetPack] Could not map " + fileName);
+
+        try{
+            if(std::memcmp(mapping,packMagic,sizeof(packMagic)) != 0)
+                throw std::runtime_error("[TGA AssetPack] " + fileName + " is not an asset pack of this version");
+            TocReader header{mapping,headerSize,sizeof(packMagic)};
+            auto tocOffset = header.value<uint64_t>();
+            auto entryCount = header.value<uint32_t>();
+            if(tocOffset > mappingSize)
+                throw std::runtime_error("[TGA AssetPack] Table of contents is truncated");
+            TocReader toc{mapping+tocOffset,mappingSize-size_t(tocOffset),0};
+            tableOfContents.reserve(entryCount);
+            for(uint32_t i = 0; i < entryCount; i++){
+                AssetEntry entry{};
+                entry.name = toc.string(toc.value<uint32_t>());
+                entry.type = AssetType(toc.value<uint8_t>());
+                entry.compression = AssetCompression(toc.value<uint8_t>());
+                entry.offset = toc.value<uint64_t>();
+                entry.storedSize = toc.value<uint64_t>();
+                entry.size = toc.value<uint64_t>();
+                entry.bufferUsage = BufferUsage(toc.value<uint32_t>());
+                entry.shaderType = ShaderType(toc.value<uint32_t>());
+                entry.width = toc.value<uint32_t>();
+                entry.height = toc.value<uint32_t>();
+                entry.format = Format(toc.value<uint32_t>());
+                entry.samplerMode = SamplerMode(toc.value<uint32_t>());
+                entry.repeatMode = RepeatMode(toc.value<uint32_t>());
+                if(entry.offset > tocOffset || entry.storedSize > tocOffset-entry.offset)
+                    throw std::runtime_error("[TGA AssetPack] Asset " + entry.name + " lies outside of the pack");
+                if(entry.type > AssetType::shader || entry.compression > AssetCompression::lz)
+                    throw std::runtime_error("[TGA AssetPack] Asset " + entry.name + " has an unknown type or compression");
+                //Uncompressed blobs are returned straight from the mapping with their size
+                if(entry.compression == AssetCompression::none && entry.size != entry.storedSize)
+                    throw std::runtime_error("[TGA AssetPack] Asset " + entry.name + " has inconsistent sizes");
+                entryIndices[entry.name] = tableOfContents.size();
+                tableOfContents.push_back(entry);
+            }
+        }
+        catch(...){
+            unmap();
+            throw;
+        }
+    }
+
+    AssetPack::~AssetPack()
+    {
+        unmap();
+    }
+
+    void AssetPack::unmap()
+    {
+        if(!mapping)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(const_cast<uint8_t*>(mapping),mappingSize);
+#endif
+        mapping = nullptr;
+    }
+
+    bool AssetPack::contains(const std::string &name) const
+    {
+        return entryIndices.find(name) != entryIndices.end();
+    }
+
+    const AssetEntry& AssetPack::entry(const std::string &name) const
+    {
+        auto index = entryIndices.find(name);
+        if(index == entryIndices.end())
+            throw std::runtime_error("[TGA AssetPack] Asset " + name + " is not in the pack");
+        return tableOfContents[index->second];
+    }
+
+    const std::vector<AssetEntry>& AssetPack::entries() const
+    {
+        return tableOfContents;
+    }
+
+    const AssetEntry& AssetPack::entryOfType(const std::string &name, AssetType type) const
+    {
+        auto &assetEntry = entry(name);
+        if(assetEntry.type != type)
+            throw std::runtime_error("[TGA AssetPack] Asset " + name + " has a different type");
+        return assetEntry;
+    }
+
+    std::pair<uint8_t const*, size_t> AssetPack::data(const std::string &name)
+    {
+        auto &assetEntry = entry(name);
+        if(assetEntry.compression == AssetCompression::none)
+            return {mapping+assetEntry.offset,size_t(assetEntry.size)};
+        auto cached = decompressed.find(name);
+        if(cached == decompressed.end()){
+            std::vector<uint8_t> blob(assetEntry.size);
+            decompressLZ(mapping+assetEntry.offset,size_t(assetEntry.storedSize),blob.data(),blob.size());
+            cached = decompressed.emplace(name,std::move(blob)).first;
+        }
+        return {cached->second.data(),cached->second.size()};
+    }
+
+    BufferInfo AssetPack::bufferInfo(const std::string &name)
+    {
+        auto &assetEntry = entryOfType(name,AssetType::buffer);
+        auto [blob,blobSize] = data(name);
+        return {assetEntry.bufferUsage,blob,blobSize};
+    }
+
+    TextureInfo AssetPack::textureInfo(const std::string &name)
+    {
+        auto &assetEntry = entryOfType(name,AssetType::texture);
+        auto [blob,blobSize] = data(name);
+        return {assetEntry.width,assetEntry.height,blob,blobSize,assetEntry.format,assetEntry.samplerMode,assetEntry.repeatMode};
+    }
+
+    ShaderInfo AssetPack::shaderInfo(const std::string &name)
+    {
+        auto &assetEntry = entryOfType(name,AssetType::shader);
+        auto [blob,blobSize] = data(name);
+        return {assetEntry.shaderType,blob,blobSize};
+    }
+
+    void AssetPack::release(const std::string &name)
+    {
+        decompressed.erase(name);
+    }
+}
@@ -0,0 +1,968 @@
+#include "tga/tga_capture.hpp"
+#include <chrono>
+
+namespace tga
+{
+    namespace
+    {
+        const char captureMagic[8] = {'T','G','A','C','A','P','1','0'};
+
+        enum class Call : uint8_t{
+            createShader = 1,
+            createBuffer,
+            createTexture,
+            createWindow,
+            createInputSet,
+            createRenderPass,
+            beginCommandBuffer,
+            setRenderPass,
+            bindVertexBuffer,
+            bindIndexBuffer,
+            bindInputSet,
+            draw,
+            drawIndexed,
+            endCommandBuffer,
+            execute,
+            updateBuffer,
+            readBuffer,
+            readTexture,
+            readbackReady,
+            readbackData,
+            backbufferCount,
+            nextFrame,
+            present,
+            setWindowTitel,
+            windowShouldClose,
+            keyDown,
+            mousePosition,
+            freeShader,
+            freeBuffer,
+            freeTexture,
+            freeWindow,
+            freeInputSet,
+            freeRenderPass,
+            freeCommandBuffer,
+            freeReadback,
+            nextSubpass,
+            dispatch,
+            pollInput,
+            takeInputEvents,
+            inputSnapshot,
+            textureProperties
+        };
+
+        template<typename TgaHandle, typename Handle>
+        uint64_t rawHandle(Handle handle)
+        {
+            return uint64_t(reinterpret_cast<uintptr_t>(TgaHandle(handle)));
+        }
+
+        //Zigzag keeps small negative values (e.g. mouse positions) short
+        uint64_t zigzag(int64_t value)
+        {
+            return (uint64_t(value)<<1)^uint64_t(value>>63);
+        }
+
+        class CaptureReader{
+            public:
+            CaptureReader(const std::string &captureFile):file(captureFile,std::ios::binary)
+            {
+                if(!file.is_open())
+                    throw std::runtime_error("Could not open capture file " + captureFile);
+                char magic[sizeof(captureMagic)];
+                file.read(magic,sizeof(magic));
+                if(!file || !std::equal(magic,magic+sizeof(magic),captureMagic))
+                    throw std::runtime_error("Not a TGA capture file: " + captureFile);
+            }
+
+            bool nextCall(Call &call)
+            {
+                int byte = file.get();
+                if(byte == std::char_traits<char>::eof())
+                    return false;
+                call = Call(byte);
+                return true;
+            }
+
+            uint64_t varint()
+            {
+                uint64_t value = 0;
+                for(uint32_t shift = 0; shift < 64; shift += 7){
+                    int byte = file.get();
+                    if(byte == std::char_traits<char>::eof())
+                        throw std::runtime_error("Capture file is truncated");
+                    value |= uint64_t(byte&0x7f)<<shift;
+                    if(!(byte&0x80))
+                        return value;
+                }
+                throw std::runtime_error("Capture file contains a malformed integer");
+            }
+
+            uint32_t u32()
+            {
+                return uint32_t(varint());
+            }
+
+            template<typename Enum>
+            Enum enumeration()
+            {
+                return Enum(varint());
+            }
+
+            std::vector<uint8_t> const& bytes()
+            {
+                payload.resize(size_t(varint()));
+                file.read(reinterpret_cast<char*>(payload.data()),std::streamsize(payload.size()));
+                if(!file)
+                    throw std::runtime_error("Capture file is truncated");
+                payloadBytes += payload.size();
+                return payload;
+            }
+
+            std::string string()
+            {
+                auto &data = bytes();
+                return std::string(data.begin(),data.end());
+            }
+
+            uint64_t payloadBytes = 0;
+
+            private:
+            std::ifstream file;
+            std::vector<uint8_t> payload;
+        };
+
+        VertexLayout readVertexLayout(CaptureReader &reader)
+        {
+            VertexLayout vertexLayout{};
+            vertexLayout.vertexSize = size_t(reader.varint());
+            vertexLayout.vertexAttributes.resize(size_t(reader.varint()));
+            for(auto &attribute : vertexLayout.vertexAttributes){
+                attribute.offset = size_t(reader.varint());
+                attribute.format = reader.enumeration<Format>();
+            }
+            return vertexLayout;
+        }
+
+        RasterizerConfig readRasterizerConfig(CaptureReader &reader)
+        {
+            RasterizerConfig rasterizerConfig{};
+            rasterizerConfig.depthCompareOp = reader.enumeration<CompareOperation>();
+            rasterizerConfig.blendEnabled = reader.varint() != 0;
+            rasterizerConfig.srcBlend = reader.enumeration<BlendFactor>();
+            rasterizerConfig.dstBlend = reader.enumeration<BlendFactor>();
+            rasterizerConfig.frontFace = reader.enumeration<FrontFace>();
+            rasterizerConfig.cullMode = reader.enumeration<CullMode>();
+            rasterizerConfig.polygonMode = reader.enumeration<PolygonMode>();
+            return rasterizerConfig;
+        }
+
+        InputLayout readInputLayout(CaptureReader &reader)
+        {
+            InputLayout inputLayout{};
+            inputLayout.setLayouts.resize(size_t(reader.varint()));
+            for(auto &setLayout : inputLayout.setLayouts){
+                auto bindingCount = size_t(reader.varint());
+                for(size_t i = 0; i < bindingCount; i++){
+                    auto type = reader.enumeration<BindingType>();
+                    setLayout.bindingLayouts.emplace_back(type,reader.u32());
+                }
+            }
+            return inputLayout;
+        }
+
+        template<typename Handle>
+        struct HandleTable{
+            std::unordered_map<uint64_t, Handle> handles;
+            Handle get(uint64_t id) const
+            {
+                if(id == 0)
+                    return Handle();
+                auto it = handles.find(id);
+                if(it == handles.end())
+                    throw std::runtime_error("Capture file references an unknown handle");
+                return it->second;
+            }
+            Handle remove(uint64_t id)
+            {
+                auto handle = get(id);
+                handles.erase(id);
+                return handle;
+            }
+        };
+    }
+
+    uint64_t CaptureInterface::HandleIds::add(uint64_t handle)
+    {
+        if(handle == 0)
+            return 0;
+        ids[handle] = nextId;
+        return nextId++;
+    }
+    uint64_t CaptureInterface::HandleIds::get(uint64_t handle) const
+    {
+        auto it = ids.find(handle);
+        return it == ids.end()?0:it->second;
+    }
+    uint64_t CaptureInterface::HandleIds::remove(uint64_t handle)
+    {
+        auto id = get(handle);
+        ids.erase(handle);
+        return id;
+    }
+
+    CaptureInterface::CaptureInterface(Interface &_target, const std::string &captureFile):
+        target(_target),file(captureFile,std::ios::binary),bytesWritten(0)
+    {
+        if(!file.is_open())
+            throw std::runtime_error("Could not open capture file " + captureFile);
+        file.write(captureMagic,sizeof(captureMagic));
+        bytesWritten += sizeof(captureMagic);
+    }
+
+    CaptureInterface::~CaptureInterface()
+    {
+        file.flush();
+    }
+
+    uint64_t CaptureInterface::captureSize() const
+    {
+        return bytesWritten;
+    }
+
+    void CaptureInterface::writeCall(uint8_t call)
+    {
+        file.put(char(call));
+        bytesWritten++;
+    }
+    void CaptureInterface::writeVarint(uint64_t value)
+    {
+        do{
+            uint8_t byte = value&0x7f;
+            value >>= 7;
+            file.put(char(value?byte|0x80:byte));
+            bytesWritten++;
+        }while(value);
+    }
+    void CaptureInterface::writeBytes(uint8_t const *data, size_t size)
+    {
+        writeVarint(size);
+        file.write(reinterpret_cast<char const*>(data),std::streamsize(size));
+        bytesWritten += size;
+    }
+    void CaptureInterface::writeString(const std::string &string)
+    {
+        writeBytes(reinterpret_cast<uint8_t const*>(string.data()),string.size());
+    }
+
+    Shader CaptureInterface::createShader(const ShaderInfo &shaderInfo)
+    {
+        auto shader = target.createShader(shaderInfo);
+        writeCall(uint8_t(Call::createShader));
+        writeVarint(uint64_t(shaderInfo.type));
+        writeBytes(shaderInfo.src,shaderInfo.srcSize);
+        writeVarint(shaderIds.add(rawHandle<TgaShader>(shader)));
+        return shader;
+    }
+    Buffer CaptureInterface::createBuffer(const BufferInfo &bufferInfo)
+    {
+        auto buffer = target.createBuffer(bufferInfo);
+        writeCall(uint8_t(Call::createBuffer));
+        writeVarint(uint64_t(bufferInfo.usage));
+        writeVarint(bufferInfo.dataSize);
+        writeBytes(bufferInfo.data,bufferInfo.data?bufferInfo.dataSize:0);
+        writeVarint(bufferIds.add(rawHandle<TgaBuffer>(buffer)));
+        return buffer;
+    }
+    Texture CaptureInterface::createTexture(const TextureInfo &textureInfo)
+    {
+        auto texture = target.createTexture(textureInfo);
+        writeCall(uint8_t(Call::createTexture));
+        writeVarint(textureInfo.width);
+        writeVarint(textureInfo.height);
+        writeVarint(textureInfo.dataSize);
+        writeBytes(textureInfo.data,textureInfo.data?textureInfo.dataSize:0);
+        writeVarint(uint64_t(textureInfo.format));
+        writeVarint(uint64_t(textureInfo.samplerMode));
+        writeVarint(uint64_t(textureInfo.repeatMode));
+        writeVarint(textureIds.add(rawHandle<TgaTexture>(texture)));
+        return texture;
+    }
+    Window CaptureInterface::createWindow(const WindowInfo &windowInfo)
+    {
+        auto window = target.createWindow(windowInfo);
+        writeCall(uint8_t(Call::createWindow));
+        writeVarint(windowInfo.width);
+        writeVarint(windowInfo.height);
+        writeVarint(uint64_t(windowInfo.presentMode));
+        writeVarint(windowInfo.framebufferCount);
+        writeVarint(windowInfo.maxQueuedFrames);
+        writeVarint(windowInfo.frameRateLimit);
+        writeVarint(windowIds.add(rawHandle<TgaWindow>(window)));
+        return window;
+    }
+    InputSet CaptureInterface::createInputSet(const InputSetInfo &inputSetInfo)
+    {
+        auto inputSet = target.createInputSet(inputSetInfo);
+        writeCall(uint8_t(Call::createInputSet));
+        writeVarint(renderPassIds.get(rawHandle<TgaRenderPass>(inputSetInfo.targetRenderPass)));
+        writeVarint(inputSetInfo.setIndex);
+        writeVarint(inputSetInfo.bindings.size());
+        for(auto &binding : inputSetInfo.bindings){
+            writeVarint(binding.resource.index());
+            if(auto buffer = std::get_if<Buffer>(&binding.resource))
+                writeVarint(bufferIds.get(rawHandle<TgaBuffer>(*buffer)));
+            else
+                writeVarint(textureIds.get(rawHandle<TgaTexture>(std::get<Texture>(binding.resource))));
+            writeVarint(binding.slot);
+            writeVarint(binding.arrayElement);
+        }
+        writeVarint(inputSetInfo.subpass);
+        writeVarint(inputSetIds.add(rawHandle<TgaInputSet>(inputSet)));
+        return inputSet;
+    }
+    RenderPass CaptureInterface::createRenderPass(const RenderPassInfo &renderPassInfo)
+    {
+        auto renderPass = target.createRenderPass(renderPassInfo);
+        writeCall(uint8_t(Call::createRenderPass));
+        writeVarint(renderPassInfo.shaderStages.size());
+        for(auto &shader : renderPassInfo.shaderStages)
+            writeVarint(shaderIds.get(rawHandle<TgaShader>(shader)));
+        writeVarint(renderPassInfo.renderTarget.index());
+        if(auto texture = std::get_if<Texture>(&renderPassInfo.renderTarget))
+            writeVarint(textureIds.get(rawHandle<TgaTexture>(*texture)));
+        else
+            writeVarint(windowIds.get(rawHandle<TgaWindow>(std::get<Window>(renderPassInfo.renderTarget))));
+        writeVarint(uint64_t(renderPassInfo.clearOperations));
+        writeVertexLayout(renderPassInfo.vertexLayout);
+        writeRasterizerConfig(renderPassInfo.rasterizerConfig);
+        writeInputLayout(renderPassInfo.inputLayout);
+        writeVarint(uint64_t(renderPassInfo.depthConfig.format));
+        writeVarint(uint64_t(renderPassInfo.depthConfig.loadOperation));
+        writeVarint(uint64_t(renderPassInfo.depthConfig.storeOperation));
+        writeVarint(renderPassInfo.intermediateAttachments.size());
+        for(auto format : renderPassInfo.intermediateAttachments)
+            writeVarint(uint64_t(format));
+        writeVarint(renderPassInfo.subpasses.size());
+        for(auto &subpass : renderPassInfo.subpasses){
+            writeVarint(subpass.shaderStages.size());
+            for(auto &shader : subpass.shaderStages)
+                writeVarint(shaderIds.get(rawHandle<TgaShader>(shader)));
+            writeVarint(subpass.colorAttachments.size());
+            for(auto attachment : subpass.colorAttachments)
+                writeVarint(attachment);
+            writeVarint(subpass.inputAttachments.size());
+            for(auto attachment : subpass.inputAttachments)
+                writeVarint(attachment);
+            writeVertexLayout(subpass.vertexLayout);
+            writeRasterizerConfig(subpass.rasterizerConfig);
+            writeInputLayout(subpass.inputLayout);
+        }
+        writeVarint(renderPassInfo.additionalTargets.size());
+        for(auto &colorTarget : renderPassInfo.additionalTargets){
+            writeVarint(textureIds.get(rawHandle<TgaTexture>(colorTarget.texture)));
+            writeVarint(uint64_t(colorTarget.loadOperation));
+            writeVarint(uint64_t(colorTarget.storeOperation));
+            writeVarint(colorTarget.blendEnabled);
+            writeVarint(uint64_t(colorTarget.srcBlend));
+            writeVarint(uint64_t(colorTarget.dstBlend));
+        }
+        writeVarint(uint64_t(renderPassInfo.sampleCount));
+        writeVarint(renderPassIds.add(rawHandle<TgaRenderPass>(renderPass)));
+        return renderPass;
+    }
+
+    void CaptureInterface::writeVertexLayout(const VertexLayout &vertexLayout)
+    {
+        writeVarint(vertexLayout.vertexSize);
+        writeVarint(vertexLayout.vertexAttributes.size());
+        for(auto &attribute : vertexLayout.vertexAttributes){
+            writeVarint(attribute.offset);
+            writeVarint(uint64_t(attribute.format));
+        }
+    }
+    void CaptureInterface::writeRasterizerConfig(const RasterizerConfig &rasterizerConfig)
+    {
+        writeVarint(uint64_t(rasterizerConfig.depthCompareOp));
+        writeVarint(rasterizerConfig.blendEnabled);
+        writeVarint(uint64_t(rasterizerConfig.srcBlend));
+        writeVarint(uint64_t(rasterizerConfig.dstBlend));
+        writeVarint(uint64_t(rasterizerConfig.frontFace));
+        writeVarint(uint64_t(rasterizerConfig.cullMode));
+        writeVarint(uint64_t(rasterizerConfig.polygonMode));
+    }
+    void CaptureInterface::writeInputLayout(const InputLayout &inputLayout)
+    {
+        writeVarint(inputLayout.setLayouts.size());
+        for(auto &setLayout : inputLayout.setLayouts){
+            writeVarint(setLayout.bindingLayouts.size());
+            for(auto &bindingLayout : setLayout.bindingLayouts){
+                writeVarint(uint64_t(bindingLayout.type));
+                writeVarint(bindingLayout.count);
+            }
+        }
+    }
+
+    void CaptureInterface::beginCommandBuffer(const CommandBufferInfo &commandBufferInfo)
+    {
+        target.beginCommandBuffer(commandBufferInfo);
+        writeCall(uint8_t(Call::beginCommandBuffer));
+        writeVarint(commandBufferInfo.asyncCompute);
+        writeVarint(commandBufferInfo.waitsForCompute);
+    }
+    void CaptureInterface::setRenderPass(RenderPass renderPass, uint32_t framebufferIndex)
+    {
+        target.setRenderPass(renderPass,framebufferIndex);
+        writeCall(uint8_t(Call::setRenderPass));
+        writeVarint(renderPassIds.get(rawHandle<TgaRenderPass>(renderPass)));
+        writeVarint(framebufferIndex);
+    }
+    void CaptureInterface::nextSubpass()
+    {
+        target.nextSubpass();
+        writeCall(uint8_t(Call::nextSubpass));
+    }
+    void CaptureInterface::bindVertexBuffer(Buffer buffer)
+    {
+        target.bindVertexBuffer(buffer);
+        writeCall(uint8_t(Call::bindVertexBuffer));
+        writeVarint(bufferIds.get(rawHandle<TgaBuffer>(buffer)));
+    }
+    void CaptureInterface::bindIndexBuffer(Buffer buffer, IndexType indexType)
+    {
+        target.bindIndexBuffer(buffer,indexType);
+        writeCall(uint8_t(Call::bindIndexBuffer));
+        writeVarint(bufferIds.get(rawHandle<TgaBuffer>(buffer)));
+        writeVarint(uint64_t(indexType));
+    }
+    void CaptureInterface::bindInputSet(InputSet inputSet)
+    {
+        target.bindInputSet(inputSet);
+        writeCall(uint8_t(Call::bindInputSet));
+        writeVarint(inputSetIds.get(rawHandle<TgaInputSet>(inputSet)));
+    }
+    void CaptureInterface::draw(uint32_t vertexCount, uint32_t firstVertex)
+    {
+        target.draw(vertexCount,firstVertex);
+        writeCall(uint8_t(Call::draw));
+        writeVarint(vertexCount);
+        writeVarint(firstVertex);
+    }
+    void CaptureInterface::drawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset)
+    {
+        target.drawIndexed(indexCount,firstIndex,vertexOffset);
+        writeCall(uint8_t(Call::drawIndexed));
+        writeVarint(indexCount);
+        writeVarint(firstIndex);
+        writeVarint(vertexOffset);
+    }
+    void CaptureInterface::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+    {
+        target.dispatch(groupCountX,groupCountY,groupCountZ);
+        writeCall(uint8_t(Call::dispatch));
+        writeVarint(groupCountX);
+        writeVarint(groupCountY);
+        writeVarint(groupCountZ);
+    }
+    CommandBuffer CaptureInterface::endCommandBuffer()
+    {
+        auto commandBuffer = target.endCommandBuffer();
+        writeCall(uint8_t(Call::endCommandBuffer));
+        writeVarint(commandBufferIds.add(rawHandle<TgaCommandBuffer>(commandBuffer)));
+        return commandBuffer;
+    }
+    void CaptureInterface::execute(CommandBuffer commandBuffer)
+    {
+        target.execute(commandBuffer);
+        writeCall(uint8_t(Call::execute));
+        writeVarint(commandBufferIds.get(rawHandle<TgaCommandBuffer>(commandBuffer)));
+    }
+
+    void CaptureInterface::updateBuffer(Buffer buffer, uint8_t const *data, size_t dataSize, uint32_t offset)
+    {
+        target.updateBuffer(buffer,data,dataSize,offset);
+        writeCall(uint8_t(Call::updateBuffer));
+        writeVarint(bufferIds.get(rawHandle<TgaBuffer>(buffer)));
+        writeBytes(data,dataSize);
+        writeVarint(offset);
+    }
+
+    Readback CaptureInterface::readBuffer(Buffer buffer, size_t dataSize, uint32_t offset)
+    {
+        auto readback = target.readBuffer(buffer,dataSize,offset);
+        writeCall(uint8_t(Call::readBuffer));
+        writeVarint(bufferIds.get(rawHandle<TgaBuffer>(buffer)));
+        writeVarint(dataSize);
+        writeVarint(offset);
+        writeVarint(readbackIds.add(rawHandle<TgaReadback>(readback)));
+        return readback;
+    }
+    Readback CaptureInterface::readTexture(Texture texture)
+    {
+        auto readback = target.readTexture(texture);
+        writeCall(uint8_t(Call::readTexture));
+        writeVarint(textureIds.get(rawHandle<TgaTexture>(texture)));
+        writeVarint(readbackIds.add(rawHandle<TgaReadback>(readback)));
+        return readback;
+    }
+    bool CaptureInterface::readbackReady(Readback readback)
+    {
+        auto ready = target.readbackReady(readback);
+        writeCall(uint8_t(Call::readbackReady));
+        writeVarint(readbackIds.get(rawHandle<TgaReadback>(readback)));
+        writeVarint(ready);
+        return ready;
+    }
+    std::pair<uint8_t const*, size_t> CaptureInterface::readbackData(Readback readback)
+    {
+        auto data = target.readbackData(readback);
+        writeCall(uint8_t(Call::readbackData));
+        writeVarint(readbackIds.get(rawHandle<TgaReadback>(readback)));
+        return data;
+    }
+
+    TextureProperties CaptureInterface::textureProperties(Texture texture)
+    {
+        auto properties = target.textureProperties(texture);
+        writeCall(uint8_t(Call::textureProperties));
+        writeVarint(textureIds.get(rawHandle<TgaTexture>(texture)));
+        writeVarint(properties.width);
+        writeVarint(properties.height);
+        writeVarint(uint64_t(properties.format));
+        return properties;
+    }
+
+    uint32_t CaptureInterface::backbufferCount(Window window)
+    {
+        auto count = target.backbufferCount(window);
+        writeCall(uint8_t(Call::backbufferCount));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeVarint(count);
+        return count;
+    }
+    uint32_t CaptureInterface::nextFrame(Window window)
+    {
+        auto frame = target.nextFrame(window);
+        writeCall(uint8_t(Call::nextFrame));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeVarint(frame);
+        return frame;
+    }
+    void CaptureInterface::present(Window window)
+    {
+        target.present(window);
+        writeCall(uint8_t(Call::present));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+    }
+    void CaptureInterface::setWindowTitel(Window window, const std::string &title)
+    {
+        target.setWindowTitel(window,title);
+        writeCall(uint8_t(Call::setWindowTitel));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeString(title);
+    }
+
+    bool CaptureInterface::windowShouldClose(Window window)
+    {
+        auto shouldClose = target.windowShouldClose(window);
+        writeCall(uint8_t(Call::windowShouldClose));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeVarint(shouldClose);
+        return shouldClose;
+    }
+    bool CaptureInterface::keyDown(Window window, Key key)
+    {
+        auto down = target.keyDown(window,key);
+        writeCall(uint8_t(Call::keyDown));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeVarint(uint64_t(key));
+        writeVarint(down);
+        return down;
+    }
+    std::pair<int, int> CaptureInterface::mousePosition(Window window)
+    {
+        auto position = target.mousePosition(window);
+        writeCall(uint8_t(Call::mousePosition));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeVarint(zigzag(position.first));
+        writeVarint(zigzag(position.second));
+        return position;
+    }
+    void CaptureInterface::pollInput()
+    {
+        target.pollInput();
+        writeCall(uint8_t(Call::pollInput));
+    }
+    //Cursor positions are stored in whole pixels and times in microseconds
+    std::vector<InputEvent> CaptureInterface::takeInputEvents(Window window)
+    {
+        auto events = target.takeInputEvents(window);
+        writeCall(uint8_t(Call::takeInputEvents));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeVarint(events.size());
+        for(auto &event : events){
+            writeVarint(uint64_t(event.type));
+            writeVarint(uint64_t(event.key));
+            writeVarint(zigzag(int64_t(event.x)));
+            writeVarint(zigzag(int64_t(event.y)));
+            writeVarint(uint64_t(event.time*1e6));
+        }
+        return events;
+    }
+    InputSnapshot CaptureInterface::inputSnapshot(Window window)
+    {
+        auto snapshot = target.inputSnapshot(window);
+        writeCall(uint8_t(Call::inputSnapshot));
+        writeVarint(windowIds.get(rawHandle<TgaWindow>(window)));
+        writeVarint(zigzag(int64_t(snapshot.mouseX)));
+        writeVarint(zigzag(int64_t(snapshot.mouseY)));
+        writeVarint(uint64_t(std::count(snapshot.keys.begin(),snapshot.keys.end(),true)));
+        for(size_t key = 0; key < snapshot.keys.size(); key++)
+            if(snapshot.keys[key])
+                writeVarint(key);
+        return snapshot;
+    }
+
+    void CaptureInterface::free(Shader shader)
+    {
+        target.free(shader);
+        writeCall(uint8_t(Call::freeShader));
+        writeVarint(shaderIds.remove(rawHandle<TgaShader>(shader)));
+    }
+    void CaptureInterface::free(Buffer buffer)
+    {
+        target.free(buffer);
+        writeCall(uint8_t(Call::freeBuffer));
+        writeVarint(bufferIds.remove(rawHandle<TgaBuffer>(buffer)));
+    }
+    void CaptureInterface::free(Texture texture)
+    {
+        target.free(texture);
+        writeCall(uint8_t(Call::freeTexture));
+        writeVarint(textureIds.remove(rawHandle<TgaTexture>(texture)));
+    }
+    void CaptureInterface::free(Window window)
+    {
+        target.free(window);
+        writeCall(uint8_t(Call::freeWindow));
+        writeVarint(windowIds.remove(rawHandle<TgaWindow>(window)));
+    }
+    void CaptureInterface::free(InputSet inputSet)
+    {
+        target.free(inputSet);
+        writeCall(uint8_t(Call::freeInputSet));
+        writeVarint(inputSetIds.remove(rawHandle<TgaInputSet>(inputSet)));
+    }
+    void CaptureInterface::free(RenderPass renderPass)
+    {
+        target.free(renderPass);
+        writeCall(uint8_t(Call::freeRenderPass));
+        writeVarint(renderPassIds.remove(rawHandle<TgaRenderPass>(renderPass)));
+    }
+    void CaptureInterface::free(CommandBuffer commandBuffer)
+    {
+        target.free(commandBuffer);
+        writeCall(uint8_t(Call::freeCommandBuffer));
+        writeVarint(commandBufferIds.remove(rawHandle<TgaCommandBuffer>(commandBuffer)));
+    }
+    void CaptureInterface::free(Readback readback)
+    {
+        target.free(readback);
+        writeCall(uint8_t(Call::freeReadback));
+        writeVarint(readbackIds.remove(rawHandle<TgaReadback>(readback)));
+    }
+
+    ReplayStats replayCapture(Interface &tgai, const std::string &captureFile)
+    {
+        CaptureReader reader(captureFile);
+        HandleTable<Shader> shaders;
+        HandleTable<Buffer> buffers;
+        HandleTable<Texture> textures;
+        HandleTable<Window> windows;
+        HandleTable<InputSet> inputSets;
+        HandleTable<RenderPass> renderPasses;
+        HandleTable<CommandBuffer> commandBuffers;
+        HandleTable<Readback> readbacks;
+
+        ReplayStats stats{};
+        auto start = std::chrono::steady_clock::now();
+        Call call;
+        while(reader.nextCall(call)){
+            switch (call)
+            {
+            case Call::createShader:{
+                auto type = reader.enumeration<ShaderType>();
+                auto &src = reader.bytes();
+                auto shader = tgai.createShader({type,src.data(),src.size()});
+                shaders.handles[reader.varint()] = shader;
+                break;
+            }
+            case Call::createBuffer:{
+                auto usage = reader.enumeration<BufferUsage>();
+                auto dataSize = size_t(reader.varint());
+                auto &data = reader.bytes();
+                auto buffer = tgai.createBuffer({usage,data.empty()?nullptr:data.data(),dataSize});
+                buffers.handles[reader.varint()] = buffer;
+                break;
+            }
+            case Call::createTexture:{
+                auto width = reader.u32();
+                auto height = reader.u32();
+                auto dataSize = size_t(reader.varint());
+                auto &data = reader.bytes();
+                auto dataPtr = data.empty()?nullptr:data.data();
+                auto format = reader.enumeration<Format>();
+                auto samplerMode = reader.enumeration<SamplerMode>();
+                auto repeatMode = reader.enumeration<RepeatMode>();
+                auto texture = tgai.createTexture({width,height,dataPtr,dataSize,format,samplerMode,repeatMode});
+                textures.handles[reader.varint()] = texture;
+                break;
+            }
+            case Call::createWindow:{
+                auto width = reader.u32();
+                auto height = reader.u32();
+                auto presentMode = reader.enumeration<PresentMode>();
+                auto framebufferCount = reader.u32();
+                auto maxQueuedFrames = reader.u32();
+                auto frameRateLimit = reader.u32();
+                //Passes and frames of the capture depend on the window, so a target without windows cannot replay it
+                Window window;
+                try{
+                    window = tgai.createWindow({width,height,presentMode,framebufferCount,maxQueuedFrames,frameRateLimit});
+                }
+                catch(const std::exception &e){
+                    throw std::runtime_error(std::string("Capture creates a window the replay target cannot provide: ") + e.what());
+                }
+                windows.handles[reader.varint()] = window;
+                break;
+            }
+            case Call::createInputSet:{
+                auto renderPass = renderPasses.get(reader.varint());
+                auto setIndex = reader.u32();
+                std::vector<Binding> bindings(size_t(reader.varint()));
+                for(auto &binding : bindings){
+                    if(reader.varint() == 0)
+                        binding.resource = buffers.get(reader.varint());
+                    else
+                        binding.resource = textures.get(reader.varint());
+                    binding.slot = reader.u32();
+                    binding.arrayElement = reader.u32();
+                }
+                auto subpass = reader.u32();
+                auto inputSet = tgai.createInputSet({renderPass,setIndex,bindings,subpass});
+                inputSets.handles[reader.varint()] = inputSet;
+                break;
+            }
+            case Call::createRenderPass:{
+                RenderPassInfo renderPassInfo{};
+                renderPassInfo.shaderStages.resize(size_t(reader.varint()));
+                for(auto &shader : renderPassInfo.shaderStages)
+                    shader = shaders.get(reader.varint());
+                if(reader.varint() == 0)
+                    renderPassInfo.renderTarget = textures.get(reader.varint());
+                else
+                    renderPassInfo.renderTarget = windows.get(reader.varint());
+                renderPassInfo.clearOperations = reader.enumeration<ClearOperation>();
+                renderPassInfo.vertexLayout = readVertexLayout(reader);
+                renderPassInfo.rasterizerConfig = readRasterizerConfig(reader);
+                renderPassInfo.inputLayout = readInputLayout(reader);
+                renderPassInfo.depthConfig.format = reader.enumeration<DepthFormat>();
+                renderPassInfo.depthConfig.loadOperation = reader.enumeration<LoadOperation>();
+                renderPassInfo.depthConfig.storeOperation = reader.enumeration<StoreOperation>();
+                renderPassInfo.intermediateAttachments.resize(size_t(reader.varint()));
+                for(auto &format : renderPassInfo.intermediateAttachments)
+                    format = reader.enumeration<Format>();
+                renderPassInfo.subpasses.resize(size_t(reader.varint()));
+                for(auto &subpass : renderPassInfo.subpasses){
+                    subpass.shaderStages.resize(size_t(reader.varint()));
+                    for(auto &shader : subpass.shaderStages)
+                        shader = shaders.get(reader.varint());
+                    subpass.colorAttachments.resize(size_t(reader.varint()));
+                    for(auto &attachment : subpass.colorAttachments)
+                        attachment = reader.u32();
+                    subpass.inputAttachments.resize(size_t(reader.varint()));
+                    for(auto &attachment : subpass.inputAttachments)
+                        attachment = reader.u32();
+                    subpass.vertexLayout = readVertexLayout(reader);
+                    subpass.rasterizerConfig = readRasterizerConfig(reader);
+                    subpass.inputLayout = readInputLayout(reader);
+                }
+                renderPassInfo.additionalTargets.resize(size_t(reader.varint()));
+                for(auto &colorTarget : renderPassInfo.additionalTargets){
+                    colorTarget.texture = textures.get(reader.varint());
+                    colorTarget.loadOperation = reader.enumeration<LoadOperation>();
+                    colorTarget.storeOperation = reader.enumeration<StoreOperation>();
+                    colorTarget.blendEnabled = reader.varint() != 0;
+                    colorTarget.srcBlend = reader.enumeration<BlendFactor>();
+                    colorTarget.dstBlend = reader.enumeration<BlendFactor>();
+                }
+                renderPassInfo.sampleCount = reader.enumeration<SampleCount>();
+                auto renderPass = tgai.createRenderPass(renderPassInfo);
+                renderPasses.handles[reader.varint()] = renderPass;
+                break;
+            }
+            case Call::beginCommandBuffer:{
+                CommandBufferInfo commandBufferInfo{};
+                commandBufferInfo.asyncCompute = reader.varint() != 0;
+                commandBufferInfo.waitsForCompute = reader.varint() != 0;
+                tgai.beginCommandBuffer(commandBufferInfo);
+                break;
+            }
+            case Call::nextSubpass:
+                tgai.nextSubpass();
+                break;
+            case Call::setRenderPass:{
+                auto renderPass = renderPasses.get(reader.varint());
+                tgai.setRenderPass(renderPass,reader.u32());
+                break;
+            }
+            case Call::bindVertexBuffer:
+                tgai.bindVertexBuffer(buffers.get(reader.varint()));
+                break;
+            case Call::bindIndexBuffer:{
+                auto buffer = buffers.get(reader.varint());
+                tgai.bindIndexBuffer(buffer,reader.enumeration<IndexType>());
+                break;
+            }
+            case Call::bindInputSet:
+                tgai.bindInputSet(inputSets.get(reader.varint()));
+                break;
+            case Call::draw:{
+                auto vertexCount = reader.u32();
+                tgai.draw(vertexCount,reader.u32());
+                break;
+            }
+            case Call::drawIndexed:{
+                auto indexCount = reader.u32();
+                auto firstIndex = reader.u32();
+                tgai.drawIndexed(indexCount,firstIndex,reader.u32());
+                break;
+            }
+            case Call::dispatch:{
+                auto groupCountX = reader.u32();
+                auto groupCountY = reader.u32();
+                tgai.dispatch(groupCountX,groupCountY,reader.u32());
+                break;
+            }
+            case Call::endCommandBuffer:{
+                auto commandBuffer = tgai.endCommandBuffer();
+                commandBuffers.handles[reader.varint()] = commandBuffer;
+                break;
+            }
+            case Call::execute:
+                tgai.execute(commandBuffers.get(reader.varint()));
+                break;
+            case Call::updateBuffer:{
+                auto buffer = buffers.get(reader.varint());
+                auto &data = reader.bytes();
+                tgai.updateBuffer(buffer,data.data(),data.size(),reader.u32());
+                break;
+            }
+            case Call::readBuffer:{
+                auto buffer = buffers.get(reader.varint());
+                auto dataSize = size_t(reader.varint());
+                auto readback = tgai.readBuffer(buffer,dataSize,reader.u32());
+                readbacks.handles[reader.varint()] = readback;
+                break;
+            }
+            case Call::readTexture:{
+                auto readback = tgai.readTexture(textures.get(reader.varint()));
+                readbacks.handles[reader.varint()] = readback;
+                break;
+            }
+            case Call::readbackReady:
+                reader.varint();
+                reader.varint();
+                break;
+            case Call::readbackData:
+                tgai.readbackData(readbacks.get(reader.varint()));
+                break;
+            case Call::textureProperties:
+                for(int i = 0; i < 4; i++)
+                    reader.varint();
+                break;
+            case Call::backbufferCount:
+                reader.varint();
+                reader.varint();
+                break;
+            case Call::nextFrame:{
+                auto window = windows.get(reader.varint());
+                if(tgai.nextFrame(window) != reader.u32())
+                    stats.frameDivergences++;
+                break;
+            }
+            case Call::present:
+                tgai.present(windows.get(reader.varint()));
+                stats.frames++;
+                break;
+            case Call::setWindowTitel:{
+                auto window = windows.get(reader.varint());
+                tgai.setWindowTitel(window,reader.string());
+                break;
+            }
+            case Call::windowShouldClose:
+                reader.varint();
+                reader.varint();
+                break;
+            case Call::keyDown:
+                reader.varint();
+                reader.varint();
+                reader.varint();
+                break;
+            case Call::mousePosition:
+                reader.varint();
+                reader.varint();
+                reader.varint();
+                break;
+            case Call::pollInput:
+                break;
+            case Call::takeInputEvents:{
+                reader.varint();
+                auto eventCount = reader.varint();
+                for(uint64_t i = 0; i < 5*eventCount; i++)
+                    reader.varint();
+                break;
+            }
+            case Call::inputSnapshot:{
+                reader.varint();
+                reader.varint();
+                reader.varint();
+                auto keyCount = reader.varint();
+                for(uint64_t i = 0; i < keyCount; i++)
+                    reader.varint();
+                break;
+            }
+            case Call::freeShader:
+                tgai.free(shaders.remove(reader.varint()));
+                break;
+            case Call::freeBuffer:
+                tgai.free(buffers.remove(reader.varint()));
+                break;
+            case Call::freeTexture:
+                tgai.free(textures.remove(reader.varint()));
+                break;
+            case Call::freeWindow:
+                tgai.free(windows.remove(reader.varint()));
+                break;
+            case Call::freeInputSet:
+                tgai.free(inputSets.remove(reader.varint()));
+                break;
+            case Call::freeRenderPass:
+                tgai.free(renderPasses.remove(reader.varint()));
+                break;
+            case Call::freeCommandBuffer:
+                tgai.free(commandBuffers.remove(reader.varint()));
+                break;
+            case Call::freeReadback:
+                tgai.free(readbacks.remove(reader.varint()));
+                break;
+            default:
+                throw std::runtime_error("Capture file contains an unknown call");
+            }
+            stats.calls++;
+        }
+        stats.payloadBytes = reader.payloadBytes;
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+        return stats;
+    }
+}
@@ -0,0 +1,272 @@
+#include "tga/tga_export.hpp"
+#include <cstdio>
+
+namespace tga
+{
+    namespace
+    {
+        std::array<uint32_t,256> makeCrcTable()
+        {
+            std::array<uint32_t,256> table{};
+            for(uint32_t i = 0; i < 256; i++){
+                uint32_t c = i;
+                for(int k = 0; k < 8; k++)
+                    c = (c & 1)?0xedb88320u^(c>>1):c>>1;
+                table[i] = c;
+            }
+            return table;
+        }
+
+        uint32_t crc32(uint32_t crc, uint8_t const *data, size_t size)
+        {
+            static const std::array<uint32_t,256> table = makeCrcTable();
+            for(size_t i = 0; i < size; i++)
+                crc = table[(crc^data[i])&0xff]^(crc>>8);
+            return crc;
+        }
+
+        void appendU32(std::vector<uint8_t> &out, uint32_t value)
+        {
+            out.insert(out.end(),{uint8_t(value>>24),uint8_t(value>>16),uint8_t(value>>8),uint8_t(value)});
+        }
+
+        void appendChunk(std::vector<uint8_t> &png, char const *type, std::vector<uint8_t> const &data)
+        {
+            appendU32(png,uint32_t(data.size()));
+            size_t typeStart = png.size();
+            png.insert(png.end(),type,type+4);
+            png.insert(png.end(),data.begin(),data.end());
+            uint32_t crc = crc32(0xffffffffu,png.data()+typeStart,png.size()-typeStart)^0xffffffffu;
+            appendU32(png,crc);
+        }
+
+        //8 bit formats map to the png color types, 0 if png cannot hold the format
+        uint32_t pngChannels(Format format)
+        {
+            switch(format){
+                case Format::r8_uint:
+                case Format::r8_sint:
+                case Format::r8_srgb:
+                case Format::r8_unorm:
+                case Format::r8_snorm: return 1;
+                case Format::r8g8_uint:
+                case Format::r8g8_sint:
+                case Format::r8g8_srgb:
+                case Format::r8g8_unorm:
+                case Format::r8g8_snorm: return 2;
+                case Format::r8g8b8_uint:
+                case Format::r8g8b8_sint:
+                case Format::r8g8b8_srgb:
+                case Format::r8g8b8_unorm:
+                case Format::r8g8b8_snorm: return 3;
+                case Format::r8g8b8a8_uint:
+                case Format::r8g8b8a8_sint:
+                case Format::r8g8b8a8_srgb:
+                case Format::r8g8b8a8_unorm:
+                case Format::r8g8b8a8_snorm: return 4;
+                default: return 0;
+            }
+        }
+
+        double milliSince(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+        }
+    }
+
+    std::vector<uint8_t> encodePNG(uint8_t const *pixels, uint32_t width, uint32_t height, uint32_t channels)
+    {
+        uint8_t colorType = 0;
+        switch (channels)
+        {
+            case 1: colorType = 0; break;
+            case 2: colorType = 4; break;
+            case 3: colorType = 2; break;
+            case 4: colorType = 6; break;
+            default: throw std::runtime_error("[TGA Export] PNG export supports 1 to 4 channels with 8 bit each");
+        }
+        std::vector<uint8_t> png{0x89,'P','N','G','\r','\n',0x1a,'\n'};
+        std::vector<uint8_t> header{};
+        appendU32(header,width);
+        appendU32(header,height);
+        header.insert(header.end(),{8,colorType,0,0,0});
+        appendChunk(png,"IHDR",header);
+
+        size_t rowSize = size_t(width)*channels;
+        std::vector<uint8_t> scanlines{};
+        scanlines.reserve((rowSize+1)*height);
+        for(uint32_t y = 0; y < height; y++){
+            scanlines.push_back(0);
+            scanlines.insert(scanlines.end(),pixels+y*rowSize,pixels+(y+1)*rowSize);
+        }
+
+        //Stored deflate blocks, the exporter is bound by throughput and not by file size
+        std::vector<uint8_t> zlib{0x78,0x01};
+        zlib.reserve(scanlines.size()+scanlines.size()/65535*5+16);
+        size_t offset = 0;
+        do{
+            uint16_t blockSize = uint16_t(std::min<size_t>(65535,scanlines.size()-offset));
+            bool last = offset+blockSize == scanlines.size();
+            zlib.insert(zlib.end(),{uint8_t(last?1:0),uint8_t(blockSize),uint8_t(blockSize>>8),
+                uint8_t(~blockSize),uint8_t(uint16_t(~blockSize)>>8)});
+            zlib.insert(zlib.end(),scanlines.begin()+offset,scanlines.begin()+offset+blockSize);
+            offset += blockSize;
+        }while(offset < scanlines.size());
+
+        uint32_t a = 1, b = 0;
+        for(size_t i = 0; i < scanlines.size();){
+            size_t end = std::min(scanlines.size(),i+5552);
+            for(; i < end; i++){
+                a += scanlines[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        appendU32(zlib,(b<<16)|a);
+        appendChunk(png,"IDAT",zlib);
+        appendChunk(png,"IEND",{});
+        return png;
+    }
+
+    void FrameExporter::StageAccumulator::add(double milli)
+    {
+        sumMilli += milli;
+        maxMilli = std::max(maxMilli,milli);
+        count++;
+    }
+
+    StageLatency FrameExporter::StageAccumulator::latency() const
+    {
+        return {count?sumMilli/double(count):0.,maxMilli};
+    }
+
+    FrameExporter::FrameExporter(Interface &_tgai, const ExportInfo &_exportInfo):
+        tgai(_tgai),exportInfo(_exportInfo),nextFrame(0),stopping(false),framesWritten(0),framesFailed(0)
+    {
+        exportInfo.queueDepth = std::max(exportInfo.queueDepth,1u);
+        exportInfo.workerCount = std::max(exportInfo.workerCount,1u);
+        for(uint32_t i = 0; i < exportInfo.workerCount; i++)
+            workers.emplace_back(&FrameExporter::workerLoop,this);
+    }
+
+    FrameExporter::~FrameExporter()
+    {
+        finish();
+    }
+
+    void FrameExporter::exportFrame(Texture texture)
+    {
+        if(stopping)
+            throw std::runtime_error("[TGA Export] FrameExporter has already finished");
+        auto properties = tgai.textureProperties(texture);
+        if(properties.width == 0 || properties.height == 0)
+            throw std::runtime_error("[TGA Export] Texture extent must not be empty");
+        uint32_t channels = 0;
+        if(exportInfo.format == ExportFormat::png){
+            channels = pngChannels(properties.format);
+            if(channels == 0)
+                throw std::runtime_error("[TGA Export] PNG export supports 1 to 4 channels with 8 bit each");
+        }
+        if(nextFrame == 0)
+            firstFrameTime = Clock::now();
+        pending.push_back({tgai.readTexture(texture),nextFrame++,properties.width,properties.height,channels,Clock::now()});
+        while(!pending.empty() && (pending.size() > exportInfo.queueDepth || tgai.readbackReady(pending.front().readback)))
+            collectReadback();
+    }
+
+    void FrameExporter::finish()
+    {
+        while(!pending.empty())
+            collectReadback();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for(auto &worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    ExportStats FrameExporter::stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        double seconds = std::chrono::duration<double>(lastWriteTime-firstFrameTime).count();
+        return {framesWritten,framesFailed,lastError,seconds>0?double(framesWritten)/seconds:0.,
+            readbackLatency.latency(),encodeLatency.latency(),writeLatency.latency()};
+    }
+
+    void FrameExporter::collectReadback()
+    {
+        auto front = pending.front();
+        pending.pop_front();
+        auto [data, size] = tgai.readbackData(front.readback);
+        EncodeJob job{std::vector<uint8_t>(data,data+size),front.frame,front.width,front.height,front.channels};
+        tgai.free(front.readback);
+        double latency = milliSince(front.submitTime);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        readbackLatency.add(latency);
+        jobTaken.wait(lock,[&]{return jobs.size() < exportInfo.queueDepth;});
+        jobs.push_back(std::move(job));
+        jobAvailable.notify_one();
+    }
+
+    void FrameExporter::workerLoop()
+    {
+        while(true){
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock,[&]{return stopping || !jobs.empty();});
+            if(jobs.empty())
+                return;
+            EncodeJob job = std::move(jobs.front());
+            jobs.pop_front();
+            jobTaken.notify_one();
+            lock.unlock();
+            //Exceptions must not leave the thread, the frame is counted as failed instead
+            try{
+                encodeAndWrite(job);
+            }
+            catch(const std::exception &e){
+                std::lock_guard<std::mutex> failLock(mutex);
+                framesFailed++;
+                lastError = e.what();
+            }
+        }
+    }
+
+    void FrameExporter::encodeAndWrite(EncodeJob &job)
+    {
+        auto encodeStart = Clock::now();
+        std::vector<uint8_t> encoded{};
+        uint8_t const *fileData = job.pixels.data();
+        size_t fileSize = job.pixels.size();
+        if(exportInfo.format == ExportFormat::png){
+            if(job.pixels.size() != size_t(job.width)*job.height*job.channels)
+                throw std::runtime_error("[TGA Export] Readback of frame " + std::to_string(job.frame) + " does not match the texture extent");
+            encoded = encodePNG(job.pixels.data(),job.width,job.height,job.channels);
+            fileData = encoded.data();
+            fileSize = encoded.size();
+        }
+        double encodeTime = milliSince(encodeStart);
+
+        auto writeStart = Clock::now();
+        std::vector<char> fileName(exportInfo.filePattern.size()+32);
+        std::snprintf(fileName.data(),fileName.size(),exportInfo.filePattern.c_str(),unsigned(job.frame));
+        std::ofstream file(fileName.data(),std::ios::binary);
+        if(!file.is_open())
+            throw std::runtime_error(std::string("[TGA Export] Could not open ") + fileName.data());
+        file.write(reinterpret_cast<char const*>(fileData),std::streamsize(fileSize));
+        file.close();
+        if(!file)
+            throw std::runtime_error(std::string("[TGA Export] Could not write ") + fileName.data());
+        double writeTime = milliSince(writeStart);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        encodeLatency.add(encodeTime);
+        writeLatency.add(writeTime);
+        framesWritten++;
+        lastWriteTime = Clock::now();
+    }
+}
@@ -0,0 +1,345 @@
+#include "tga/tga_meshopt.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <string_view>
+#include <thread>
+
+namespace tga
+{
+    namespace
+    {
+        struct Vec3{
+            float x, y, z;
+            Vec3 operator+(const Vec3 &other) const {return {x+other.x,y+other.y,z+other.z};}
+            Vec3 operator-(const Vec3 &other) const {return {x-other.x,y-other.y,z-other.z};}
+            Vec3 operator*(float s) const {return {x*s,y*s,z*s};}
+        };
+        float dot(const Vec3 &a, const Vec3 &b)
+        {
+            return a.x*b.x+a.y*b.y+a.z*b.z;
+        }
+        Vec3 cross(const Vec3 &a, const Vec3 &b)
+        {
+            return {a.y*b.z-a.z*b.y,a.z*b.x-a.x*b.z,a.x*b.y-a.y*b.x};
+        }
+
+        //64 bit, so the count of an index of 0xFFFFFFFF does not wrap to 0
+        uint64_t vertexCountOf(const std::vector<uint32_t> &indices)
+        {
+            uint64_t vertexCount = 0;
+            for(auto index : indices)
+                vertexCount = std::max(vertexCount,uint64_t(index)+1);
+            return vertexCount;
+        }
+
+        //Misses of every triangle in a FIFO cache, a vertex is cached while fewer than cacheSize vertices were inserted after it
+        std::vector<uint8_t> triangleMisses(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize)
+        {
+            std::vector<uint64_t> insertedAt(vertexCount,0);
+            uint64_t time = uint64_t(cacheSize)+1;
+            std::vector<uint8_t> misses(indices.size()/3,0);
+            for(size_t i = 0; i < indices.size(); i++){
+                auto vertex = indices[i];
+                if(time-insertedAt[vertex] > cacheSize){
+                    insertedAt[vertex] = time++;
+                    misses[i/3]++;
+                }
+            }
+            return misses;
+        }
+
+        double acmr(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize)
+        {
+            if(indices.size() < 3)
+                return 0;
+            uint64_t total = 0;
+            for(auto miss : triangleMisses(indices,vertexCount,cacheSize))
+                total += miss;
+            return double(total)/double(indices.size()/3);
+        }
+
+        //Points every index to the first vertex with the same bytes
+        void deduplicateVertices(MeshData &mesh, uint32_t vertexCount)
+        {
+            std::vector<uint32_t> remap(vertexCount);
+            std::unordered_map<std::string_view, uint32_t> unique{};
+            unique.reserve(vertexCount);
+            for(uint32_t v = 0; v < vertexCount; v++){
+                std::string_view bytes(reinterpret_cast<char const*>(mesh.vertices.data())+size_t(v)*mesh.vertexStride,mesh.vertexStride);
+                remap[v] = unique.emplace(bytes,v).first->second;
+            }
+            for(auto &index : mesh.indices)
+                index = remap[index];
+        }
+
+        //Forsyth's linear-speed vertex cache optimization on an LRU cache of cacheSize entries
+        float vertexScore(int32_t cachePosition, uint32_t remainingTriangles, uint32_t cacheSize)
+        {
+            if(remainingTriangles == 0)
+                return -1;
+            float score = 0;
+            if(cachePosition >= 0){
+                //The vertices of the last triangle are scored equally, so the direction of the strip does not matter
+                if(cachePosition < 3)
+                    score = 0.75f;
+                else
+                    score = std::pow(1.f-float(cachePosition-3)/float(cacheSize-3),1.5f);
+            }
+            //Vertices with few triangles left are finished first to avoid leaving lone triangles behind
+            return score+2.f/std::sqrt(float(remainingTriangles));
+        }
+
+        std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, uint32_t vertexCount, uint32_t cacheSize)
+        {
+            uint32_t triangleCount = uint32_t(indices.size()/3);
+            std::vector<uint32_t> remaining(vertexCount,0);
+            for(auto index : indices)
+                remaining[index]++;
+            std::vector<uint32_t> adjacencyOffset(size_t(vertexCount)+1,0);
+            for(uint32_t v = 0; v < vertexCount; v++)
+                adjacencyOffset[v+1] = adjacencyOffset[v]+remaining[v];
+            std::vector<uint32_t> adjacency(indices.size());
+            {
+                std::vector<uint32_t> fill(adjacencyOffset.begin(),adjacencyOffset.end()-1);
+                for(uint32_t t = 0; t < triangleCount; t++)
+                    for(uint32_t k = 0; k < 3; k++)
+                        adjacency[fill[indices[t*3+k]]++] = t;
+            }
+
+            std::vector<int32_t> cachePosition(vertexCount,-1);
+            std::vector<float> vertexScores(vertexCount);
+            for(uint32_t v = 0; v < vertexCount; v++)
+                vertexScores[v] = vertexScore(-1,remaining[v],cacheSize);
+            std::vector<float> triangleScores(triangleCount);
+            std::vector<bool> emitted(triangleCount,false);
+            uint32_t best = ~0u;
+            for(uint32_t t = 0; t < triangleCount; t++){
+                triangleScores[t] = vertexScores[indices[t*3]]+vertexScores[indices[t*3+1]]+vertexScores[indices[t*3+2]];
+                if(best == ~0u || triangleScores[t] > triangleScores[best])
+                    best = t;
+            }
+
+            std::vector<uint32_t> result{};
+            result.reserve(indices.size());
+            std::vector<uint32_t> cache{}, nextCache{};
+            uint32_t scanPosition = 0;
+            for(uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++){
+                //Dead end, nothing in the cache has triangles left, continue with the next triangle in input order
+                if(best == ~0u){
+                    while(emitted[scanPosition])
+                        scanPosition++;
+                    best = scanPosition;
+                }
+                emitted[best] = true;
+                nextCache.clear();
+                for(uint32_t k = 0; k < 3; k++){
+                    auto vertex = indices[best*3+k];
+                    result.push_back(vertex);
+                    nextCache.push_back(vertex);
+                    auto begin = adjacency.begin()+adjacencyOffset[vertex];
+                    auto end = begin+remaining[vertex];
+                    std::iter_swap(std::find(begin,end,best),end-1);
+                    remaining[vertex]--;
+                }
+                for(auto vertex : cache)
+                    if(vertex != nextCache[0] && vertex != nextCache[1] && vertex != nextCache[2])
+                        nextCache.push_back(vertex);
+                std::swap(cache,nextCache);
+
+                for(uint32_t i = 0; i < cache.size(); i++){
+                    auto vertex = cache[i];
+                    cachePosition[vertex] = i < cacheSize?int32_t(i):-1;
+                    vertexScores[vertex] = vertexScore(cachePosition[vertex],remaining[vertex],cacheSize);
+                }
+                best = ~0u;
+                for(auto vertex : cache){
+                    for(uint32_t a = adjacencyOffset[vertex]; a < adjacencyOffset[vertex]+remaining[vertex]; a++){
+                        auto t = adjacency[a];
+                        triangleScores[t] = vertexScores[indices[t*3]]+vertexScores[indices[t*3+1]]+vertexScores[indices[t*3+2]];
+                        if(best == ~0u || triangleScores[t] > triangleScores[best])
+                            best = t;
+                    }
+                }
+                if(cache.size() > cacheSize)
+                    cache.resize(cacheSize);
+            }
+            return result;
+        }
+
+        //Sorts clusters of the cache order outside in, so front facing surfaces tend to be drawn before what they occlude.
+        //Every cluster is simulated on a cold cache and ends as soon as its ACMR is within overdrawThreshold of the whole mesh,
+        //so the clusters can be drawn in any order without losing much cache efficiency
+        std::vector<uint32_t> optimizeOverdraw(const MeshData &mesh, uint32_t vertexCount, const MeshOptimizeInfo &optimizeInfo, uint32_t &clusterCount)
+        {
+            auto &indices = mesh.indices;
+            uint32_t triangleCount = uint32_t(indices.size()/3);
+            uint32_t cacheSize = optimizeInfo.cacheSize;
+            double targetACMR = optimizeInfo.overdrawThreshold*acmr(indices,vertexCount,cacheSize);
+            std::vector<uint32_t> clusterStarts{0};
+            std::vector<uint64_t> insertedAt(vertexCount,0);
+            uint64_t time = uint64_t(cacheSize)+1;
+            uint32_t clusterMisses = 0;
+            for(uint32_t t = 0; t < triangleCount; t++){
+                for(uint32_t k = 0; k < 3; k++){
+                    auto vertex = indices[t*3+k];
+                    if(time-insertedAt[vertex] > cacheSize){
+                        insertedAt[vertex] = time++;
+                        clusterMisses++;
+                    }
+                }
+                if(t+1 < triangleCount && clusterMisses <= targetACMR*(t+1-clusterStarts.back())){
+                    clusterStarts.push_back(t+1);
+                    clusterMisses = 0;
+                    time += uint64_t(cacheSize)+1;
+                }
+            }
+            clusterCount = uint32_t(clusterStarts.size());
+            clusterStarts.push_back(triangleCount);
+            if(clusterCount < 2)
+                return indices;
+
+            auto position = [&](uint32_t vertex){
+                Vec3 p;
+                std::memcpy(&p,mesh.vertices.data()+size_t(vertex)*mesh.vertexStride+optimizeInfo.positionOffset,sizeof(Vec3));
+                return p;
+            };
+            std::vector<Vec3> centroids(clusterCount), normals(clusterCount);
+            Vec3 meshCentroid{0,0,0};
+            float meshArea = 0;
+            for(uint32_t c = 0; c < clusterCount; c++){
+                Vec3 centroid{0,0,0}, normal{0,0,0};
+                float clusterArea = 0;
+                for(uint32_t t = clusterStarts[c]; t < clusterStarts[c+1]; t++){
+                    auto p0 = position(indices[t*3]), p1 = position(indices[t*3+1]), p2 = position(indices[t*3+2]);
+                    auto areaNormal = cross(p1-p0,p2-p0);
+                    float area = std::sqrt(dot(areaNormal,areaNormal));
+                    centroid = centroid+(p0+p1+p2)*(area/3.f);
+                    normal = normal+areaNormal;
+                    clusterArea += area;
+                }
+                meshCentroid = meshCentroid+centroid;
+                meshArea += clusterArea;
+                centroids[c] = clusterArea > 0?centroid*(1.f/clusterArea):centroid;
+                float normalLength = std::sqrt(dot(normal,normal));
+                normals[c] = normalLength > 0?normal*(1.f/normalLength):normal;
+            }
+            if(meshArea > 0)
+                meshCentroid = meshCentroid*(1.f/meshArea);
+
+            std::vector<float> sortKeys(clusterCount);
+            std::vector<uint32_t> order(clusterCount);
+            for(uint32_t c = 0; c < clusterCount; c++){
+                sortKeys[c] = dot(centroids[c]-meshCentroid,normals[c]);
+                order[c] = c;
+            }
+            std::stable_sort(order.begin(),order.end(),[&](uint32_t a, uint32_t b){return sortKeys[a] > sortKeys[b];});
+
+            std::vector<uint32_t> result{};
+            result.reserve(indices.size());
+            for(auto c : order)
+                result.insert(result.end(),indices.begin()+size_t(clusterStarts[c])*3,indices.begin()+size_t(clusterStarts[c+1])*3);
+            if(acmr(result,vertexCount,cacheSize) > targetACMR)
+                return indices;
+            return result;
+        }
+
+        //Stores the vertices in the order the indices first reference them and drops unreferenced ones
+        void optimizeVertexFetch(MeshData &mesh, uint32_t vertexCount)
+        {
+            std::vector<uint32_t> remap(vertexCount,~0u);
+            std::vector<uint8_t> vertices{};
+            vertices.reserve(mesh.vertices.size());
+            uint32_t nextVertex = 0;
+            for(auto &index : mesh.indices){
+                if(remap[index] == ~0u){
+                    remap[index] = nextVertex++;
+                    auto source = mesh.vertices.begin()+size_t(index)*mesh.vertexStride;
+                    vertices.insert(vertices.end(),source,source+mesh.vertexStride);
+                }
+                index = remap[index];
+            }
+            mesh.vertices = std::move(vertices);
+        }
+    }
+
+    MeshOptimizeStats optimizeMesh(MeshData &mesh, const MeshOptimizeInfo &optimizeInfo)
+    {
+        if(mesh.vertexStride == 0 || mesh.vertices.size()%mesh.vertexStride != 0)
+            throw std::runtime_error("[TGA MeshOpt] Vertex data is not a multiple of the vertex stride");
+        if(mesh.indices.size()%3 != 0)
+            throw std::runtime_error("[TGA MeshOpt] Indices are not a triangle list");
+        uint32_t vertexCount = uint32_t(mesh.vertices.size()/mesh.vertexStride);
+        if(std::any_of(mesh.indices.begin(),mesh.indices.end(),[&](uint32_t index){return index >= vertexCount;}))
+            throw std::runtime_error("[TGA MeshOpt] Index refers to a vertex past the end of the vertex data");
+        MeshOptimizeInfo info = optimizeInfo;
+        info.cacheSize = std::max(info.cacheSize,4u);
+
+        MeshOptimizeStats stats{};
+        stats.inputVertices = vertexCount;
+        stats.triangles = uint32_t(mesh.indices.size()/3);
+        stats.acmrBefore = acmr(mesh.indices,vertexCount,info.cacheSize);
+
+        deduplicateVertices(mesh,vertexCount);
+        mesh.indices = optimizeVertexCache(mesh.indices,vertexCount,info.cacheSize);
+        if(info.positionOffset+3*sizeof(float) <= mesh.vertexStride)
+            mesh.indices = optimizeOverdraw(mesh,vertexCount,info,stats.clusters);
+        optimizeVertexFetch(mesh,vertexCount);
+
+        stats.outputVertices = uint32_t(mesh.vertices.size()/mesh.vertexStride);
+        stats.acmrAfter = acmr(mesh.indices,stats.outputVertices,info.cacheSize);
+        return stats;
+    }
+
+    std::vector<MeshOptimizeStats> optimizeMeshes(std::vector<MeshData> &meshes, const MeshOptimizeInfo &optimizeInfo)
+    {
+        std::vector<MeshOptimizeStats> stats(meshes.size());
+        uint32_t workerCount = optimizeInfo.workerCount?optimizeInfo.workerCount:std::max(std::thread::hardware_concurrency(),1u);
+        workerCount = std::min(workerCount,uint32_t(meshes.size()));
+        std::atomic<size_t> nextMesh{0};
+        std::vector<std::exception_ptr> errors(meshes.size());
+        auto work = [&](){
+            for(size_t m = nextMesh++; m < meshes.size(); m = nextMesh++){
+                try{
+                    stats[m] = optimizeMesh(meshes[m],optimizeInfo);
+                }
+                catch(...){
+                    errors[m] = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> workers{};
+        for(uint32_t i = 1; i < workerCount; i++)
+            workers.emplace_back(work);
+        work();
+        for(auto &worker : workers)
+            worker.join();
+        for(auto &error : errors)
+            if(error)
+                std::rethrow_exception(error);
+        return stats;
+    }
+
+    double vertexCacheACMR(const std::vector<uint32_t> &indices, uint32_t cacheSize)
+    {
+        auto vertexCount = vertexCountOf(indices);
+        if(vertexCount > std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error("[TGA MeshOpt] Index 0xFFFFFFFF exceeds the addressable vertex count");
+        return acmr(indices,uint32_t(vertexCount),cacheSize);
+    }
+
+    std::vector<uint8_t> packIndices(const std::vector<uint32_t> &indices, uint32_t vertexCount, IndexType &indexType)
+    {
+        indexType = vertexCount <= 0x10000?IndexType::uint16:IndexType::uint32;
+        if(indexType == IndexType::uint32)
+            return std::vector<uint8_t>(reinterpret_cast<uint8_t const*>(indices.data()),reinterpret_cast<uint8_t const*>(indices.data()+indices.size()));
+        std::vector<uint8_t> data(indices.size()*sizeof(uint16_t));
+        for(size_t i = 0; i < indices.size(); i++){
+            auto index = uint16_t(indices[i]);
+            std::memcpy(data.data()+i*sizeof(uint16_t),&index,sizeof(uint16_t));
+        }
+        return data;
+    }
+}
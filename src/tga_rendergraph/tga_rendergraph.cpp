@@ -0,0 +1,511 @@
+#include "tga/tga_rendergraph.hpp"
+
+namespace tga
+{
+    namespace
+    {
+        uint64_t texelSize(Format format)
+        {
+            switch(format){
+                case Format::r8_uint:
+                case Format::r8_sint:
+                case Format::r8_srgb:
+                case Format::r8_unorm:
+                case Format::r8_snorm: return 1;
+                case Format::r8g8_uint:
+                case Format::r8g8_sint:
+                case Format::r8g8_srgb:
+                case Format::r8g8_unorm:
+                case Format::r8g8_snorm:
+                case Format::r16_uint:
+                case Format::r16_sint:
+                case Format::r16_unorm:
+                case Format::r16_snorm:
+                case Format::r16_sfloat: return 2;
+                case Format::r8g8b8_uint:
+                case Format::r8g8b8_sint:
+                case Format::r8g8b8_srgb:
+                case Format::r8g8b8_unorm:
+                case Format::r8g8b8_snorm: return 3;
+                case Format::r8g8b8a8_uint:
+                case Format::r8g8b8a8_sint:
+                case Format::r8g8b8a8_srgb:
+                case Format::r8g8b8a8_unorm:
+                case Format::r8g8b8a8_snorm:
+                case Format::r16g16_uint:
+                case Format::r16g16_sint:
+                case Format::r16g16_unorm:
+                case Format::r16g16_snorm:
+                case Format::r16g16_sfloat:
+                case Format::r32_uint:
+                case Format::r32_sint:
+                case Format::r32_sfloat:
+                case Format::a2b10g10r10_uint_pack32:
+                case Format::a2b10g10r10_unorm_pack32:
+                case Format::a2b10g10r10_snorm_pack32:
+                case Format::b10g11r11_ufloat_pack32: return 4;
+                case Format::r16g16b16_uint:
+                case Format::r16g16b16_sint:
+                case Format::r16g16b16_unorm:
+                case Format::r16g16b16_snorm:
+                case Format::r16g16b16_sfloat: return 6;
+                case Format::r16g16b16a16_uint:
+                case Format::r16g16b16a16_sint:
+                case Format::r16g16b16a16_unorm:
+                case Format::r16g16b16a16_snorm:
+                case Format::r16g16b16a16_sfloat:
+                case Format::r32g32_uint:
+                case Format::r32g32_sint:
+                case Format::r32g32_sfloat: return 8;
+                case Format::r32g32b32_uint:
+                case Format::r32g32b32_sint:
+                case Format::r32g32b32_sfloat: return 12;
+                case Format::r32g32b32a32_uint:
+                case Format::r32g32b32a32_sint:
+                case Format::r32g32b32a32_sfloat: return 16;
+                default: return 0;
+            }
+        }
+
+        bool compatible(const GraphTextureInfo &a, const GraphTextureInfo &b)
+        {
+            return a.width == b.width && a.height == b.height && a.format == b.format &&
+                a.samplerMode == b.samplerMode && a.repeatMode == b.repeatMode;
+        }
+
+        bool sameBindings(const std::vector<Binding> &a, const std::vector<Binding> &b)
+        {
+            if(a.size() != b.size())
+                return false;
+            for(size_t i = 0; i < a.size(); i++){
+                if(a[i].resource.index() != b[i].resource.index() || a[i].slot != b[i].slot || a[i].arrayElement != b[i].arrayElement)
+                    return false;
+                if(auto buffer = std::get_if<Buffer>(&a[i].resource)){
+                    if(TgaBuffer(*buffer) != TgaBuffer(std::get<Buffer>(b[i].resource)))
+                        return false;
+                }
+                else if(TgaTexture(std::get<Texture>(a[i].resource)) != TgaTexture(std::get<Texture>(b[i].resource)))
+                    return false;
+            }
+            return true;
+        }
+
+        bool sameTarget(const std::variant<Texture, Window> &a, const std::variant<Texture, Window> &b)
+        {
+            if(a.index() != b.index())
+                return false;
+            if(auto texture = std::get_if<Texture>(&a))
+                return TgaTexture(*texture) == TgaTexture(std::get<Texture>(b));
+            return TgaWindow(std::get<Window>(a)) == TgaWindow(std::get<Window>(b));
+        }
+
+        bool sameVertexLayout(const VertexLayout &a, const VertexLayout &b)
+        {
+            if(a.vertexSize != b.vertexSize || a.vertexAttributes.size() != b.vertexAttributes.size())
+                return false;
+            for(size_t i = 0; i < a.vertexAttributes.size(); i++)
+                if(a.vertexAttributes[i].offset != b.vertexAttributes[i].offset || a.vertexAttributes[i].format != b.vertexAttributes[i].format)
+                    return false;
+            return true;
+        }
+
+        bool sameRasterizerConfig(const RasterizerConfig &a, const RasterizerConfig &b)
+        {
+            return a.depthCompareOp == b.depthCompareOp && a.blendEnabled == b.blendEnabled && a.srcBlend == b.srcBlend &&
+                a.dstBlend == b.dstBlend && a.frontFace == b.frontFace && a.cullMode == b.cullMode && a.polygonMode == b.polygonMode;
+        }
+
+        bool sameInputLayout(const InputLayout &a, const InputLayout &b)
+        {
+            if(a.setLayouts.size() != b.setLayouts.size())
+                return false;
+            for(size_t set = 0; set < a.setLayouts.size(); set++){
+                auto &bindingsA = a.setLayouts[set].bindingLayouts;
+                auto &bindingsB = b.setLayouts[set].bindingLayouts;
+                if(bindingsA.size() != bindingsB.size())
+                    return false;
+                for(size_t i = 0; i < bindingsA.size(); i++)
+                    if(bindingsA[i].type != bindingsB[i].type || bindingsA[i].count != bindingsB[i].count)
+                        return false;
+            }
+            return true;
+        }
+
+        //Covers everything the graph puts into a RenderPassInfo
+        bool sameRenderPass(const RenderPassInfo &a, const RenderPassInfo &b)
+        {
+            if(a.shaderStages.size() != b.shaderStages.size())
+                return false;
+            for(size_t i = 0; i < a.shaderStages.size(); i++)
+                if(TgaShader(a.shaderStages[i]) != TgaShader(b.shaderStages[i]))
+                    return false;
+            auto &depthA = a.depthConfig;
+            auto &depthB = b.depthConfig;
+            return sameTarget(a.renderTarget,b.renderTarget) && a.clearOperations == b.clearOperations &&
+                sameVertexLayout(a.vertexLayout,b.vertexLayout) && sameRasterizerConfig(a.rasterizerConfig,b.rasterizerConfig) &&
+                sameInputLayout(a.inputLayout,b.inputLayout) && depthA.format == depthB.format &&
+                depthA.loadOperation == depthB.loadOperation && depthA.storeOperation == depthB.storeOperation;
+        }
+    }
+
+    RenderGraph::RenderGraph(Interface &_tgai):tgai(_tgai),lastStats{},compiled(false)
+    {}
+
+    RenderGraph::~RenderGraph()
+    {
+        for(auto &[name, cachedPass] : cachedPasses)
+            freeCachedPass(cachedPass);
+        for(auto &physical : physicalTextures)
+            tgai.free(physical.texture);
+    }
+
+    GraphTexture RenderGraph::createTransient(const GraphTextureInfo &textureInfo)
+    {
+        if(textureInfo.width == 0 || textureInfo.height == 0 || texelSize(textureInfo.format) == 0)
+            throw std::runtime_error("[TGA RenderGraph] Transient texture needs an extent and a color format");
+        resources.push_back({textureInfo,Texture(),Texture(),~0u,0});
+        compiled = false;
+        return GraphTexture(uint32_t(resources.size()-1));
+    }
+
+    GraphTexture RenderGraph::importTexture(Texture texture)
+    {
+        if(!texture)
+            throw std::runtime_error("[TGA RenderGraph] Imported texture is null");
+        resources.push_back({GraphTextureInfo(),texture,texture,~0u,0});
+        compiled = false;
+        return GraphTexture(uint32_t(resources.size()-1));
+    }
+
+    void RenderGraph::addPass(const GraphPassInfo &passInfo)
+    {
+        for(auto &pass : passes)
+            if(pass.name == passInfo.name)
+                throw std::runtime_error("[TGA RenderGraph] Pass " + passInfo.name + " was added twice");
+        auto checkResource = [&](GraphTexture texture){
+            if(!texture || texture.index >= resources.size())
+                throw std::runtime_error("[TGA RenderGraph] Pass " + passInfo.name + " uses an undeclared texture");
+        };
+        if(auto target = std::get_if<GraphTexture>(&passInfo.target))
+            checkResource(*target);
+        for(auto &binding : passInfo.bindings)
+            if(auto texture = std::get_if<GraphTexture>(&binding.resource))
+                checkResource(*texture);
+        passes.push_back(passInfo);
+        compiled = false;
+    }
+
+    void RenderGraph::reset()
+    {
+        resources.clear();
+        passes.clear();
+        executionOrder.clear();
+        compiled = false;
+    }
+
+    void RenderGraph::compile()
+    {
+        cullPasses();
+        orderPasses();
+        assignPhysicalTextures();
+
+        for(auto &[name, cachedPass] : cachedPasses)
+            cachedPass.used = false;
+        for(auto passIndex : executionOrder)
+            preparePass(passes[passIndex]);
+        for(auto it = cachedPasses.begin(); it != cachedPasses.end();){
+            if(!it->second.used){
+                freeCachedPass(it->second);
+                it = cachedPasses.erase(it);
+            }
+            else
+                ++it;
+        }
+        //Textures only go back to the backend once no cached pass refers to them anymore
+        for(auto it = physicalTextures.begin(); it != physicalTextures.end();){
+            if(!it->used){
+                tgai.free(it->texture);
+                it = physicalTextures.erase(it);
+            }
+            else
+                ++it;
+        }
+        compiled = true;
+    }
+
+    void RenderGraph::cullPasses()
+    {
+        //A pass is live if it writes a window or an imported texture, or a texture a live pass samples
+        std::vector<bool> live(passes.size(),false);
+        std::vector<bool> resourceNeeded(resources.size(),false);
+        for(size_t r = 0; r < resources.size(); r++)
+            resourceNeeded[r] = bool(resources[r].imported);
+        bool changed = true;
+        while(changed){
+            changed = false;
+            for(size_t p = passes.size(); p-- > 0;){
+                if(live[p])
+                    continue;
+                auto target = std::get_if<GraphTexture>(&passes[p].target);
+                if(target && !resourceNeeded[target->index])
+                    continue;
+                live[p] = true;
+                changed = true;
+                for(auto &binding : passes[p].bindings)
+                    if(auto texture = std::get_if<GraphTexture>(&binding.resource))
+                        resourceNeeded[texture->index] = true;
+            }
+        }
+        executionOrder.clear();
+        for(uint32_t p = 0; p < passes.size(); p++)
+            if(live[p])
+                executionOrder.push_back(p);
+        lastStats.declaredPasses = uint32_t(passes.size());
+        lastStats.culledPasses = uint32_t(passes.size()-executionOrder.size());
+    }
+
+    void RenderGraph::orderPasses()
+    {
+        //A read depends on the last writer declared before it, or the first one declared after it when there is none.
+        //Writers of the same texture keep their declaration order and wait for the readers in between, writers of a window keep theirs
+        size_t count = executionOrder.size();
+        std::vector<std::vector<uint32_t>> writers(resources.size());
+        for(uint32_t i = 0; i < count; i++)
+            if(auto target = std::get_if<GraphTexture>(&passes[executionOrder[i]].target))
+                writers[target->index].push_back(i);
+
+        std::vector<std::vector<uint32_t>> successors(count);
+        std::vector<uint32_t> dependencyCount(count,0);
+        auto addEdge = [&](uint32_t from, uint32_t to){
+            if(from == to)
+                return;
+            successors[from].push_back(to);
+            dependencyCount[to]++;
+        };
+        std::unordered_map<TgaWindow, uint32_t> lastWindowWriter{};
+        for(uint32_t i = 0; i < count; i++){
+            auto &pass = passes[executionOrder[i]];
+            if(auto target = std::get_if<GraphTexture>(&pass.target)){
+                auto &resourceWriters = writers[target->index];
+                auto self = std::find(resourceWriters.begin(),resourceWriters.end(),i);
+                if(self != resourceWriters.begin())
+                    addEdge(*(self-1),i);
+            }
+            else{
+                auto window = TgaWindow(std::get<Window>(pass.target));
+                auto previous = lastWindowWriter.find(window);
+                if(previous != lastWindowWriter.end())
+                    addEdge(previous->second,i);
+                lastWindowWriter[window] = i;
+            }
+            for(auto &binding : pass.bindings){
+                auto texture = std::get_if<GraphTexture>(&binding.resource);
+                if(!texture)
+                    continue;
+                auto &resourceWriters = writers[texture->index];
+                if(resourceWriters.empty()){
+                    if(!resources[texture->index].imported)
+                        throw std::runtime_error("[TGA RenderGraph] Pass " + pass.name + " samples a transient texture nobody writes");
+                    continue;
+                }
+                auto next = std::upper_bound(resourceWriters.begin(),resourceWriters.end(),i);
+                if(next != resourceWriters.begin()){
+                    addEdge(*(next-1),i);
+                    if(next != resourceWriters.end())
+                        addEdge(i,*next);
+                }
+                else{
+                    addEdge(*next,i);
+                    if(next+1 != resourceWriters.end())
+                        addEdge(i,*(next+1));
+                }
+            }
+        }
+
+        //Kahn's algorithm, ready passes are taken in declaration order
+        std::vector<uint32_t> sorted{};
+        std::vector<uint32_t> ready{};
+        for(uint32_t i = 0; i < count; i++)
+            if(dependencyCount[i] == 0)
+                ready.push_back(i);
+        while(!ready.empty()){
+            auto first = std::min_element(ready.begin(),ready.end());
+            uint32_t i = *first;
+            ready.erase(first);
+            sorted.push_back(executionOrder[i]);
+            for(auto successor : successors[i])
+                if(--dependencyCount[successor] == 0)
+                    ready.push_back(successor);
+        }
+        if(sorted.size() != count)
+            throw std::runtime_error("[TGA RenderGraph] Pass dependencies contain a cycle");
+        executionOrder = sorted;
+    }
+
+    void RenderGraph::assignPhysicalTextures()
+    {
+        for(auto &resource : resources){
+            resource.firstUse = ~0u;
+            resource.lastUse = 0;
+        }
+        auto use = [&](GraphTexture texture, uint32_t step){
+            auto &resource = resources[texture.index];
+            resource.firstUse = std::min(resource.firstUse,step);
+            resource.lastUse = std::max(resource.lastUse,step);
+        };
+        for(uint32_t step = 0; step < executionOrder.size(); step++){
+            auto &pass = passes[executionOrder[step]];
+            if(auto target = std::get_if<GraphTexture>(&pass.target))
+                use(*target,step);
+            for(auto &binding : pass.bindings)
+                if(auto texture = std::get_if<GraphTexture>(&binding.resource))
+                    use(*texture,step);
+        }
+
+        //Greedy interval assignment, a slot is free again once the last pass using its previous texture has run
+        struct Slot{
+            GraphTextureInfo info;
+            uint32_t busyUntil;
+        };
+        std::vector<Slot> slots{};
+        std::vector<uint32_t> slotOf(resources.size(),~0u);
+        std::vector<uint32_t> transients{};
+        for(uint32_t r = 0; r < resources.size(); r++)
+            if(!resources[r].imported && resources[r].firstUse != ~0u)
+                transients.push_back(r);
+        std::stable_sort(transients.begin(),transients.end(),[&](uint32_t a, uint32_t b){
+            return resources[a].firstUse < resources[b].firstUse;});
+
+        lastStats.transientTextures = uint32_t(transients.size());
+        lastStats.transientBytes = 0;
+        for(auto r : transients){
+            auto &resource = resources[r];
+            lastStats.transientBytes += uint64_t(resource.info.width)*resource.info.height*texelSize(resource.info.format);
+            for(uint32_t s = 0; s < slots.size(); s++){
+                if(slots[s].busyUntil < resource.firstUse && compatible(slots[s].info,resource.info)){
+                    slotOf[r] = s;
+                    break;
+                }
+            }
+            if(slotOf[r] == ~0u){
+                slotOf[r] = uint32_t(slots.size());
+                slots.push_back({resource.info,0});
+            }
+            slots[slotOf[r]].busyUntil = resource.lastUse;
+        }
+
+        //Slots keep the textures of the previous frame when the descriptors still match
+        for(auto &physical : physicalTextures)
+            physical.used = false;
+        std::vector<Texture> slotTextures(slots.size());
+        lastStats.physicalBytes = 0;
+        for(uint32_t s = 0; s < slots.size(); s++){
+            auto &info = slots[s].info;
+            lastStats.physicalBytes += uint64_t(info.width)*info.height*texelSize(info.format);
+            for(auto &physical : physicalTextures){
+                if(!physical.used && compatible(physical.info,info)){
+                    physical.used = true;
+                    slotTextures[s] = physical.texture;
+                    break;
+                }
+            }
+            if(!slotTextures[s]){
+                slotTextures[s] = tgai.createTexture({info.width,info.height,nullptr,0,info.format,info.samplerMode,info.repeatMode});
+                physicalTextures.push_back({info,slotTextures[s],true});
+            }
+        }
+        lastStats.physicalTextures = uint32_t(slots.size());
+        for(uint32_t r = 0; r < resources.size(); r++)
+            if(!resources[r].imported)
+                resources[r].physical = slotOf[r] != ~0u?slotTextures[slotOf[r]]:Texture();
+    }
+
+    void RenderGraph::preparePass(const GraphPassInfo &pass)
+    {
+        std::variant<Texture, Window> target;
+        if(auto graphTexture = std::get_if<GraphTexture>(&pass.target))
+            target = resources[graphTexture->index].physical;
+        else
+            target = std::get<Window>(pass.target);
+
+        std::vector<std::vector<Binding>> setBindings(pass.inputLayout.setLayouts.size());
+        for(auto &binding : pass.bindings){
+            if(binding.setIndex >= setBindings.size())
+                throw std::runtime_error("[TGA RenderGraph] Pass " + pass.name + " binds a set outside of its input layout");
+            Binding resolved{};
+            if(auto graphTexture = std::get_if<GraphTexture>(&binding.resource))
+                resolved = Binding(resources[graphTexture->index].physical,binding.slot,binding.arrayElement);
+            else
+                resolved = Binding(std::get<Buffer>(binding.resource),binding.slot,binding.arrayElement);
+            setBindings[binding.setIndex].push_back(resolved);
+        }
+
+        RenderPassInfo renderPassInfo{pass.shaderStages,target,pass.vertexLayout,pass.clearOperations,
+            pass.rasterizerConfig,pass.inputLayout,pass.depthConfig};
+        auto &cachedPass = cachedPasses[pass.name];
+        bool recreatePass = !cachedPass.renderPass || !sameRenderPass(cachedPass.renderPassInfo,renderPassInfo);
+        if(recreatePass){
+            freeCachedPass(cachedPass);
+            cachedPass.renderPassInfo = renderPassInfo;
+            cachedPass.renderPass = tgai.createRenderPass(renderPassInfo);
+        }
+        if(recreatePass || cachedPass.setBindings.size() != setBindings.size()){
+            for(auto &inputSet : cachedPass.inputSets)
+                tgai.free(inputSet);
+            cachedPass.inputSets.assign(setBindings.size(),InputSet());
+            cachedPass.setBindings.assign(setBindings.size(),{});
+        }
+        for(uint32_t set = 0; set < setBindings.size(); set++){
+            if(cachedPass.inputSets[set] && sameBindings(cachedPass.setBindings[set],setBindings[set]))
+                continue;
+            if(cachedPass.inputSets[set])
+                tgai.free(cachedPass.inputSets[set]);
+            cachedPass.inputSets[set] = setBindings[set].empty()?InputSet():
+                tgai.createInputSet({cachedPass.renderPass,set,setBindings[set]});
+            cachedPass.setBindings[set] = setBindings[set];
+        }
+        cachedPass.used = true;
+    }
+
+    void RenderGraph::freeCachedPass(CachedPass &cachedPass)
+    {
+        for(auto &inputSet : cachedPass.inputSets)
+            if(inputSet)
+                tgai.free(inputSet);
+        cachedPass.inputSets.clear();
+        cachedPass.setBindings.clear();
+        if(cachedPass.renderPass)
+            tgai.free(cachedPass.renderPass);
+        cachedPass.renderPass = RenderPass();
+    }
+
+    CommandBuffer RenderGraph::record(uint32_t framebufferIndex)
+    {
+        if(!compiled)
+            compile();
+        tgai.beginCommandBuffer({});
+        for(auto passIndex : executionOrder){
+            auto &pass = passes[passIndex];
+            auto &cachedPass = cachedPasses[pass.name];
+            tgai.setRenderPass(cachedPass.renderPass,std::holds_alternative<Window>(pass.target)?framebufferIndex:0);
+            for(auto &inputSet : cachedPass.inputSets)
+                if(inputSet)
+                    tgai.bindInputSet(inputSet);
+            if(pass.record)
+                pass.record(tgai);
+        }
+        return tgai.endCommandBuffer();
+    }
+
+    GraphStats RenderGraph::stats() const
+    {
+        return lastStats;
+    }
+
+    Texture RenderGraph::physicalTexture(GraphTexture texture) const
+    {
+        if(!texture || texture.index >= resources.size())
+            throw std::runtime_error("[TGA RenderGraph] Texture was not declared");
+        return resources[texture.index].physical;
+    }
+}
@@ -0,0 +1,347 @@
+#include "tga/tga_streaming.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define TGA_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace tga
+{
+    namespace
+    {
+        //Linux transfers at most this many bytes per read call
+        constexpr size_t maxReadSize = 0x7ffff000;
+    }
+
+#ifdef TGA_IO_URING
+    //io_uring without liburing, the submission and completion rings are shared with the kernel through mmap
+    struct StreamLoader::Ring{
+        int fd{-1};
+        void *sqRing{MAP_FAILED};
+        size_t sqRingSize{0};
+        void *cqRing{MAP_FAILED};
+        size_t cqRingSize{0};
+        void *sqesMapping{MAP_FAILED};
+        size_t sqesSize{0};
+        io_uring_sqe *sqes{nullptr};
+        unsigned *sqTail{nullptr}, *sqMask{nullptr}, *sqArray{nullptr};
+        unsigned *cqHead{nullptr}, *cqTail{nullptr}, *cqMask{nullptr};
+        io_uring_cqe *cqes{nullptr};
+        std::vector<iovec> iovecs;
+        unsigned sqLocalTail{0};
+        unsigned unsubmitted{0};
+
+        bool setup(uint32_t entries)
+        {
+            io_uring_params params{};
+            fd = int(syscall(__NR_io_uring_setup,entries,&params));
+            if(fd < 0)
+                return false;
+            sqRingSize = params.sq_off.array+params.sq_entries*sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes+params.cq_entries*sizeof(io_uring_cqe);
+            bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+            if(singleMapping)
+                sqRingSize = cqRingSize = std::max(sqRingSize,cqRingSize);
+            sqRing = mmap(nullptr,sqRingSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQ_RING);
+            if(sqRing == MAP_FAILED)
+                return false;
+            cqRing = singleMapping?sqRing:mmap(nullptr,cqRingSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_CQ_RING);
+            if(cqRing == MAP_FAILED)
+                return false;
+            sqesSize = params.sq_entries*sizeof(io_uring_sqe);
+            sqesMapping = mmap(nullptr,sqesSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQES);
+            if(sqesMapping == MAP_FAILED)
+                return false;
+
+            auto sq = static_cast<uint8_t*>(sqRing);
+            sqTail = reinterpret_cast<unsigned*>(sq+params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq+params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq+params.sq_off.array);
+            sqes = static_cast<io_uring_sqe*>(sqesMapping);
+            auto cq = static_cast<uint8_t*>(cqRing);
+            cqHead = reinterpret_cast<unsigned*>(cq+params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq+params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq+params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq+params.cq_off.cqes);
+            sqLocalTail = *sqTail;
+            iovecs.resize(entries);
+            return true;
+        }
+
+        ~Ring()
+        {
+            if(sqesMapping != MAP_FAILED)
+                munmap(sqesMapping,sqesSize);
+            if(cqRing != MAP_FAILED && cqRing != sqRing)
+                munmap(cqRing,cqRingSize);
+            if(sqRing != MAP_FAILED)
+                munmap(sqRing,sqRingSize);
+            if(fd >= 0)
+                close(fd);
+        }
+
+        //Readv is used instead of read since it is supported by every io_uring capable kernel
+        void push(uint32_t slot, const Request &request)
+        {
+            auto index = sqLocalTail & *sqMask;
+            auto &sqe = sqes[index];
+            std::memset(&sqe,0,sizeof(sqe));
+            iovecs[slot] = {request.destination+request.done,std::min(request.size-request.done,maxReadSize)};
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = request.fd;
+            sqe.off = request.offset+request.done;
+            sqe.addr = reinterpret_cast<uint64_t>(&iovecs[slot]);
+            sqe.len = 1;
+            sqe.user_data = slot;
+            sqArray[index] = index;
+            sqLocalTail++;
+            unsubmitted++;
+        }
+
+        //Publishes pushed entries and submits them with one syscall, optionally waiting for a completion
+        void enter(bool wait)
+        {
+            __atomic_store_n(sqTail,sqLocalTail,__ATOMIC_RELEASE);
+            while(unsubmitted || wait){
+                int submitted = int(syscall(__NR_io_uring_enter,fd,unsubmitted,wait?1u:0u,wait?IORING_ENTER_GETEVENTS:0u,nullptr,0));
+                if(submitted < 0){
+                    if(errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                        continue;
+                    throw std::runtime_error("[TGA Streaming] io_uring_enter failed with errno " + std::to_string(errno));
+                }
+                unsubmitted -= unsigned(submitted);
+                wait = false;
+            }
+        }
+    };
+#else
+    struct StreamLoader::Ring{
+        bool setup(uint32_t)
+        {
+            return false;
+        }
+    };
+#endif
+
+    StreamLoader::StreamLoader(const StreamLoaderInfo &_loaderInfo):
+        loaderInfo(_loaderInfo),bytesReserved(0),inFlight(0),stopping(false)
+    {
+        loaderInfo.queueDepth = std::clamp(loaderInfo.queueDepth,1u,4096u);
+        if(loaderInfo.useIoUring){
+            auto candidate = std::make_unique<Ring>();
+            if(candidate->setup(loaderInfo.queueDepth))
+                ring = std::move(candidate);
+        }
+        if(ring){
+            slots.resize(loaderInfo.queueDepth);
+            for(uint32_t slot = loaderInfo.queueDepth; slot > 0; slot--)
+                freeSlots.push_back(slot-1);
+        }
+        else{
+            loaderInfo.workerCount = std::max(loaderInfo.workerCount,1u);
+            for(uint32_t i = 0; i < loaderInfo.workerCount; i++)
+                workers.emplace_back(&StreamLoader::workerLoop,this);
+        }
+    }
+
+    StreamLoader::~StreamLoader()
+    {
+        //The kernel may still write into the destinations and iovecs, so in-flight reads are drained first
+        queued.clear();
+        if(ring){
+            std::vector<StreamCompletion> discarded{};
+            while(inFlight > 0)
+                pollRing(true,discarded);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+        for(auto &worker : workers)
+            worker.join();
+        for(auto fd : files)
+            close(fd);
+    }
+
+    uint32_t StreamLoader::openFile(const std::string &fileName)
+    {
+        int fd = open(fileName.c_str(),O_RDONLY|O_CLOEXEC);
+        if(fd < 0)
+            throw std::runtime_error("[TGA Streaming] Could not open " + fileName);
+        files.push_back(fd);
+        return uint32_t(files.size()-1);
+    }
+
+    bool StreamLoader::read(uint32_t file, uint64_t offset, size_t size, uint8_t *destination, uint64_t userData)
+    {
+        if(file >= files.size())
+            throw std::runtime_error("[TGA Streaming] Read from a file that was not opened");
+        if(bytesReserved > 0 && bytesReserved+size > loaderInfo.memoryBudget)
+            return false;
+        queued.push_back({files[file],offset,size,destination,userData,0});
+        bytesReserved += size;
+        return true;
+    }
+
+    void StreamLoader::submit()
+    {
+        if(ring)
+            submitRing();
+        else
+            submitWorkers();
+    }
+
+    std::vector<StreamCompletion> StreamLoader::poll(bool wait)
+    {
+        std::vector<StreamCompletion> completions{};
+        if(wait && inFlight == 0)
+            submit();
+        if(ring)
+            pollRing(wait,completions);
+        else
+            pollWorkers(wait,completions);
+        for(auto &completion : completions)
+            bytesReserved -= completion.size;
+        submit();
+        return completions;
+    }
+
+    bool StreamLoader::usesIoUring() const
+    {
+        return bool(ring);
+    }
+
+    uint64_t StreamLoader::bytesOutstanding() const
+    {
+        return bytesReserved;
+    }
+
+    size_t StreamLoader::readsOutstanding() const
+    {
+        return queued.size()+inFlight;
+    }
+
+#ifdef TGA_IO_URING
+    void StreamLoader::submitRing()
+    {
+        while(!queued.empty() && !freeSlots.empty()){
+            auto slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot] = queued.front();
+            queued.pop_front();
+            ring->push(slot,slots[slot]);
+            inFlight++;
+        }
+        ring->enter(false);
+    }
+
+    void StreamLoader::pollRing(bool wait, std::vector<StreamCompletion> &completions)
+    {
+        size_t completed = completions.size();
+        while(true){
+            unsigned head = *ring->cqHead;
+            unsigned tail = __atomic_load_n(ring->cqTail,__ATOMIC_ACQUIRE);
+            for(; head != tail; head++){
+                auto &cqe = ring->cqes[head & *ring->cqMask];
+                auto slot = uint32_t(cqe.user_data);
+                auto &request = slots[slot];
+                int error = 0;
+                if(cqe.res == -EINTR || cqe.res == -EAGAIN){
+                    ring->push(slot,request);
+                    continue;
+                }
+                if(cqe.res < 0){
+                    error = -cqe.res;
+                }
+                else{
+                    request.done += size_t(cqe.res);
+                    //Short reads continue where they stopped, a read that returns nothing hit the end of the file
+                    if(request.done < request.size && cqe.res > 0){
+                        ring->push(slot,request);
+                        continue;
+                    }
+                    if(request.done < request.size)
+                        error = ENODATA;
+                }
+                completions.push_back({request.userData,request.destination,request.size,error});
+                freeSlots.push_back(slot);
+                inFlight--;
+            }
+            __atomic_store_n(ring->cqHead,head,__ATOMIC_RELEASE);
+            bool block = wait && completions.size() == completed && inFlight > 0;
+            ring->enter(block);
+            if(!block)
+                break;
+        }
+    }
+#else
+    void StreamLoader::submitRing()
+    {
+    }
+
+    void StreamLoader::pollRing(bool, std::vector<StreamCompletion>&)
+    {
+    }
+#endif
+
+    void StreamLoader::submitWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while(!queued.empty() && inFlight < loaderInfo.queueDepth){
+                jobs.push_back(queued.front());
+                queued.pop_front();
+                inFlight++;
+            }
+        }
+        jobAvailable.notify_all();
+    }
+
+    void StreamLoader::pollWorkers(bool wait, std::vector<StreamCompletion> &completions)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(wait)
+            jobFinished.wait(lock,[&](){return !finished.empty() || inFlight == 0;});
+        inFlight -= finished.size();
+        completions.insert(completions.end(),finished.begin(),finished.end());
+        finished.clear();
+    }
+
+    void StreamLoader::workerLoop()
+    {
+        while(true){
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock,[&](){return stopping || !jobs.empty();});
+                if(stopping)
+                    return;
+                request = jobs.front();
+                jobs.pop_front();
+            }
+            int error = 0;
+            while(request.done < request.size){
+                auto bytesRead = pread(request.fd,request.destination+request.done,std::min(request.size-request.done,maxReadSize),
+                    off_t(request.offset+request.done));
+                if(bytesRead < 0 && errno == EINTR)
+                    continue;
+                if(bytesRead <= 0){
+                    error = bytesRead < 0?errno:ENODATA;
+                    break;
+                }
+                request.done += size_t(bytesRead);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back({request.userData,request.destination,request.size,error});
+            }
+            jobFinished.notify_one();
+        }
+    }
+}
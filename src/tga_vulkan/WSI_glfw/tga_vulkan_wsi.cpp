@@ -1,9 +1,70 @@
 #include "tga/tga_vulkan/tga_vulkan_WSI.hpp"
 #include "GLFW/glfw3.h"
 #include <iostream>
+#include <thread>
 
 namespace tga
 {
+    int toGlfwKey(Key key);
+
+    namespace
+    {
+        //The oldest events are dropped when an application never takes them
+        constexpr size_t maxBufferedInputEvents = 4096;
+
+        Key fromGlfwKey(int glfwKey)
+        {
+            static const auto keys = [](){
+                std::array<Key,GLFW_KEY_LAST+1> keys{};
+                keys.fill(Key::Unknown);
+                for(size_t i = 0; i < size_t(Key::Unknown); i++){
+                    auto mapped = toGlfwKey(Key(i));
+                    if(mapped != GLFW_KEY_UNKNOWN)
+                        keys[size_t(mapped)] = Key(i);
+                }
+                return keys;
+            }();
+            return (glfwKey >= 0 && glfwKey <= GLFW_KEY_LAST)?keys[size_t(glfwKey)]:Key::Unknown;
+        }
+
+        void pushInputEvent(GLFWwindow *glfwWindow, InputEventType type, Key key)
+        {
+            auto &window = *static_cast<Window_TV*>(glfwGetWindowUserPointer(glfwWindow));
+            if(type != InputEventType::mouseMove)
+                window.input.keys[size_t(key)] = type == InputEventType::keyPress;
+            if(window.inputEvents.size() >= maxBufferedInputEvents)
+                window.inputEvents.pop_front();
+            window.inputEvents.push_back({type,key,window.input.mouseX,window.input.mouseY,glfwGetTime()});
+        }
+
+        void keyCallback(GLFWwindow *glfwWindow, int key, int, int action, int)
+        {
+            if(action != GLFW_REPEAT)
+                pushInputEvent(glfwWindow,action == GLFW_PRESS?InputEventType::keyPress:InputEventType::keyRelease,fromGlfwKey(key));
+        }
+
+        void mouseButtonCallback(GLFWwindow *glfwWindow, int button, int action, int)
+        {
+            Key key{};
+            switch (button)
+            {
+                case GLFW_MOUSE_BUTTON_LEFT: key = Key::MouseLeft; break;
+                case GLFW_MOUSE_BUTTON_MIDDLE: key = Key::MouseMiddle; break;
+                case GLFW_MOUSE_BUTTON_RIGHT: key = Key::MouseRight; break;
+                default: return;
+            }
+            pushInputEvent(glfwWindow,action == GLFW_PRESS?InputEventType::keyPress:InputEventType::keyRelease,key);
+        }
+
+        void cursorPosCallback(GLFWwindow *glfwWindow, double x, double y)
+        {
+            auto &window = *static_cast<Window_TV*>(glfwGetWindowUserPointer(glfwWindow));
+            window.input.mouseX = x;
+            window.input.mouseY = y;
+            pushInputEvent(glfwWindow,InputEventType::mouseMove,Key::Unknown);
+        }
+    }
+
     VulkanWSI::VulkanWSI()
     {
         glfwInit();
@@ -67,15 +128,27 @@ namespace tga
         std::vector<vk::Semaphore> renderSemas{};
         for(auto image : images){
             imageViews.emplace_back(device.createImageView({{},image,vk::ImageViewType::e2D,surfaceFormat.format,{},{vk::ImageAspectFlagBits::eColor,0,1,0,1}}));
-         //   fences.emplace_back(device.createFence({{vk::FenceCreateFlagBits::eSignaled}}));
-         //   availabilitySemas.emplace_back(device.createSemaphore({}));
-         //   renderSemas.emplace_back(device.createSemaphore({}));
         }
+        for(uint32_t i = 0; i < std::max(windowInfo.maxQueuedFrames,1u); i++){
+            fences.emplace_back(device.createFence({vk::FenceCreateFlagBits::eSignaled}));
+            availabilitySemas.emplace_back(device.createSemaphore({}));
+            renderSemas.emplace_back(device.createSemaphore({}));
+        }
+        std::chrono::steady_clock::duration minFrameInterval{};
+        if(windowInfo.frameRateLimit > 0)
+            minFrameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1./windowInfo.frameRateLimit));
 
-        Window_TV window_tv{surface,swapchain,extent,surfaceFormat.format,images,imageViews,glfwWindow,
-            device.createFence({vk::FenceCreateFlagBits::eSignaled}),device.createSemaphore({}),device.createSemaphore({}),0};
+        Window_TV window_tv{surface,swapchain,extent,surfaceFormat.format,images,imageViews,glfwWindow,fences,availabilitySemas,renderSemas,
+            0,0,windowInfo.maxQueuedFrames,minFrameInterval,{},{},0,{},{}};
         Window window = Window(TgaWindow(glfwWindow));
-        windows.emplace(window,window_tv);
+        //Map nodes keep their address, so the callbacks can write to the window directly
+        auto &handle = windows.emplace(window,window_tv).first->second;
+        glfwGetCursorPos(glfwWindow,&handle.input.mouseX,&handle.input.mouseY);
+        glfwSetWindowUserPointer(glfwWindow,&handle);
+        glfwSetKeyCallback(glfwWindow,keyCallback);
+        glfwSetMouseButtonCallback(glfwWindow,mouseButtonCallback);
+        glfwSetCursorPosCallback(glfwWindow,cursorPosCallback);
         return window;
     }
 
@@ -86,12 +159,12 @@ namespace tga
             device.destroy(imageView);
         device.destroy(handle.swapchain);
         instance.destroy(handle.surface);
-       // for(auto &fence : handle.inFlightFences)
-            device.destroy(handle.inFlightFence);
-       // for(auto &sema: handle.imageAvailableSemaphores)
-            device.destroy(handle.imageAvailableSemaphore);
-      //  for(auto &sema: handle.renderFinishedSemaphores)
-            device.destroy(handle.renderFinishedSemaphore);
+        for(auto &fence : handle.inFlightFences)
+            device.destroy(fence);
+        for(auto &sema: handle.imageAvailableSemaphores)
+            device.destroy(sema);
+        for(auto &sema: handle.renderFinishedSemaphores)
+            device.destroy(sema);
 
         glfwDestroyWindow(std::any_cast<GLFWwindow*>(handle.nativeHandle));
         windows.erase(window);
@@ -109,17 +182,45 @@ namespace tga
 
     uint32_t VulkanWSI::aquireNextImage(Window window) 
     {
-        glfwPollEvents();
         auto &handle = windows[window];
+        //The fence of the slot signals once the frame presented maxQueuedFrames frames ago has finished
+        (void)device.waitForFences({handle.inFlightFences[handle.frameSlot]},VK_TRUE,std::numeric_limits<uint64_t>::max());
+        if(handle.minFrameInterval.count() > 0)
+            std::this_thread::sleep_until(handle.lastFrameStart+handle.minFrameInterval);
+        handle.lastFrameStart = std::chrono::steady_clock::now();
+        //Input is pumped after waiting, so the frame starts with the latest state
+        glfwPollEvents();
         auto nextFrame = device.acquireNextImageKHR(handle.swapchain,std::numeric_limits<uint32_t>::max(),
-        handle.imageAvailableSemaphore,vk::Fence());
+        handle.imageAvailableSemaphores[handle.frameSlot],vk::Fence());
         handle.currentFrameIndex = nextFrame.value;
         return handle.currentFrameIndex;
     }
     void VulkanWSI::presentImage(Window window)
     {
         auto &handle = windows[window];
-        presentQueue.presentKHR({1,&handle.renderFinishedSemaphore,1,&handle.swapchain,&handle.currentFrameIndex});
+        presentQueue.presentKHR({1,&handle.renderFinishedSemaphores[handle.frameSlot],1,&handle.swapchain,&handle.currentFrameIndex});
+        auto now = std::chrono::steady_clock::now();
+        if(handle.lastPresent != std::chrono::steady_clock::time_point()){
+            double interval = std::chrono::duration<double,std::milli>(now-handle.lastPresent).count();
+            handle.frameIntervalMilli = handle.frameIntervalMilli > 0?0.9*handle.frameIntervalMilli+0.1*interval:interval;
+        }
+        handle.lastPresent = now;
+        if(handle.maxQueuedFrames == 0)
+            (void)device.waitForFences({handle.inFlightFences[handle.frameSlot]},VK_TRUE,std::numeric_limits<uint64_t>::max());
+        handle.frameSlot = (handle.frameSlot+1)%uint32_t(handle.inFlightFences.size());
+    }
+
+    FramePacing VulkanWSI::framePacing(Window window)
+    {
+        auto &handle = windows[window];
+        uint32_t queuedFrames = 0;
+        for(auto &fence : handle.inFlightFences)
+            if(device.getFenceStatus(fence) != vk::Result::eSuccess)
+                queuedFrames++;
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double,std::milli>(handle.frameIntervalMilli));
+        //The queued frames present first, one interval apart
+        return {queuedFrames,handle.frameIntervalMilli,handle.lastPresent+interval*(queuedFrames+1)};
     }
 
     bool VulkanWSI::windowShouldClose(Window window) 
@@ -128,29 +229,34 @@ namespace tga
         return glfwWindowShouldClose(std::any_cast<GLFWwindow*>(handle.nativeHandle));
     }
 
-    int toGlfwKey(Key key);
+    //Key state and cursor position are kept up to date by the callbacks whenever events are pumped
     bool VulkanWSI::keyDown(Window window, Key key)
     {
-        auto &handle = windows[window];
-        GLFWwindow* glfwWin = std::any_cast<GLFWwindow*>(handle.nativeHandle);
-        if(key == Key::MouseLeft)
-            return glfwGetMouseButton(glfwWin,GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-        if(key == Key::MouseMiddle)
-            return glfwGetMouseButton(glfwWin,GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS;
-        if(key == Key::MouseRight)
-            return glfwGetMouseButton(glfwWin,GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
-        auto glfwKey = toGlfwKey(key);
-        return glfwGetKey(glfwWin,glfwKey) == GLFW_PRESS;
+        return windows[window].input.keyDown(key);
     }
 
     std::pair<int, int> VulkanWSI::mousePosition(Window window)
     {
         auto &handle = windows[window];
-        GLFWwindow* glfwWin = std::any_cast<GLFWwindow*>(handle.nativeHandle);
-        double xpos = 0;
-        double ypos = 0;
-        glfwGetCursorPos(glfwWin,&xpos,&ypos);
-        return {int(xpos),int(ypos)};
+        return {int(handle.input.mouseX),int(handle.input.mouseY)};
+    }
+
+    void VulkanWSI::pollEvents()
+    {
+        glfwPollEvents();
+    }
+
+    std::vector<InputEvent> VulkanWSI::takeInputEvents(Window window)
+    {
+        auto &handle = windows[window];
+        std::vector<InputEvent> events(handle.inputEvents.begin(),handle.inputEvents.end());
+        handle.inputEvents.clear();
+        return events;
+    }
+
+    InputSnapshot VulkanWSI::inputSnapshot(Window window)
+    {
+        return windows[window].input;
     }
 
 
@@ -1,18 +1,33 @@
 #include "tga/tga_vulkan/tga_vulkan.hpp"
 #include "tga/tga_vulkan/tga_vulkan_debug.hpp"
+#include <sstream>
+#include <iomanip>
 
 namespace tga
 {
 
-    TGAVulkan::TGAVulkan():
-        wsi(VulkanWSI()),
+    TGAVulkan::TGAVulkan(const TGAVulkanInfo &tgaVulkanInfo):
+        vulkanInfo(tgaVulkanInfo),
+        wsi(tgaVulkanInfo.headless?nullptr:std::make_unique<VulkanWSI>()),
         instance(createInstance()),debugger(createDebugger()),pDevice(choseGPU()),
-        queueIndices(findQueueFamilies()),device(createDevice()),
+        queueIndices(findQueueFamilies()),dynamicRendering(supportsDynamicRendering()),device(createDevice()),
         graphicsQueue(device.getQueue(queueIndices.graphics,0)),transferQueue(device.getQueue(queueIndices.transfer,0)),
-        transferCmdPool(createCommandPool(queueIndices.transfer)),graphicsCmdPool(createCommandPool(queueIndices.graphics))
+        computeQueue(device.getQueue(queueIndices.compute,0)),transferCmdPool(createCommandPool(queueIndices.transfer)),
+        graphicsCmdPool(createCommandPool(queueIndices.graphics)),computeCmdPool(createCommandPool(queueIndices.compute))
     {
-        wsi.setVulkanHandles(instance,pDevice,device,graphicsQueue,queueIndices.graphics);
-        std::cout << "TGA Vulkan Created\n";
+        if(wsi)
+            wsi->setVulkanHandles(instance,pDevice,device,graphicsQueue,queueIndices.graphics);
+        if(vulkanInfo.profiling || vulkanInfo.tracing)
+            createProfilingResources();
+        //Diagnostics go to stderr, tools built on TGA write their results to stdout
+        std::cerr << "TGA Vulkan Created" << (wsi?"":" (headless)") << '\n';
+    }
+
+    VulkanWSI& TGAVulkan::getWSI()
+    {
+        if(!wsi)
+            throw std::runtime_error("TGAVulkan was created headless, window functions are not available");
+        return *wsi;
     }
 
     vk::Instance TGAVulkan::createInstance()
@@ -25,19 +40,44 @@ namespace tga
 
     vk::DebugUtilsMessengerEXT TGAVulkan::createDebugger()
     {
-        return createDebugMessenger(instance);
+        vk::DebugUtilsMessageSeverityFlagsEXT severityFlags{};
+        switch (vulkanInfo.debugSeverity)
+        {
+            case DebugSeverity::verbose: severityFlags |= vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose; [[fallthrough]];
+            case DebugSeverity::info: severityFlags |= vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo; [[fallthrough]];
+            case DebugSeverity::warning: severityFlags |= vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning; [[fallthrough]];
+            case DebugSeverity::error: severityFlags |= vk::DebugUtilsMessageSeverityFlagBitsEXT::eError; break;
+            default: return vk::DebugUtilsMessengerEXT();
+        }
+        if(!instanceExtensionSupported(VK_EXT_DEBUG_UTILS_EXTENSION_NAME))
+            return vk::DebugUtilsMessengerEXT();
+        return createDebugMessenger(instance,severityFlags);
     }
 
     vk::PhysicalDevice TGAVulkan::choseGPU()
     {
-        auto pdevices = instance.enumeratePhysicalDevices();
-        auto pdevice = pdevices.front();
-        for (auto &p : pdevices) {
-            auto props = p.getProperties();
-            if (props.deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
-                pdevice = p;
-        }
-        return pdevice;
+        auto &selection = vulkanInfo.deviceSelection;
+        bool anyUuid = std::all_of(selection.uuid.begin(),selection.uuid.end(),[](uint8_t byte){return byte == 0;});
+        auto matches = [&](vk::PhysicalDevice p){
+            auto props = p.getProperties2<vk::PhysicalDeviceProperties2,vk::PhysicalDeviceIDProperties>();
+            auto &properties = props.get<vk::PhysicalDeviceProperties2>().properties;
+            auto &idProperties = props.get<vk::PhysicalDeviceIDProperties>();
+            if(!selection.name.empty() && std::string(properties.deviceName).find(selection.name) == std::string::npos)
+                return false;
+            if(!anyUuid && !std::equal(selection.uuid.begin(),selection.uuid.end(),idProperties.deviceUUID.begin()))
+                return false;
+            return selection.type == DeviceType::any || properties.deviceType == determineDeviceType(selection.type);
+        };
+        std::vector<vk::PhysicalDevice> candidates{};
+        for(auto &p : instance.enumeratePhysicalDevices())
+            if(matches(p))
+                candidates.push_back(p);
+        if(candidates.empty())
+            throw std::runtime_error("[TGA Vulkan] No physical device matches the device selection");
+        for(auto &p : candidates)
+            if(p.getProperties().deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
+                return p;
+        return candidates.front();
     }
 
     uint32_t TGAVulkan::findQueueFamily(vk::QueueFlags mask,vk::QueueFlags flags)
@@ -55,23 +95,41 @@ namespace tga
         uint32_t transferQueue = findQueueFamily(vk::QueueFlagBits::eGraphics|vk::QueueFlagBits::eCompute|vk::QueueFlagBits::eTransfer,vk::QueueFlagBits::eTransfer);
         if(transferQueue == VK_QUEUE_FAMILY_IGNORED)
             transferQueue = graphicsQueue;
-        return {graphicsQueue, transferQueue};
+        uint32_t computeQueue = findQueueFamily(vk::QueueFlagBits::eGraphics|vk::QueueFlagBits::eCompute,vk::QueueFlagBits::eCompute);
+        if(computeQueue == VK_QUEUE_FAMILY_IGNORED)
+            computeQueue = graphicsQueue;
+        return {graphicsQueue, transferQueue, computeQueue};
     }
     vk::Device TGAVulkan::createDevice(){
         
         auto layers = getLayers();
         auto extensions = getDeviceExtentensions();
         auto features = getDeviceFeatures();
+        vk::DeviceCreateInfo deviceInfo{};
+#ifdef VK_KHR_dynamic_rendering
+        vk::PhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{VK_TRUE};
+        if(dynamicRendering)
+            deviceInfo.pNext = &dynamicRenderingFeatures;
+#endif
         float queuePriority = 1.0f;
         std::vector<vk::DeviceQueueCreateInfo> queueInfos;
         std::unordered_set<uint32_t> queueFamiliySet;
         queueFamiliySet.insert(queueIndices.graphics);
         queueFamiliySet.insert(queueIndices.transfer);
+        queueFamiliySet.insert(queueIndices.compute);
         for(auto family : queueFamiliySet){
             queueInfos.push_back(vk::DeviceQueueCreateInfo({},family,1,&queuePriority));
         }
-        return pDevice.createDevice( {{},uint32_t(queueInfos.size()),queueInfos.data(),
-            uint32_t(layers.size()),layers.data(),uint32_t(extensions.size()),extensions.data(),&features});
+        deviceInfo.setQueueCreateInfoCount(uint32_t(queueInfos.size())).setPQueueCreateInfos(queueInfos.data())
+            .setEnabledLayerCount(uint32_t(layers.size())).setPpEnabledLayerNames(layers.data())
+            .setEnabledExtensionCount(uint32_t(extensions.size())).setPpEnabledExtensionNames(extensions.data())
+            .setPEnabledFeatures(&features);
+        auto logicalDevice = pDevice.createDevice(deviceInfo);
+#ifdef VK_KHR_dynamic_rendering
+        if(dynamicRendering)
+            loadDynamicRenderingFunctions(logicalDevice);
+#endif
+        return logicalDevice;
     }
 
      vk::CommandPool TGAVulkan::createCommandPool(uint32_t queueFamily, vk::CommandPoolCreateFlags flags)
@@ -81,20 +139,58 @@ namespace tga
 
     TGAVulkan::~TGAVulkan(){
         device.waitIdle();
+        countEvent(&PerformanceCounters::waitIdles);
+        auto live = memoryReport(0).liveHandles;
+        if(live.shaders+live.buffers+live.textures+live.windows+live.inputSets+live.renderPasses+live.commandBuffers+live.readbacks > 0){
+            std::cerr << "[TGA VULKAN]: Handles still alive at destruction\n";
+            printMemoryReport(std::cerr);
+        }
         while(shaders.size()>0)
             free(shaders.begin()->first);
         while(buffers.size()>0)
             free(buffers.begin()->first);
         while(textures.size()>0)
             free(textures.begin()->first);
-        while(wsi.windows.size()>0)
-            free(wsi.windows.begin()->first);
+        while(wsi && wsi->windows.size()>0)
+            free(wsi->windows.begin()->first);
         while(inputSets.size()>0)
             free(inputSets.begin()->first);
         while(renderPasses.size()>0)
             free(renderPasses.begin()->first);
+        while(readbacks.size()>0)
+            free(readbacks.begin()->first);
+        for(auto &readback : readbackPool){
+            device.destroy(readback.fence);
+            device.destroy(readback.buffer);
+            freeMemory(readback.memory);
+        }
+        for(auto &staging : stagingInFlight)
+            (void)device.waitForFences({staging.fence},VK_TRUE,std::numeric_limits<uint64_t>::max());
+        recycleStaging();
+        for(auto &[id, staging] : stagingRegions)
+            stagingPool.push_back(staging);
+        for(auto &staging : stagingPool){
+            device.destroy(staging.fence);
+            device.destroy(staging.buffer);
+            freeMemory(staging.memory);
+        }
+        for(auto &pending : pendingProfiles)
+            device.destroy(pending.fence);
+        for(auto &fence : profileFences)
+            device.destroy(fence);
+        if(timestampPool)
+            device.destroy(timestampPool);
+        if(statisticsPool)
+            device.destroy(statisticsPool);
+        for(auto &[commandBuffer, handle] : commandBuffers){
+            if(handle.computeSync){
+                device.destroy(handle.computeSync->graphicsReleased);
+                device.destroy(handle.computeSync->computeFinished);
+            }
+        }
         device.destroy(transferCmdPool);
         device.destroy(graphicsCmdPool);
+        device.destroy(computeCmdPool);
         device.destroy();
         if(debugger)
             instance.destroy(debugger);
@@ -104,6 +200,7 @@ namespace tga
     /*Interface Methodes*/
     Shader TGAVulkan::createShader(const ShaderInfo &shaderInfo) 
     {
+        CallTimer timer(*this,InterfaceCall::createShader);
         vk::ShaderModule module = device.createShaderModule({{},shaderInfo.srcSize,reinterpret_cast<const uint32_t*>(shaderInfo.src)});
         Shader handle = Shader(TgaShader(VkShaderModule(module)));
         Shader_TV shader{module,shaderInfo.type};
@@ -112,8 +209,9 @@ namespace tga
     }
     Buffer TGAVulkan::createBuffer(const BufferInfo &bufferInfo) 
     {
+        CallTimer timer(*this,InterfaceCall::createBuffer);
         auto usage = determineBufferFlags(bufferInfo.usage);
-        Buffer_TV buffer = allocateBuffer(bufferInfo.dataSize,usage,vk::MemoryPropertyFlagBits::eDeviceLocal);
+        Buffer_TV buffer = allocateBuffer(bufferInfo.dataSize,usage,vk::MemoryPropertyFlagBits::eDeviceLocal,ResourceKind::buffer);
         Buffer handle = Buffer(TgaBuffer(VkBuffer(buffer.buffer)));
         buffers.emplace(handle, buffer);
         if(bufferInfo.data!=nullptr)
@@ -122,6 +220,7 @@ namespace tga
     }
     Texture TGAVulkan::createTexture(const TextureInfo &textureInfo) 
     {
+        CallTimer timer(*this,InterfaceCall::createTexture);
         vk::Format format = determineImageFormat(textureInfo.format);
         vk::Extent3D extent{textureInfo.width,textureInfo.height,1};
         vk::Image image = device.createImage({{},vk::ImageType::e2D,format,
@@ -129,13 +228,13 @@ namespace tga
             vk::ImageUsageFlagBits::eSampled|vk::ImageUsageFlagBits::eTransferDst|vk::ImageUsageFlagBits::eTransferSrc|vk::ImageUsageFlagBits::eColorAttachment,
             vk::SharingMode::eExclusive});
         auto mr = device.getImageMemoryRequirements(image);
-        vk::DeviceMemory memory = device.allocateMemory({ mr.size, findMemoryType(mr.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal)});
+        vk::DeviceMemory memory = allocateMemory(mr,vk::MemoryPropertyFlagBits::eDeviceLocal,ResourceKind::texture,reinterpret_cast<uint64_t>(VkImage(image)));
         device.bindImageMemory(image,memory,0);
         vk::ImageView view = device.createImageView({{},image,vk::ImageViewType::e2D,format,{},{vk::ImageAspectFlagBits::eColor,0,1,0,1}});
 
         auto [filter, addressMode] = determineSamplerInfo(textureInfo);
         vk::Sampler sampler = device.createSampler({{},filter,filter,vk::SamplerMipmapMode::eLinear,addressMode,addressMode,addressMode});
-        Texture_TV texture{image,view,memory,sampler,extent,format};
+        Texture_TV texture{image,view,memory,sampler,extent,format,textureInfo.format};
         Texture handle = Texture(TgaTexture(VkImage(image)));
         textures.emplace(handle, texture);
         auto transitionCmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
@@ -146,11 +245,11 @@ namespace tga
             endOneTimeCmdBuffer(transitionCmdBuffer,graphicsCmdPool,graphicsQueue);
             fillTexture(textureInfo.dataSize,textureInfo.data,textureInfo.width,textureInfo.height, image);
             transitionCmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
-            transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eTransferDstOptimal,vk::ImageLayout::eGeneral);
+            transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eTransferDstOptimal,restingTextureLayout);
             endOneTimeCmdBuffer(transitionCmdBuffer,graphicsCmdPool,graphicsQueue);
         }
         else{
-            transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eUndefined,vk::ImageLayout::eGeneral);
+            transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eUndefined,restingTextureLayout);
             endOneTimeCmdBuffer(transitionCmdBuffer,graphicsCmdPool,graphicsQueue);
         }    
         
@@ -158,328 +257,1108 @@ namespace tga
     }
     Window TGAVulkan::createWindow(const WindowInfo &windowInfo) 
     {
-        auto window = wsi.createWindow(windowInfo);
-        auto &handle = wsi.getWindow(window);
+        CallTimer timer(*this,InterfaceCall::createWindow);
+        auto window = getWSI().createWindow(windowInfo);
+        auto &handle = getWSI().getWindow(window);
         auto transitionCmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
         for(auto &image : handle.images)
-            transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eUndefined,vk::ImageLayout::eColorAttachmentOptimal);
+            transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eUndefined,vk::ImageLayout::ePresentSrcKHR);
         endOneTimeCmdBuffer(transitionCmdBuffer,graphicsCmdPool,graphicsQueue);
         return window;
     }
     InputSet TGAVulkan::createInputSet(const InputSetInfo &inputSetInfo) 
     {
-        uint32_t bufferCount = 0;
-        uint32_t textureCount = 0;
-        for(auto &binding : inputSetInfo.bindings){
-            if(std::get_if<Buffer>(&binding.resource))
-                bufferCount++;
-            else
-                textureCount++;
-        }
+        CallTimer timer(*this,InterfaceCall::createInputSet);
+        auto &subpasses = renderPasses[inputSetInfo.targetRenderPass].subpasses;
+        if(inputSetInfo.subpass >= subpasses.size() || inputSetInfo.setIndex >= subpasses[inputSetInfo.subpass].setLayouts.size())
+            throw std::runtime_error("[TGA Vulkan] Input set does not match a set of the render pass");
+        auto &subpass = subpasses[inputSetInfo.subpass];
+        //Buffers are uniform buffers unless the input layout declares a storage buffer in their slot
+        auto descriptorType = [&](const Binding &binding){
+            if(std::get_if<Texture>(&binding.resource))
+                return vk::DescriptorType::eCombinedImageSampler;
+            auto &types = subpass.descriptorTypes;
+            if(inputSetInfo.setIndex < types.size() && binding.slot < types[inputSetInfo.setIndex].size() &&
+                types[inputSetInfo.setIndex][binding.slot] == vk::DescriptorType::eStorageBuffer)
+                return vk::DescriptorType::eStorageBuffer;
+            return vk::DescriptorType::eUniformBuffer;
+        };
+        std::map<vk::DescriptorType,uint32_t> descriptorCounts{};
+        for(auto &binding : inputSetInfo.bindings)
+            descriptorCounts[descriptorType(binding)]++;
         std::vector<vk::DescriptorPoolSize> poolSizes{};
-        if(bufferCount>0)
-            poolSizes.emplace_back(vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer,bufferCount));
-        if(textureCount>0)
-            poolSizes.emplace_back(vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler,textureCount));
+        for(auto &[type, count] : descriptorCounts)
+            poolSizes.emplace_back(vk::DescriptorPoolSize(type,count));
         
         vk::DescriptorPool descPool = device.createDescriptorPool({{},1,uint32_t(poolSizes.size()),poolSizes.data()});
+        countEvent(&PerformanceCounters::descriptorPoolsCreated);
 
-        auto layout = renderPasses[inputSetInfo.targetRenderPass].setLayouts[inputSetInfo.setIndex];
+        auto layout = subpass.setLayouts[inputSetInfo.setIndex];
         vk::DescriptorSet descSet = device.allocateDescriptorSets({descPool,1,&layout})[0];
+        std::vector<Texture> boundTextures{};
         for(auto &binding : inputSetInfo.bindings){
             if(auto resource = std::get_if<Buffer>(&binding.resource)){
                 auto &buffer = buffers[*resource];
                 vk::DescriptorBufferInfo bufferInfo{buffer.buffer,0,VK_WHOLE_SIZE};
                 vk::WriteDescriptorSet writeSet{descSet,binding.slot,binding.arrayElement,1,
-                vk::DescriptorType::eUniformBuffer,{},&bufferInfo};
+                descriptorType(binding),{},&bufferInfo};
                 device.updateDescriptorSets({writeSet},{});
             }    
             else if(auto resource = std::get_if<Texture>(&binding.resource)){
                 auto &texture = textures[*resource];
-                vk::DescriptorImageInfo imageInfo{texture.sampler,texture.imageView,vk::ImageLayout::eGeneral};
+                vk::DescriptorImageInfo imageInfo{texture.sampler,texture.imageView,restingTextureLayout};
                 vk::WriteDescriptorSet writeSet{descSet,binding.slot,binding.arrayElement,1,
                 vk::DescriptorType::eCombinedImageSampler,&imageInfo};
                 device.updateDescriptorSets({writeSet},{});
+                boundTextures.push_back(*resource);
             }
         }
         InputSet inputSet = InputSet(TgaInputSet(VkDescriptorPool(descPool)));
-        InputSet_TV inputSet_tv{descPool,descSet};
+        InputSet_TV inputSet_tv{descPool,descSet,inputSetInfo.setIndex,inputSetInfo.subpass,boundTextures};
         inputSets.emplace(inputSet,inputSet_tv);
         return inputSet;
     }
     RenderPass TGAVulkan::createRenderPass(const RenderPassInfo &renderPassInfo) 
     {
+        CallTimer timer(*this,InterfaceCall::createRenderPass);
         vk::RenderPass renderPass;
         std::vector<vk::Framebuffer> framebuffers;
         vk::Extent2D area{};
+        std::vector<ColorTarget_TV> targetTextures{};
+        bool clearsColor = renderPassInfo.clearOperations == ClearOperation::all || renderPassInfo.clearOperations == ClearOperation::color;
+        auto &additionalTargets = renderPassInfo.additionalTargets;
+        std::vector<SubpassInfo> subpassInfos = renderPassInfo.subpasses;
+        if(subpassInfos.empty()){
+            //The single subpass writes the render target and every additional target
+            std::vector<uint32_t> colorAttachments{};
+            for(uint32_t i = 0; i <= additionalTargets.size(); i++)
+                colorAttachments.push_back(i);
+            subpassInfos.emplace_back(renderPassInfo.shaderStages,colorAttachments,std::vector<uint32_t>{},
+                renderPassInfo.vertexLayout,renderPassInfo.rasterizerConfig,renderPassInfo.inputLayout);
+        }
+        auto &firstStages = subpassInfos[0].shaderStages;
+        if(subpassInfos.size() == 1 && firstStages.size() == 1 && shaders[firstStages[0]].type == ShaderType::compute){
+            //Compute passes have no attachments, their pipeline identifies them
+            RenderPass_TV renderPass_tv{};
+            renderPass_tv.subpasses.push_back(makeSubpass(subpassInfos[0],0,vk::SampleCountFlagBits::e1,{},{},{}));
+            renderPass_tv.compute = true;
+            RenderPass handle = RenderPass(TgaRenderPass(VkPipeline(renderPass_tv.subpasses[0].pipeline)));
+            renderPasses.emplace(handle,renderPass_tv);
+            return handle;
+        }
+        bool depthTested = false;
+        for(auto &subpassInfo : subpassInfos)
+            depthTested = depthTested || subpassInfo.rasterizerConfig.depthCompareOp != CompareOperation::ignore;
+        vk::Format depthFormat = determineDepthFormat(renderPassInfo.depthConfig.format,depthTested);
+        if(depthFormat == vk::Format::eUndefined && depthTested)
+            throw std::runtime_error("[TGA Vulkan] Depth testing requires a depth attachment");
+        std::vector<vk::Format> intermediateFormats{};
+        for(auto format : renderPassInfo.intermediateAttachments)
+            intermediateFormats.push_back(determineImageFormat(format));
+        auto samples = determineSampleCount(renderPassInfo.sampleCount,depthFormat != vk::Format::eUndefined);
+        bool multisampled = samples != vk::SampleCountFlagBits::e1;
+        //The multisampled attachments cannot be seeded from the single sampled targets
+        if(renderPassInfo.sampleCount != SampleCount::x1 && !clearsColor)
+            throw std::runtime_error("[TGA Vulkan] Multisampled passes have to clear their color targets");
+
+        std::vector<vk::Format> colorFormats{vk::Format::eUndefined};
+        std::vector<vk::ImageView> additionalViews{};
+        for(auto &colorTarget : additionalTargets){
+            auto &texture = textures[colorTarget.texture];
+            colorFormats.push_back(texture.format);
+            additionalViews.push_back(texture.imageView);
+            bool discardContent = clearsColor || multisampled || colorTarget.loadOperation != LoadOperation::load;
+            targetTextures.push_back({colorTarget.texture,discardContent});
+        }
+
+        std::optional<DepthKey_TV> depthKey{};
+        std::vector<Attachment_TV> intermediateAttachments{};
+        std::vector<Attachment_TV> multisampleAttachments{};
+        //Per pass attachments, created once the extent of the render target is known
+        auto createAttachments = [&](uint64_t owner){
+            depthKey = acquireDepthBuffer(owner,area,depthFormat,samples,renderPassInfo.depthConfig);
+            for(auto format : intermediateFormats)
+                intermediateAttachments.push_back(createIntermediateAttachment(area,format,samples));
+            if(!multisampled)
+                return;
+            for(auto format : colorFormats)
+                multisampleAttachments.push_back(createMultisampleAttachment(area,format,samples));
+        };
+        //Attachment views of one framebuffer, the render target is filled in per framebuffer.
+        //Multisampled passes render into their own attachments and resolve into the targets, which come last
+        auto framebufferViews = [&](vk::ImageView targetView){
+            std::vector<vk::ImageView> views{};
+            for(auto &attachment : multisampleAttachments)
+                views.push_back(attachment.imageView);
+            if(!multisampled){
+                views.push_back(targetView);
+                views.insert(views.end(),additionalViews.begin(),additionalViews.end());
+            }
+            for(auto &attachment : intermediateAttachments)
+                views.push_back(attachment.imageView);
+            if(depthKey)
+                views.push_back(depthBuffers[*depthKey].imageView);
+            if(multisampled){
+                views.push_back(targetView);
+                views.insert(views.end(),additionalViews.begin(),additionalViews.end());
+            }
+            return views;
+        };
+        //Invalid targets are rejected before any attachment is allocated for the pass
+        if(auto renderTarget = std::get_if<Texture>(&renderPassInfo.renderTarget))
+            area = vk::Extent2D(textures[*renderTarget].extent.width,textures[*renderTarget].extent.height);
+        else if(auto renderTarget = std::get_if<Window>(&renderPassInfo.renderTarget))
+            area = getWSI().getWindow(*renderTarget).extent;
+        for(auto &colorTarget : additionalTargets){
+            auto &extent = textures[colorTarget.texture].extent;
+            if(extent.width != area.width || extent.height != area.height)
+                throw std::runtime_error("[TGA Vulkan] Additional targets need the extent of the render target");
+        }
+        validateSubpasses(subpassInfos,uint32_t(colorFormats.size()),uint32_t(intermediateFormats.size()));
+
+        //Single subpass passes that write every target in order need neither render pass nor framebuffers when the device supports dynamic rendering
+        auto &firstColorAttachments = subpassInfos[0].colorAttachments;
+        bool writesTargetsInOrder = firstColorAttachments.size() == colorFormats.size();
+        for(uint32_t i = 0; i < firstColorAttachments.size() && writesTargetsInOrder; i++)
+            writesTargetsInOrder = firstColorAttachments[i] == i;
+        bool dynamic = dynamicRendering && subpassInfos.size() == 1 && intermediateFormats.empty() && writesTargetsInOrder;
+        std::vector<vk::AttachmentDescription> attachments{};
+        std::vector<std::vector<vk::ImageView>> attachmentViews{};
+        std::vector<vk::Image> backbuffers{};
         if(auto renderTarget = std::get_if<Texture>(&renderPassInfo.renderTarget)){
             auto &renderTex = textures[*renderTarget];
-            area = vk::Extent2D(renderTex.extent.width,renderTex.extent.height);
-            if(!textureDepthBuffers.count(*renderTarget))
-                textureDepthBuffers.emplace(*renderTarget,createDepthBuffer(renderTex.extent.width,renderTex.extent.height));
-            auto &depthBuffer = textureDepthBuffers[*renderTarget];
-            renderPass = makeRenderPass(renderTex.format,renderPassInfo.clearOperations,vk::ImageLayout::eGeneral);
-            std::array<vk::ImageView, 2> attachments{ renderTex.imageView,depthBuffer.imageView };
-            framebuffers.emplace_back(device.createFramebuffer({{}, renderPass, 
-                attachments.size(),attachments.data(),renderTex.extent.width,renderTex.extent.height,1}));
-            
+            colorFormats[0] = renderTex.format;
+            createAttachments(reinterpret_cast<uint64_t>(TgaTexture(*renderTarget)));
+            //Texture targets are transitioned by the state tracker when the pass begins
+            attachments = makeAttachments(renderPassInfo,colorFormats,vk::ImageLayout::eColorAttachmentOptimal,vk::ImageLayout::eColorAttachmentOptimal,
+                depthFormat,intermediateFormats,samples);
+            targetTextures.insert(targetTextures.begin(),ColorTarget_TV{*renderTarget,clearsColor || multisampled});
+            attachmentViews.push_back(framebufferViews(renderTex.imageView));
         }
         else if(auto renderTarget = std::get_if<Window>(&renderPassInfo.renderTarget)){
-            auto &renderWindow = wsi.getWindow(*renderTarget);
-            area = renderWindow.extent;
-            if(!windowDepthBuffers.count(*renderTarget))
-                windowDepthBuffers.emplace(*renderTarget,createDepthBuffer(renderWindow.extent.width,renderWindow.extent.height));
-            auto &depthBuffer = windowDepthBuffers[*renderTarget];
-            renderPass = makeRenderPass(renderWindow.format,renderPassInfo.clearOperations,vk::ImageLayout::eColorAttachmentOptimal);
-            for(uint32_t i = 0; i < renderWindow.imageViews.size();i++){
-                std::array<vk::ImageView, 2> attachments{ renderWindow.imageViews[i],depthBuffer.imageView };
-                framebuffers.emplace_back(device.createFramebuffer({{}, renderPass, 
-                attachments.size(),attachments.data(),renderWindow.extent.width,renderWindow.extent.height,1}));
-            }
+            auto &renderWindow = getWSI().getWindow(*renderTarget);
+            colorFormats[0] = renderWindow.format;
+            createAttachments(reinterpret_cast<uint64_t>(TgaWindow(*renderTarget)));
+            //Backbuffers rest in ePresentSrcKHR, cleared and resolved passes discard the previous content
+            attachments = makeAttachments(renderPassInfo,colorFormats,
+                (clearsColor || multisampled)?vk::ImageLayout::eUndefined:vk::ImageLayout::ePresentSrcKHR,vk::ImageLayout::ePresentSrcKHR,
+                depthFormat,intermediateFormats,samples);
+            for(auto &imageView : renderWindow.imageViews)
+                attachmentViews.push_back(framebufferViews(imageView));
+            if(dynamic)
+                backbuffers = renderWindow.images;
         }
-        std::vector<vk::DescriptorSetLayout> setLayouts = decodeInputLayout(renderPassInfo.inputLayout);
 
-        auto pipelineLayout = device.createPipelineLayout({{},uint32_t(setLayouts.size()),setLayouts.data()});
-        auto pipeline = makePipeline(renderPassInfo,pipelineLayout,renderPass);
-        RenderPass_TV renderPass_tv{framebuffers,renderPass,setLayouts,pipelineLayout,pipeline,area};
-        RenderPass handle = RenderPass(TgaRenderPass(VkRenderPass(renderPass)));
+        auto colorCount = uint32_t(colorFormats.size());
+        std::vector<Subpass_TV> subpasses{};
+        if(dynamic){
+#ifdef VK_KHR_dynamic_rendering
+            //Stencil is never used, beginDynamicRendering only binds the depth aspect of combined formats
+            vk::PipelineRenderingCreateInfoKHR renderingInfo{0,colorCount,colorFormats.data(),depthFormat,vk::Format::eUndefined};
+            subpasses.push_back(makeSubpass(subpassInfos[0],0,samples,{},additionalTargets,intermediateAttachments,&renderingInfo));
+#endif
+        }
+        else{
+            renderPass = makeRenderPass(attachments,colorCount,uint32_t(intermediateFormats.size()),depthKey.has_value(),subpassInfos);
+            for(auto &views : attachmentViews)
+                framebuffers.emplace_back(device.createFramebuffer({{}, renderPass,
+                    uint32_t(views.size()),views.data(),area.width,area.height,1}));
+            for(uint32_t i = 0; i < subpassInfos.size(); i++)
+                subpasses.push_back(makeSubpass(subpassInfos[i],i,samples,renderPass,additionalTargets,intermediateAttachments));
+            attachmentViews.clear();
+        }
+        std::vector<vk::ClearValue> clearValues(colorFormats.size()+intermediateAttachments.size(),vk::ClearColorValue(std::array<float,4>{0.,0.,0.,0.}));
+        if(depthKey)
+            clearValues.push_back(vk::ClearDepthStencilValue(1.f, 0.));
+        RenderPass_TV renderPass_tv{framebuffers,renderPass,subpasses,area,targetTextures,depthKey,intermediateAttachments,
+            multisampleAttachments,clearValues,attachments,attachmentViews,backbuffers,colorCount,false};
+        //Dynamic passes have no render pass object, their first pipeline identifies them
+        RenderPass handle = renderPass?RenderPass(TgaRenderPass(VkRenderPass(renderPass))):RenderPass(TgaRenderPass(VkPipeline(subpasses[0].pipeline)));
         renderPasses.emplace(handle,renderPass_tv);
         return handle;
     }
 
     void TGAVulkan::beginCommandBuffer(const CommandBufferInfo &commandBufferInfo) 
     {
-        (void)commandBufferInfo; //Warning Silencer
+        CallTimer timer(*this,InterfaceCall::beginCommandBuffer);
         if(currentRecording.cmdBuffer)
             throw std::runtime_error("Commandbuffer did not finish recording yet!");
-        currentRecording.cmdBuffer = device.allocateCommandBuffers({graphicsCmdPool,vk::CommandBufferLevel::ePrimary,1})[0];
+        currentRecording.asyncCompute = commandBufferInfo.asyncCompute;
+        currentRecording.waitsForCompute = commandBufferInfo.waitsForCompute;
+        auto &cmdPool = commandBufferInfo.asyncCompute?computeCmdPool:graphicsCmdPool;
+        currentRecording.cmdBuffer = device.allocateCommandBuffers({cmdPool,vk::CommandBufferLevel::ePrimary,1})[0];
         currentRecording.cmdBuffer.begin({vk::CommandBufferUsageFlagBits::eSimultaneousUse});
     }
     void TGAVulkan::bindVertexBuffer(Buffer buffer) 
     {
+        CallTimer timer(*this,InterfaceCall::bindVertexBuffer);
         auto &handle = buffers[buffer];
         currentRecording.cmdBuffer.bindVertexBuffers(0,{handle.buffer},{0});
     }
-    void TGAVulkan::bindIndexBuffer(Buffer buffer) 
+    void TGAVulkan::bindIndexBuffer(Buffer buffer, IndexType indexType) 
     {
+        CallTimer timer(*this,InterfaceCall::bindIndexBuffer);
         auto &handle = buffers[buffer];
-        currentRecording.cmdBuffer.bindIndexBuffer(handle.buffer,0,vk::IndexType::eUint32);
+        currentRecording.cmdBuffer.bindIndexBuffer(handle.buffer,0,
+            indexType == IndexType::uint16?vk::IndexType::eUint16:vk::IndexType::eUint32);
     }
 
     void TGAVulkan::bindInputSet(InputSet inputSet)
     {
+        CallTimer timer(*this,InterfaceCall::bindInputSet);
         auto &handle = inputSets[inputSet];
         auto &renderPass = renderPasses[currentRecording.renderPass];
-        currentRecording.cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,renderPass.pipelineLayout,0,1,&handle.descriptorSet,0,nullptr);
+        auto &subpass = renderPass.subpasses[currentRecording.subpass];
+        //Textures sampled by async compute are handed over from graphics, they go back when the command buffer ends
+        if(currentRecording.asyncCompute && queueIndices.compute != queueIndices.graphics){
+            std::vector<vk::ImageMemoryBarrier> acquires{};
+            for(auto &texture : handle.textures){
+                auto &computeTextures = currentRecording.computeTextures;
+                if(std::find(computeTextures.begin(),computeTextures.end(),texture) != computeTextures.end())
+                    continue;
+                computeTextures.push_back(texture);
+                acquires.push_back(ownershipTransfer(texture,queueIndices.graphics,queueIndices.compute,vk::AccessFlagBits::eShaderRead));
+            }
+            if(!acquires.empty())
+                currentRecording.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,vk::PipelineStageFlagBits::eComputeShader,
+                    {},{},{},acquires);
+        }
+        auto bindPoint = renderPass.compute?vk::PipelineBindPoint::eCompute:vk::PipelineBindPoint::eGraphics;
+        currentRecording.cmdBuffer.bindDescriptorSets(bindPoint,subpass.pipelineLayout,handle.setIndex,1,&handle.descriptorSet,0,nullptr);
     }
     void TGAVulkan::draw(uint32_t vertexCount, uint32_t firstVertex) 
     {
+        CallTimer timer(*this,InterfaceCall::draw);
         currentRecording.cmdBuffer.draw(vertexCount,1,firstVertex,0);
     }
     void TGAVulkan::drawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset) 
     {
+        CallTimer timer(*this,InterfaceCall::drawIndexed);
         currentRecording.cmdBuffer.drawIndexed(indexCount,1,firstIndex,vertexOffset,0);
     }
+    void TGAVulkan::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+    {
+        CallTimer timer(*this,InterfaceCall::dispatch);
+        if(!currentRecording.renderPass || !renderPasses[currentRecording.renderPass].compute)
+            throw std::runtime_error("[TGA Vulkan] dispatch outside of a compute pass");
+        currentRecording.cmdBuffer.dispatch(groupCountX,groupCountY,groupCountZ);
+    }
     void TGAVulkan::setRenderPass(RenderPass renderPass, uint32_t framebufferIndex) 
     {
+        CallTimer timer(*this,InterfaceCall::setRenderPass);
         if(currentRecording.renderPass){
-            currentRecording.cmdBuffer.endRenderPass();
+            finishRenderPass();
         }
         auto &cmd = currentRecording.cmdBuffer;
         auto &handle = renderPasses[renderPass];
-        std::array<float,4> colorClear ={0.,0.,0.,0.};
-        std::array<vk::ClearValue, 2> clearValues = { };
-        clearValues[0] = vk::ClearColorValue(colorClear);
-        clearValues[1] = vk::ClearDepthStencilValue(1.f, 0.);
-
-        uint32_t frameIndex = std::min(framebufferIndex,uint32_t(handle.framebuffers.size()-1));
-        cmd.beginRenderPass({handle.renderPass,handle.framebuffers[frameIndex],{{},handle.area},
-            clearValues.size(),clearValues.data()},vk::SubpassContents::eInline);
-        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,handle.pipeline);
-        cmd.setViewport(0,{{0,0,float(handle.area.width),float(handle.area.height),0,1}});
-        cmd.setScissor(0,{{{},handle.area}});
+        if(currentRecording.asyncCompute && !handle.compute)
+            throw std::runtime_error("[TGA Vulkan] Async compute command buffers can only contain compute passes");
+
+        //Profiles are harvested through graphics submissions, async compute is not profiled
+        uint32_t querySlot = 0;
+        currentRecording.profilingPass = timestampPool && !freeQuerySlots.empty() && !currentRecording.asyncCompute;
+        if(currentRecording.profilingPass){
+            querySlot = freeQuerySlots.back();
+            freeQuerySlots.pop_back();
+            cmd.resetQueryPool(timestampPool,2*querySlot,2);
+            if(statisticsPool)
+                cmd.resetQueryPool(statisticsPool,querySlot,1);
+        }
+
+        //Earlier targets become readable, the new targets become writable, all in one barrier
+        auto isTarget = [&](Texture texture){
+            return std::any_of(handle.targetTextures.begin(),handle.targetTextures.end(),
+                [&](const ColorTarget_TV &target){return target.texture == texture;});
+        };
+        for(auto &[texture, state] : currentRecording.textureStates)
+            if(!isTarget(texture) && state.layout != restingTextureLayout)
+                requireTextureState(texture,restingTextureLayout);
+        for(auto &target : handle.targetTextures)
+            requireTextureState(target.texture,vk::ImageLayout::eColorAttachmentOptimal,target.discardContent);
+        flushBarriers();
+
+        if(handle.renderPass){
+            uint32_t frameIndex = std::min(framebufferIndex,uint32_t(handle.framebuffers.size()-1));
+            cmd.beginRenderPass({handle.renderPass,handle.framebuffers[frameIndex],{{},handle.area},
+                uint32_t(handle.clearValues.size()),handle.clearValues.data()},vk::SubpassContents::eInline);
+        }
+        else if(!handle.compute){
+            currentRecording.frameIndex = std::min(framebufferIndex,uint32_t(handle.attachmentViews.size()-1));
+            beginDynamicRendering(handle,currentRecording.frameIndex);
+        }
+        if(currentRecording.profilingPass){
+            std::ostringstream label;
+            label << "RenderPass " << TgaRenderPass(renderPass);
+            cmd.beginDebugUtilsLabelEXT({label.str().c_str()});
+            cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,timestampPool,2*querySlot);
+            //Queries can not span subpasses, statistics stay empty for multi subpass passes
+            if(statisticsPool && handle.subpasses.size() == 1)
+                cmd.beginQuery(statisticsPool,querySlot,{});
+            currentRecording.passQueries.push_back({renderPass,querySlot});
+        }
+        bindSubpass(handle,0);
+        if(!handle.compute){
+            cmd.setViewport(0,{{0,0,float(handle.area.width),float(handle.area.height),0,1}});
+            cmd.setScissor(0,{{{},handle.area}});
+        }
         currentRecording.renderPass = renderPass;
+        currentRecording.subpass = 0;
+    }
+    void TGAVulkan::nextSubpass()
+    {
+        CallTimer timer(*this,InterfaceCall::nextSubpass);
+        if(!currentRecording.renderPass)
+            throw std::runtime_error("[TGA Vulkan] nextSubpass outside of a render pass");
+        auto &handle = renderPasses[currentRecording.renderPass];
+        if(currentRecording.subpass+1 >= handle.subpasses.size())
+            throw std::runtime_error("[TGA Vulkan] Render pass has no further subpass");
+        currentRecording.cmdBuffer.nextSubpass(vk::SubpassContents::eInline);
+        bindSubpass(handle,++currentRecording.subpass);
+    }
+    void TGAVulkan::bindSubpass(const RenderPass_TV &renderPass, uint32_t subpass)
+    {
+        auto &cmd = currentRecording.cmdBuffer;
+        auto &handle = renderPass.subpasses[subpass];
+        cmd.bindPipeline(renderPass.compute?vk::PipelineBindPoint::eCompute:vk::PipelineBindPoint::eGraphics,handle.pipeline);
+        if(handle.inputAttachmentSet)
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,handle.pipelineLayout,uint32_t(handle.setLayouts.size()-1),
+                1,&handle.inputAttachmentSet,0,nullptr);
+    }
+    void TGAVulkan::finishRenderPass()
+    {
+        auto &cmd = currentRecording.cmdBuffer;
+        //Subpasses that were not reached still have to be stepped through
+        auto subpassCount = renderPasses[currentRecording.renderPass].subpasses.size();
+        for(; currentRecording.subpass+1 < subpassCount; currentRecording.subpass++)
+            cmd.nextSubpass(vk::SubpassContents::eInline);
+        if(currentRecording.profilingPass){
+            auto querySlot = currentRecording.passQueries.back().querySlot;
+            if(statisticsPool && subpassCount == 1)
+                cmd.endQuery(statisticsPool,querySlot);
+            cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,timestampPool,2*querySlot+1);
+            cmd.endDebugUtilsLabelEXT();
+            currentRecording.profilingPass = false;
+        }
+        auto &handle = renderPasses[currentRecording.renderPass];
+        if(handle.compute){
+            //Later passes read what the dispatches wrote, async compute hands its results over through a semaphore
+            vk::PipelineStageFlags dstStages = vk::PipelineStageFlagBits::eComputeShader;
+            vk::AccessFlags dstAccess = vk::AccessFlagBits::eShaderRead|vk::AccessFlagBits::eShaderWrite|vk::AccessFlagBits::eUniformRead;
+            if(!currentRecording.asyncCompute){
+                dstStages = computeResultStages;
+                dstAccess |= vk::AccessFlagBits::eIndirectCommandRead|vk::AccessFlagBits::eVertexAttributeRead|vk::AccessFlagBits::eIndexRead|
+                    vk::AccessFlagBits::eTransferRead;
+            }
+            vk::MemoryBarrier computeBarrier{vk::AccessFlagBits::eShaderWrite,dstAccess};
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,dstStages,{},{computeBarrier},{},{});
+        }
+        else if(handle.renderPass)
+            cmd.endRenderPass();
+        else
+            endDynamicRendering(handle,currentRecording.frameIndex);
+    }
+    void TGAVulkan::beginDynamicRendering(const RenderPass_TV &renderPass, uint32_t frameIndex)
+    {
+#ifdef VK_KHR_dynamic_rendering
+        //Mirrors the attachment descriptions a render pass would have been created with
+        auto &attachments = renderPass.attachments;
+        auto &views = renderPass.attachmentViews[frameIndex];
+        bool multisampled = attachments[0].samples != vk::SampleCountFlagBits::e1;
+        bool hasDepth = views.size() > (multisampled?2:1)*renderPass.colorCount;
+        uint32_t resolveBase = renderPass.colorCount+(hasDepth?1:0);
+        //Backbuffers leave ePresentSrcKHR only for the pass. As with window render passes the image is the one nextFrame returned,
+        //the acquire semaphore itself is waited on by the submission in present
+        if(!renderPass.backbuffers.empty()){
+            auto &backbuffer = attachments[multisampled?resolveBase:0];
+            currentRecording.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                {},{},{},{{{},vk::AccessFlagBits::eColorAttachmentWrite,backbuffer.initialLayout,vk::ImageLayout::eColorAttachmentOptimal,
+                VK_QUEUE_FAMILY_IGNORED,VK_QUEUE_FAMILY_IGNORED,renderPass.backbuffers[frameIndex],{vk::ImageAspectFlagBits::eColor,0,1,0,1}}});
+        }
+        //Stands in for the external subpass dependency, shared depth and multisampled attachments are written by earlier passes
+        vk::PipelineStageFlags stages = vk::PipelineStageFlagBits::eColorAttachmentOutput|vk::PipelineStageFlagBits::eEarlyFragmentTests|
+            vk::PipelineStageFlagBits::eLateFragmentTests;
+        vk::MemoryBarrier attachmentBarrier{vk::AccessFlagBits::eColorAttachmentWrite|vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+            vk::AccessFlagBits::eColorAttachmentRead|vk::AccessFlagBits::eColorAttachmentWrite|
+            vk::AccessFlagBits::eDepthStencilAttachmentRead|vk::AccessFlagBits::eDepthStencilAttachmentWrite};
+        currentRecording.cmdBuffer.pipelineBarrier(stages,stages,{},{attachmentBarrier},{},{});
+        std::vector<vk::RenderingAttachmentInfoKHR> colorAttachments{};
+        for(uint32_t i = 0; i < renderPass.colorCount; i++){
+            vk::RenderingAttachmentInfoKHR colorAttachment{views[i],vk::ImageLayout::eColorAttachmentOptimal};
+            colorAttachment.setLoadOp(attachments[i].loadOp).setStoreOp(attachments[i].storeOp).setClearValue(renderPass.clearValues[i]);
+            if(multisampled)
+                colorAttachment.setResolveMode(vk::ResolveModeFlagBits::eAverage).setResolveImageView(views[resolveBase+i])
+                    .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal);
+            colorAttachments.push_back(colorAttachment);
+        }
+        vk::RenderingAttachmentInfoKHR depthAttachment{};
+        if(hasDepth){
+            auto &depth = attachments[renderPass.colorCount];
+            depthAttachment.setImageView(views[renderPass.colorCount]).setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                .setLoadOp(depth.loadOp).setStoreOp(depth.storeOp).setClearValue(renderPass.clearValues[renderPass.colorCount]);
+        }
+        currentRecording.cmdBuffer.beginRenderingKHR({{},{{},renderPass.area},1,0,uint32_t(colorAttachments.size()),colorAttachments.data(),
+            hasDepth?&depthAttachment:nullptr});
+#else
+        (void)renderPass; (void)frameIndex; //Warning Silencer
+#endif
+    }
+    void TGAVulkan::endDynamicRendering(const RenderPass_TV &renderPass, uint32_t frameIndex)
+    {
+#ifdef VK_KHR_dynamic_rendering
+        currentRecording.cmdBuffer.endRenderingKHR();
+        if(!renderPass.backbuffers.empty())
+            currentRecording.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,vk::PipelineStageFlagBits::eBottomOfPipe,
+                {},{},{},{{vk::AccessFlagBits::eColorAttachmentWrite,{},vk::ImageLayout::eColorAttachmentOptimal,vk::ImageLayout::ePresentSrcKHR,
+                VK_QUEUE_FAMILY_IGNORED,VK_QUEUE_FAMILY_IGNORED,renderPass.backbuffers[frameIndex],{vk::ImageAspectFlagBits::eColor,0,1,0,1}}});
+#else
+        (void)renderPass; (void)frameIndex; //Warning Silencer
+#endif
     }
     CommandBuffer TGAVulkan::endCommandBuffer() 
     {
+        CallTimer timer(*this,InterfaceCall::endCommandBuffer);
         if(currentRecording.renderPass){
-            currentRecording.cmdBuffer.endRenderPass();
+            finishRenderPass();
             currentRecording.renderPass = RenderPass();
         }
+        for(auto &[texture, state] : currentRecording.textureStates)
+            if(state.layout != restingTextureLayout)
+                requireTextureState(texture,restingTextureLayout);
+        flushBarriers();
+        currentRecording.textureStates.clear();
+        std::optional<ComputeSync_TV> computeSync{};
+        if(currentRecording.asyncCompute && queueIndices.compute != queueIndices.graphics)
+            computeSync = createComputeSync(currentRecording.computeTextures);
+        currentRecording.computeTextures.clear();
         currentRecording.cmdBuffer.end();
-        CommandBuffer_TV cmdBuffer_tv{currentRecording.cmdBuffer};
+        CommandBuffer_TV cmdBuffer_tv{currentRecording.cmdBuffer,std::move(currentRecording.passQueries),currentRecording.asyncCompute,
+            currentRecording.waitsForCompute,computeSync};
         CommandBuffer handle = TgaCommandBuffer(VkCommandBuffer(currentRecording.cmdBuffer));
         commandBuffers.emplace(handle,cmdBuffer_tv);
         currentRecording.cmdBuffer = vk::CommandBuffer();
+        currentRecording.passQueries.clear();
         return handle;
     }
     void TGAVulkan::execute(CommandBuffer commandBuffer) 
     {
+        CallTimer timer(*this,InterfaceCall::execute);
         auto &handle = commandBuffers[commandBuffer];
-        graphicsQueue.submit({{0,nullptr,nullptr,1,&handle.cmdBuffer}},{});
+        countEvent(&PerformanceCounters::queueSubmissions);
+        if(handle.computeSync){
+            submitAsyncCompute(handle);
+            return;
+        }
+        if(handle.passQueries.empty()){
+            TraceSpan span(*this,"submit");
+            submitGraphics(handle.cmdBuffer,{},handle.waitsForCompute);
+            return;
+        }
+        //The queries of a command buffer are reused, results of its previous execution have to be read first
+        harvestProfiles(commandBuffer);
+        vk::Fence fence;
+        if(profileFences.empty()){
+            fence = device.createFence({});
+        }
+        else{
+            fence = profileFences.back();
+            profileFences.pop_back();
+        }
+        {
+            TraceSpan span(*this,"submit");
+            submitGraphics(handle.cmdBuffer,fence,handle.waitsForCompute);
+        }
+        pendingProfiles.push_back({fence,commandBuffer,frameCount});
     }
 
     void TGAVulkan::updateBuffer(Buffer buffer, uint8_t const *data, size_t dataSize, uint32_t offset)
     {
+        CallTimer timer(*this,InterfaceCall::updateBuffer);
         auto &handle = buffers[buffer];
         fillBuffer(dataSize,data,offset,handle.buffer);
     }
 
+    Readback TGAVulkan::readBuffer(Buffer buffer, size_t dataSize, uint32_t offset)
+    {
+        CallTimer timer(*this,InterfaceCall::readBuffer);
+        auto &handle = buffers[buffer];
+        if(dataSize == 0)
+            throw std::runtime_error("[TGA Vulkan] Buffer readback must not be empty");
+        if(uint64_t(offset)+dataSize > handle.size)
+            throw std::runtime_error("[TGA Vulkan] Buffer readback exceeds the size of the buffer");
+        auto readback = acquireReadbackSlot(dataSize);
+        readback.cmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
+        vk::MemoryBarrier writeBarrier{vk::AccessFlagBits::eTransferWrite|vk::AccessFlagBits::eShaderWrite,vk::AccessFlagBits::eTransferRead};
+        readback.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,vk::PipelineStageFlagBits::eTransfer,{},{writeBarrier},{},{});
+        vk::BufferCopy region{offset,0,dataSize};
+        readback.cmdBuffer.copyBuffer(handle.buffer,readback.buffer,{region});
+        return submitReadback(readback);
+    }
+    Readback TGAVulkan::readTexture(Texture texture)
+    {
+        CallTimer timer(*this,InterfaceCall::readTexture);
+        auto &handle = textures[texture];
+        auto readback = acquireReadbackSlot(handle.extent.width*handle.extent.height*determineFormatSize(handle.format));
+        readback.cmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
+        transitionImageLayout(readback.cmdBuffer,handle.image,restingTextureLayout,vk::ImageLayout::eTransferSrcOptimal);
+        vk::BufferImageCopy region{0,0,0,{vk::ImageAspectFlagBits::eColor,0,0,1},{0,0,0},handle.extent};
+        readback.cmdBuffer.copyImageToBuffer(handle.image,vk::ImageLayout::eTransferSrcOptimal,readback.buffer,{region});
+        transitionImageLayout(readback.cmdBuffer,handle.image,vk::ImageLayout::eTransferSrcOptimal,restingTextureLayout);
+        return submitReadback(readback);
+    }
+    bool TGAVulkan::readbackReady(Readback readback)
+    {
+        CallTimer timer(*this,InterfaceCall::readbackReady);
+        auto &handle = readbacks[readback];
+        return device.getFenceStatus(handle.fence) == vk::Result::eSuccess;
+    }
+    std::pair<uint8_t const*, size_t> TGAVulkan::readbackData(Readback readback)
+    {
+        CallTimer timer(*this,InterfaceCall::readbackData);
+        auto &handle = readbacks[readback];
+        TraceSpan span(*this,"fenceWait");
+        (void)device.waitForFences({handle.fence},VK_TRUE,std::numeric_limits<uint64_t>::max());
+        return {handle.mapping,size_t(handle.size)};
+    }
+
+    TextureProperties TGAVulkan::textureProperties(Texture texture)
+    {
+        CallTimer timer(*this,InterfaceCall::textureProperties);
+        auto &handle = textures[texture];
+        return {handle.extent.width,handle.extent.height,handle.createFormat};
+    }
+
     uint32_t TGAVulkan::backbufferCount(Window window) 
     {
-        return wsi.getWindow(window).imageViews.size();
+        CallTimer timer(*this,InterfaceCall::backbufferCount);
+        return getWSI().getWindow(window).imageViews.size();
     }
 
     uint32_t TGAVulkan::nextFrame(Window window) 
     {
-        return wsi.aquireNextImage(window);
+        CallTimer timer(*this,InterfaceCall::nextFrame);
+        return getWSI().aquireNextImage(window);
     }
     void TGAVulkan::present(Window window) 
     {
-        auto &handle = wsi.getWindow(window);
-        auto current = handle.currentFrameIndex;
-        auto cmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
-        transitionImageLayout(cmdBuffer,handle.images[current],vk::ImageLayout::eColorAttachmentOptimal,vk::ImageLayout::ePresentSrcKHR);
-        cmdBuffer.end();
-        vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-        graphicsQueue.submit({{1,&handle.imageAvailableSemaphore,waitStages,1,&cmdBuffer,1,&handle.renderFinishedSemaphore}},{});
-        wsi.presentImage(window);
-        graphicsQueue.waitIdle();
-        device.freeCommandBuffers(graphicsCmdPool,1,&cmdBuffer);
-        cmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
-        transitionImageLayout(cmdBuffer,handle.images[current],vk::ImageLayout::ePresentSrcKHR,vk::ImageLayout::eColorAttachmentOptimal);
-        endOneTimeCmdBuffer(cmdBuffer,graphicsCmdPool,graphicsQueue);
+        {
+            CallTimer timer(*this,InterfaceCall::present);
+            //Window render passes leave the backbuffer in ePresentSrcKHR, only the semaphores have to be chained
+            //The fence of the frame slot paces nextFrame, presentImage waits on it when no frames may be queued
+            auto &handle = getWSI().getWindow(window);
+            auto &fence = handle.inFlightFences[handle.frameSlot];
+            device.resetFences({fence});
+            vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
+            {
+                TraceSpan span(*this,"submit");
+                graphicsQueue.submit({{1,&handle.imageAvailableSemaphores[handle.frameSlot],waitStages,0,nullptr,
+                    1,&handle.renderFinishedSemaphores[handle.frameSlot]}},fence);
+            }
+            countEvent(&PerformanceCounters::queueSubmissions);
+            {
+                TraceSpan span(*this,"presentImage");
+                getWSI().presentImage(window);
+            }
+        }
+        endFrame();
     }
 
+    FramePacing TGAVulkan::framePacing(Window window)
+    {
+        return getWSI().framePacing(window);
+    }
     void TGAVulkan::setWindowTitel(Window window, const std::string &title)
     {
-        wsi.setWindowTitle(window,title.c_str());
+        CallTimer timer(*this,InterfaceCall::setWindowTitel);
+        getWSI().setWindowTitle(window,title.c_str());
     }
 
     bool TGAVulkan::windowShouldClose(Window window)
     {
-        return wsi.windowShouldClose(window);
+        CallTimer timer(*this,InterfaceCall::windowShouldClose);
+        return getWSI().windowShouldClose(window);
     }
 
     bool TGAVulkan::keyDown(Window window, Key key)
     {
-        return wsi.keyDown(window, key);
+        CallTimer timer(*this,InterfaceCall::keyDown);
+        return getWSI().keyDown(window, key);
     }
 
     std::pair<int, int> TGAVulkan::mousePosition(Window window)
     {
-        return wsi.mousePosition(window);
+        CallTimer timer(*this,InterfaceCall::mousePosition);
+        return getWSI().mousePosition(window);
+    }
+    void TGAVulkan::pollInput()
+    {
+        CallTimer timer(*this,InterfaceCall::pollInput);
+        getWSI().pollEvents();
+    }
+    std::vector<InputEvent> TGAVulkan::takeInputEvents(Window window)
+    {
+        CallTimer timer(*this,InterfaceCall::takeInputEvents);
+        return getWSI().takeInputEvents(window);
+    }
+    InputSnapshot TGAVulkan::inputSnapshot(Window window)
+    {
+        CallTimer timer(*this,InterfaceCall::inputSnapshot);
+        return getWSI().inputSnapshot(window);
     }
     
     void TGAVulkan::free(Shader shader) 
     {   
+        CallTimer timer(*this,InterfaceCall::free);
         auto &handle = shaders[shader];
         device.destroy(handle.module);
         shaders.erase(shader);
     }
     void TGAVulkan::free(Buffer buffer) 
     {
+        CallTimer timer(*this,InterfaceCall::free);
         auto &handle = buffers[buffer];
         device.destroy(handle.buffer);
-        device.free(handle.memory);
+        freeMemory(handle.memory);
         buffers.erase(buffer);
     }
     void TGAVulkan::free(Texture texture) 
     {
+        CallTimer timer(*this,InterfaceCall::free);
         auto &handle = textures[texture];
-        auto &depthHandle = textureDepthBuffers[texture];
-        if(depthHandle.image){
-            device.destroy(depthHandle.imageView);
-            device.destroy(depthHandle.image);
-            device.free(depthHandle.memory);
-            textureDepthBuffers.erase(texture);
-        }
         device.destroy(handle.sampler);
         device.destroy(handle.imageView);
         device.destroy(handle.image);
-        device.free(handle.memory);
+        freeMemory(handle.memory);
         textures.erase(texture);
     }
     void TGAVulkan::free(Window window) 
     {
-        auto &depthHandle = windowDepthBuffers[window];
-        if(depthHandle.image){
-            device.destroy(depthHandle.imageView);
-            device.destroy(depthHandle.image);
-            device.free(depthHandle.memory);
-            windowDepthBuffers.erase(window);
-        }
-        wsi.free(window);
+        CallTimer timer(*this,InterfaceCall::free);
+        getWSI().free(window);
     }
     void TGAVulkan::free(InputSet inputSet) 
     {
+        CallTimer timer(*this,InterfaceCall::free);
         auto &handle = inputSets[inputSet];
         device.destroy(handle.descriptorPool);
         inputSets.erase(inputSet);
     }
     void TGAVulkan::free(RenderPass renderPass) 
     {
+        CallTimer timer(*this,InterfaceCall::free);
         auto &handle = renderPasses[renderPass];
         for(auto &fb : handle.framebuffers)
             device.destroy(fb);
         device.destroy(handle.renderPass);
-        for(auto &sl : handle.setLayouts)
-            device.destroy(sl);
-        device.destroy(handle.pipeline);
-        device.destroy(handle.pipelineLayout);
+        for(auto &subpass : handle.subpasses){
+            for(auto &sl : subpass.setLayouts)
+                device.destroy(sl);
+            device.destroy(subpass.pipeline);
+            device.destroy(subpass.pipelineLayout);
+            if(subpass.inputAttachmentPool)
+                device.destroy(subpass.inputAttachmentPool);
+        }
+        for(auto &attachment : handle.intermediateAttachments){
+            device.destroy(attachment.imageView);
+            device.destroy(attachment.image);
+            freeMemory(attachment.memory);
+        }
+        for(auto &attachment : handle.multisampleAttachments){
+            device.destroy(attachment.imageView);
+            device.destroy(attachment.image);
+            freeMemory(attachment.memory);
+        }
+        if(handle.depthBuffer)
+            releaseDepthBuffer(*handle.depthBuffer);
         renderPasses.erase(renderPass);
     }
     void TGAVulkan::free(CommandBuffer commandBuffer) 
     {
+        CallTimer timer(*this,InterfaceCall::free);
         auto &handle = commandBuffers[commandBuffer];
-        device.freeCommandBuffers(graphicsCmdPool,{handle.cmdBuffer});
+        if(!handle.passQueries.empty()){
+            harvestProfiles(commandBuffer);
+            for(auto &query : handle.passQueries)
+                freeQuerySlots.push_back(query.querySlot);
+        }
+        if(handle.computeSync){
+            //Its semaphores may still be waited on, graphics takes the results over before they are destroyed
+            if(!pendingComputeWaits.empty())
+                submitGraphics({},{});
+            {
+                TraceSpan span(*this,"waitIdle");
+                graphicsQueue.waitIdle();
+            }
+            countEvent(&PerformanceCounters::waitIdles);
+            auto &sync = *handle.computeSync;
+            device.destroy(sync.graphicsReleased);
+            device.destroy(sync.computeFinished);
+            if(sync.graphicsRelease)
+                device.freeCommandBuffers(graphicsCmdPool,{sync.graphicsRelease,sync.graphicsAcquire});
+        }
+        device.freeCommandBuffers(handle.asyncCompute?computeCmdPool:graphicsCmdPool,{handle.cmdBuffer});
         commandBuffers.erase(commandBuffer); 
     }
+    void TGAVulkan::free(Readback readback)
+    {
+        CallTimer timer(*this,InterfaceCall::free);
+        auto &handle = readbacks[readback];
+        TraceSpan span(*this,"fenceWait");
+        (void)device.waitForFences({handle.fence},VK_TRUE,std::numeric_limits<uint64_t>::max());
+        device.freeCommandBuffers(graphicsCmdPool,{handle.cmdBuffer});
+        handle.cmdBuffer = vk::CommandBuffer();
+        readbackPool.push_back(handle);
+        readbacks.erase(readback);
+    }
+
+    std::vector<FrameProfile> TGAVulkan::collectProfiles()
+    {
+        harvestProfiles();
+        std::vector<FrameProfile> profiles{};
+        profiles.swap(finishedProfiles);
+        return profiles;
+    }
+
+    const PerformanceCounters& TGAVulkan::frameCounters() const
+    {
+        return lastFrameCounters;
+    }
+
+    const PerformanceCounters& TGAVulkan::totalCounters() const
+    {
+        return cumulativeCounters;
+    }
+
+    void TGAVulkan::endFrame()
+    {
+        lastFrameCounters = currentFrameCounters;
+        currentFrameCounters = PerformanceCounters{};
+        frameCount++;
+    }
+
+    TGAVulkan::CallTimer::CallTimer(TGAVulkan &_tgav, InterfaceCall _call):
+        tgav(_tgav),call(_call),start(std::chrono::steady_clock::now())
+    {}
+
+    TGAVulkan::CallTimer::~CallTimer()
+    {
+        double duration = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-start).count();
+        auto index = size_t(call);
+        tgav.currentFrameCounters.callCounts[index]++;
+        tgav.currentFrameCounters.callTimeMilli[index] += duration;
+        tgav.cumulativeCounters.callCounts[index]++;
+        tgav.cumulativeCounters.callTimeMilli[index] += duration;
+        if(tgav.vulkanInfo.tracing)
+            tgav.addTraceEvent(interfaceCallName(call),TraceTrack::cpu,tgav.traceMicro(start),duration*1000.);
+    }
+
+    TGAVulkan::TraceSpan::TraceSpan(TGAVulkan &_tgav, const char *_name):
+        tgav(_tgav),name(_name),start(_tgav.vulkanInfo.tracing?std::chrono::steady_clock::now():std::chrono::steady_clock::time_point())
+    {}
+
+    TGAVulkan::TraceSpan::~TraceSpan()
+    {
+        if(tgav.vulkanInfo.tracing){
+            double duration = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-start).count();
+            tgav.addTraceEvent(name,TraceTrack::cpu,tgav.traceMicro(start),duration);
+        }
+    }
+
+    double TGAVulkan::traceMicro(std::chrono::steady_clock::time_point time)
+    {
+        return std::chrono::duration<double,std::micro>(time-traceEpoch).count();
+    }
+
+    double TGAVulkan::gpuTicksToTraceMicro(uint64_t ticks)
+    {
+        //Sign extend the wrapped difference to the valid timestamp bits
+        uint64_t delta = (ticks-gpuCalibrationTicks)&timestampMask;
+        double signedDelta = delta > timestampMask/2?-double((timestampMask-delta)+1):double(delta);
+        return cpuCalibrationMicro+signedDelta*double(timestampPeriod)/1000.;
+    }
+
+    void TGAVulkan::addTraceEvent(std::string name, TraceTrack track, double startMicro, double durationMicro)
+    {
+        if(traceEvents.size() >= maxTraceEvents){
+            droppedTraceEvents++;
+            return;
+        }
+        traceEvents.push_back({std::move(name),track,startMicro,durationMicro});
+    }
+
+    void TGAVulkan::writeTrace(const std::string &fileName)
+    {
+        device.waitIdle();
+        countEvent(&PerformanceCounters::waitIdles);
+        harvestProfiles();
+        std::ofstream file(fileName);
+        if(!file.is_open())
+            throw std::runtime_error("Could not open trace file " + fileName);
+        file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}},\n";
+        file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"GPU graphics queue\"}}";
+        file << std::fixed << std::setprecision(3);
+        for(auto &event : traceEvents){
+            bool gpu = event.track == TraceTrack::gpu;
+            file << ",\n{\"name\": \"" << event.name << "\", \"cat\": \"" << (gpu?"gpu":"cpu") << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                << (gpu?2:1) << ", \"ts\": " << event.startMicro << ", \"dur\": " << event.durationMicro << '}';
+        }
+        file << "\n], \"otherData\": {\"calibratedTimestamps\": " << (calibratedTimestamps?"true":"false")
+            << ", \"droppedEvents\": " << droppedTraceEvents << "}}\n";
+    }
+
+    void TGAVulkan::clearTrace()
+    {
+        traceEvents.clear();
+        droppedTraceEvents = 0;
+    }
+
+    void TGAVulkan::countEvent(uint64_t PerformanceCounters::*counter, uint64_t amount)
+    {
+        currentFrameCounters.*counter += amount;
+        cumulativeCounters.*counter += amount;
+    }
+
+    const char* interfaceCallName(InterfaceCall call)
+    {
+        switch (call)
+        {
+            case InterfaceCall::createShader: return "createShader";
+            case InterfaceCall::createBuffer: return "createBuffer";
+            case InterfaceCall::createTexture: return "createTexture";
+            case InterfaceCall::createWindow: return "createWindow";
+            case InterfaceCall::createInputSet: return "createInputSet";
+            case InterfaceCall::createRenderPass: return "createRenderPass";
+            case InterfaceCall::beginCommandBuffer: return "beginCommandBuffer";
+            case InterfaceCall::setRenderPass: return "setRenderPass";
+            case InterfaceCall::nextSubpass: return "nextSubpass";
+            case InterfaceCall::bindVertexBuffer: return "bindVertexBuffer";
+            case InterfaceCall::bindIndexBuffer: return "bindIndexBuffer";
+            case InterfaceCall::bindInputSet: return "bindInputSet";
+            case InterfaceCall::draw: return "draw";
+            case InterfaceCall::drawIndexed: return "drawIndexed";
+            case InterfaceCall::dispatch: return "dispatch";
+            case InterfaceCall::endCommandBuffer: return "endCommandBuffer";
+            case InterfaceCall::execute: return "execute";
+            case InterfaceCall::updateBuffer: return "updateBuffer";
+            case InterfaceCall::readBuffer: return "readBuffer";
+            case InterfaceCall::readTexture: return "readTexture";
+            case InterfaceCall::readbackReady: return "readbackReady";
+            case InterfaceCall::readbackData: return "readbackData";
+            case InterfaceCall::textureProperties: return "textureProperties";
+            case InterfaceCall::backbufferCount: return "backbufferCount";
+            case InterfaceCall::nextFrame: return "nextFrame";
+            case InterfaceCall::present: return "present";
+            case InterfaceCall::setWindowTitel: return "setWindowTitel";
+            case InterfaceCall::windowShouldClose: return "windowShouldClose";
+            case InterfaceCall::keyDown: return "keyDown";
+            case InterfaceCall::mousePosition: return "mousePosition";
+            case InterfaceCall::pollInput: return "pollInput";
+            case InterfaceCall::takeInputEvents: return "takeInputEvents";
+            case InterfaceCall::inputSnapshot: return "inputSnapshot";
+            case InterfaceCall::free: return "free";
+            default: return "unknown";
+        }
+    }
+
+    MemoryReport TGAVulkan::memoryReport(size_t largestCount)
+    {
+        MemoryReport report{};
+        auto mProps = pDevice.getMemoryProperties();
+        report.bytesByMemoryType.resize(mProps.memoryTypeCount);
+        for(auto &entry : allocations){
+            auto &allocation = entry.second;
+            auto heapFlags = mProps.memoryHeaps[mProps.memoryTypes[allocation.memoryType].heapIndex].flags;
+            bool deviceLocal = bool(heapFlags & vk::MemoryHeapFlagBits::eDeviceLocal);
+            auto &usage = report.byKind[size_t(allocation.kind)];
+            (deviceLocal?usage.deviceBytes:usage.hostBytes) += allocation.size;
+            (deviceLocal?report.deviceBytes:report.hostBytes) += allocation.size;
+            usage.allocations++;
+            report.bytesByMemoryType[allocation.memoryType] += allocation.size;
+            report.largestAllocations.push_back({allocation.kind,allocation.size,allocation.memoryType,allocation.resource});
+        }
+        std::sort(report.largestAllocations.begin(),report.largestAllocations.end(),
+            [](const ResourceAllocation &a, const ResourceAllocation &b){return a.size > b.size;});
+        report.largestAllocations.resize(std::min(largestCount,report.largestAllocations.size()));
+        report.liveHandles = {shaders.size(),buffers.size(),textures.size(),wsi?wsi->windows.size():0,
+            inputSets.size(),renderPasses.size(),commandBuffers.size(),readbacks.size()};
+        return report;
+    }
+
+    void TGAVulkan::printMemoryReport(std::ostream &out, size_t largestCount)
+    {
+        auto report = memoryReport(largestCount);
+        auto mProps = pDevice.getMemoryProperties();
+        out << "Memory: " << report.deviceBytes << " bytes device, " << report.hostBytes << " bytes host\n";
+        for(size_t i = 0; i < report.byKind.size(); i++){
+            auto &usage = report.byKind[i];
+            if(usage.allocations == 0)
+                continue;
+            out << "  " << resourceKindName(ResourceKind(i)) << ": " << usage.allocations << " allocations, "
+                << usage.deviceBytes << " bytes device, " << usage.hostBytes << " bytes host\n";
+        }
+        for(size_t i = 0; i < report.bytesByMemoryType.size(); i++){
+            if(report.bytesByMemoryType[i] == 0)
+                continue;
+            out << "  memory type " << i << " " << vk::to_string(mProps.memoryTypes[i].propertyFlags) << ": "
+                << report.bytesByMemoryType[i] << " bytes\n";
+        }
+        out << "Largest allocations:\n";
+        for(auto &allocation : report.largestAllocations){
+            out << "  " << resourceKindName(allocation.kind) << " 0x" << std::hex << allocation.resource << std::dec
+                << ": " << allocation.size << " bytes in memory type " << allocation.memoryType << '\n';
+        }
+        auto &live = report.liveHandles;
+        out << "Live handles: " << live.shaders << " shaders, " << live.buffers << " buffers, " << live.textures << " textures, "
+            << live.windows << " windows, " << live.inputSets << " input sets, " << live.renderPasses << " render passes, "
+            << live.commandBuffers << " command buffers, " << live.readbacks << " readbacks\n";
+    }
+
+    const char* resourceKindName(ResourceKind kind)
+    {
+        switch (kind)
+        {
+            case ResourceKind::buffer: return "buffer";
+            case ResourceKind::texture: return "texture";
+            case ResourceKind::depthBuffer: return "depth buffer";
+            case ResourceKind::attachment: return "attachment";
+            case ResourceKind::staging: return "staging";
+            case ResourceKind::readback: return "readback";
+            default: return "unknown";
+        }
+    }
 
     /*Quality of life functions*/
 
     const std::vector<const char*> TGAVulkan::getInstanceExtentensions()
     {
-        auto extensions = wsi.getRequiredExtensions();
-        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        std::vector<const char*> extensions{};
+        if(wsi)
+            extensions = wsi->getRequiredExtensions();
+        //Headless machines without the Vulkan SDK may lack debug utils, debug output is skipped there like validation
+        if(instanceExtensionSupported(VK_EXT_DEBUG_UTILS_EXTENSION_NAME))
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         return extensions;
     }
     const std::vector<const char*> TGAVulkan::getDeviceExtentensions()
     {
-        std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        std::vector<const char*> deviceExtensions{};
+        if(wsi)
+            deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        if(vulkanInfo.tracing && deviceExtensionSupported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME))
+            deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+#ifdef VK_KHR_dynamic_rendering
+        if(dynamicRendering){
+            deviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+            //Dependencies of the extension that Vulkan 1.1 does not have in core
+            deviceExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+            deviceExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        }
+#endif
         return deviceExtensions;
     }
+    bool TGAVulkan::supportsDynamicRendering()
+    {
+#ifdef VK_KHR_dynamic_rendering
+        if(!deviceExtensionSupported(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+            return false;
+        auto features = pDevice.getFeatures2<vk::PhysicalDeviceFeatures2,vk::PhysicalDeviceDynamicRenderingFeaturesKHR>();
+        return features.get<vk::PhysicalDeviceDynamicRenderingFeaturesKHR>().dynamicRendering;
+#else
+        return false;
+#endif
+    }
+    bool TGAVulkan::instanceExtensionSupported(const char *extension)
+    {
+        for(auto &properties : vk::enumerateInstanceExtensionProperties())
+            if(std::strcmp(properties.extensionName,extension) == 0)
+                return true;
+        return false;
+    }
+    bool TGAVulkan::deviceExtensionSupported(const char *extension)
+    {
+        for(auto &properties : pDevice.enumerateDeviceExtensionProperties())
+            if(std::strcmp(properties.extensionName,extension) == 0)
+                return true;
+        return false;
+    }
     const std::vector<const char*> TGAVulkan::getLayers()
     {
-        const std::vector<const char*> layers = {"VK_LAYER_KHRONOS_validation"};
+        std::vector<const char*> layers{};
+        if(!vulkanInfo.validation)
+            return layers;
+        const char *validationLayer = "VK_LAYER_KHRONOS_validation";
+        for(auto &properties : vk::enumerateInstanceLayerProperties())
+            if(std::strcmp(properties.layerName,validationLayer) == 0){
+                layers.push_back(validationLayer);
+                return layers;
+            }
+        static bool warned = false;
+        if(!warned)
+            std::cerr << "[TGA VULKAN]: " << validationLayer << " is not installed, running without validation\n";
+        warned = true;
         return layers;
     }
     vk::PhysicalDeviceFeatures TGAVulkan::getDeviceFeatures()
     {
-        vk::PhysicalDeviceFeatures features;
+        vk::PhysicalDeviceFeatures features = vulkanInfo.features;
+        if(vulkanInfo.profiling)
+            features.pipelineStatisticsQuery = VK_TRUE;
+        //The feature struct is nothing but VkBool32 members, so requested and supported features are combined member by member
+        auto supported = pDevice.getFeatures();
+        auto requestedBits = reinterpret_cast<VkBool32*>(&features);
+        auto supportedBits = reinterpret_cast<const VkBool32*>(&supported);
+        uint32_t unsupported = 0;
+        for(size_t i = 0; i < sizeof(features)/sizeof(VkBool32); i++){
+            if(requestedBits[i] && !supportedBits[i])
+                unsupported++;
+            requestedBits[i] = requestedBits[i] && supportedBits[i];
+        }
+        if(unsupported > 0)
+            std::cerr << "[TGA VULKAN]: " << unsupported << " requested device features are not supported and stay disabled\n";
         return features;
     }
 
-    uint32_t TGAVulkan::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+    uint32_t TGAVulkan::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties, vk::MemoryPropertyFlags preferredProperties)
     {
         auto mProps = pDevice.getMemoryProperties();
-        for (uint32_t i = 0; i < mProps.memoryTypeCount; i++) {
-            if ((typeFilter & (1 << i))&& ((mProps.memoryTypes[i].propertyFlags & properties) == properties))
-                return i;
+        for (auto wantedProperties : {properties|preferredProperties, properties}){
+            for (uint32_t i = 0; i < mProps.memoryTypeCount; i++) {
+                if ((typeFilter & (1 << i))&& ((mProps.memoryTypes[i].propertyFlags & wantedProperties) == wantedProperties))
+                    return i;
+            }
         }
         throw std::runtime_error("Memory Type could not be found");
     }
 
-    Buffer_TV TGAVulkan::allocateBuffer(vk::DeviceSize size,vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
+    vk::DeviceMemory TGAVulkan::allocateMemory(const vk::MemoryRequirements &requirements, vk::MemoryPropertyFlags properties, ResourceKind kind,
+        uint64_t resource, vk::MemoryPropertyFlags preferredProperties)
     {
-        vk::SharingMode sharingMode = queueIndices.graphics == queueIndices.transfer?vk::SharingMode::eExclusive:vk::SharingMode::eConcurrent;
-        std::array<uint32_t,2> queues{queueIndices.graphics,queueIndices.transfer};
-        uint32_t queueCount = queueIndices.graphics == queueIndices.transfer?1:2;
-        vk::Buffer buffer = device.createBuffer( { { }, size, usage, sharingMode,queueCount,queues.data()});
+        uint32_t memoryType = findMemoryType(requirements.memoryTypeBits,properties,preferredProperties);
+        vk::DeviceMemory memory = device.allocateMemory({requirements.size,memoryType});
+        allocations.emplace(VkDeviceMemory(memory),Allocation_TV{kind,requirements.size,memoryType,resource});
+        return memory;
+    }
+
+    void TGAVulkan::freeMemory(vk::DeviceMemory memory)
+    {
+        allocations.erase(VkDeviceMemory(memory));
+        device.free(memory);
+    }
+
+    Buffer_TV TGAVulkan::allocateBuffer(vk::DeviceSize size,vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, ResourceKind kind,
+        vk::MemoryPropertyFlags preferredProperties)
+    {
+        //Shared by every queue family in use, so buffers need no ownership transfers
+        std::vector<uint32_t> queues{queueIndices.graphics};
+        for(auto family : {queueIndices.transfer,queueIndices.compute})
+            if(std::find(queues.begin(),queues.end(),family) == queues.end())
+                queues.push_back(family);
+        vk::SharingMode sharingMode = queues.size() == 1?vk::SharingMode::eExclusive:vk::SharingMode::eConcurrent;
+        vk::Buffer buffer = device.createBuffer( { { }, size, usage, sharingMode,uint32_t(queues.size()),queues.data()});
         auto mr = device.getBufferMemoryRequirements(buffer);
-        vk::DeviceMemory memory = device.allocateMemory({ mr.size, findMemoryType(mr.memoryTypeBits, properties)});
+        vk::DeviceMemory memory = allocateMemory(mr,properties,kind,reinterpret_cast<uint64_t>(VkBuffer(buffer)),preferredProperties);
         device.bindBufferMemory(buffer, memory, 0);
-        return {buffer,memory};
+        return {buffer,memory,size};
     }
 
     vk::Format TGAVulkan::findDepthFormat()
@@ -494,45 +1373,219 @@ namespace tga
         throw std::runtime_error("Required Depth Format not present on this system");
     }
 
-    DepthBuffer_TV TGAVulkan::createDepthBuffer(uint32_t width, uint32_t height)
+    DepthBuffer_TV TGAVulkan::createDepthBuffer(uint32_t width, uint32_t height, vk::Format format, vk::SampleCountFlagBits samples, bool transient)
+    {
+        //Transient depth never leaves the tile memory on GPUs that offer lazily allocated memory
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+        if(transient)
+            usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+        vk::Image image = device.createImage({{},vk::ImageType::e2D,format,{width,height,1},
+            1,1,samples,vk::ImageTiling::eOptimal,usage,vk::SharingMode::eExclusive});
+        auto mr = device.getImageMemoryRequirements(image);
+        vk::DeviceMemory memory = allocateMemory(mr,vk::MemoryPropertyFlagBits::eDeviceLocal,ResourceKind::depthBuffer,reinterpret_cast<uint64_t>(VkImage(image)),
+            transient?vk::MemoryPropertyFlagBits::eLazilyAllocated:vk::MemoryPropertyFlags());
+        device.bindImageMemory(image,memory,0);
+        vk::ImageView view = device.createImageView({{},image,vk::ImageViewType::e2D,format,{},{vk::ImageAspectFlagBits::eDepth,0,1,0,1}});
+        auto transitionCmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
+        transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eUndefined,vk::ImageLayout::eDepthStencilAttachmentOptimal,format);
+        endOneTimeCmdBuffer(transitionCmdBuffer,graphicsCmdPool,graphicsQueue);
+        return{image,view,memory,0};
+    }
+
+    std::optional<DepthKey_TV> TGAVulkan::acquireDepthBuffer(uint64_t owner, vk::Extent2D extent, vk::Format format, vk::SampleCountFlagBits samples,
+        const DepthConfig &depthConfig)
+    {
+        if(format == vk::Format::eUndefined)
+            return std::nullopt;
+        bool transient = depthConfig.loadOperation != LoadOperation::load && depthConfig.storeOperation == StoreOperation::discard;
+        DepthKey_TV key{transient?0:owner,extent.width,extent.height,format,samples};
+        auto it = depthBuffers.find(key);
+        if(it == depthBuffers.end())
+            it = depthBuffers.emplace(key,createDepthBuffer(extent.width,extent.height,format,samples,transient)).first;
+        it->second.users++;
+        return key;
+    }
+
+    void TGAVulkan::releaseDepthBuffer(const DepthKey_TV &key)
     {
-        static vk::Format depthFormat = findDepthFormat();
-        vk::Image image = device.createImage({{},vk::ImageType::e2D,depthFormat,{width,height,1},
-            1,1,vk::SampleCountFlagBits::e1,vk::ImageTiling::eOptimal,
-            vk::ImageUsageFlagBits::eDepthStencilAttachment,vk::SharingMode::eExclusive});
+        auto it = depthBuffers.find(key);
+        if(it == depthBuffers.end() || --it->second.users > 0)
+            return;
+        device.destroy(it->second.imageView);
+        device.destroy(it->second.image);
+        freeMemory(it->second.memory);
+        depthBuffers.erase(it);
+    }
+
+    Attachment_TV TGAVulkan::createIntermediateAttachment(vk::Extent2D extent, vk::Format format, vk::SampleCountFlagBits samples)
+    {
+        vk::Image image = device.createImage({{},vk::ImageType::e2D,format,{extent.width,extent.height,1},
+            1,1,samples,vk::ImageTiling::eOptimal,
+            vk::ImageUsageFlagBits::eColorAttachment|vk::ImageUsageFlagBits::eInputAttachment|vk::ImageUsageFlagBits::eTransientAttachment,
+            vk::SharingMode::eExclusive});
+        auto mr = device.getImageMemoryRequirements(image);
+        vk::DeviceMemory memory = allocateMemory(mr,vk::MemoryPropertyFlagBits::eDeviceLocal,ResourceKind::attachment,reinterpret_cast<uint64_t>(VkImage(image)),
+            vk::MemoryPropertyFlagBits::eLazilyAllocated);
+        device.bindImageMemory(image,memory,0);
+        vk::ImageView view = device.createImageView({{},image,vk::ImageViewType::e2D,format,{},{vk::ImageAspectFlagBits::eColor,0,1,0,1}});
+        return {image,view,memory};
+    }
+
+    Attachment_TV TGAVulkan::createMultisampleAttachment(vk::Extent2D extent, vk::Format format, vk::SampleCountFlagBits samples)
+    {
+        //Multisampled content never outlives its pass, only the resolved targets do
+        vk::Image image = device.createImage({{},vk::ImageType::e2D,format,{extent.width,extent.height,1},
+            1,1,samples,vk::ImageTiling::eOptimal,vk::ImageUsageFlagBits::eColorAttachment|vk::ImageUsageFlagBits::eTransientAttachment,
+            vk::SharingMode::eExclusive});
         auto mr = device.getImageMemoryRequirements(image);
-        vk::DeviceMemory memory = device.allocateMemory({mr.size, findMemoryType(mr.memoryTypeBits,vk::MemoryPropertyFlagBits::eDeviceLocal)});
+        vk::DeviceMemory memory = allocateMemory(mr,vk::MemoryPropertyFlagBits::eDeviceLocal,ResourceKind::attachment,reinterpret_cast<uint64_t>(VkImage(image)),
+            vk::MemoryPropertyFlagBits::eLazilyAllocated);
         device.bindImageMemory(image,memory,0);
-        vk::ImageView view = device.createImageView({{},image,vk::ImageViewType::e2D,depthFormat,{},{vk::ImageAspectFlagBits::eDepth,0,1,0,1}});
+        vk::ImageView view = device.createImageView({{},image,vk::ImageViewType::e2D,format,{},{vk::ImageAspectFlagBits::eColor,0,1,0,1}});
+        //The attachment stays in eColorAttachmentOptimal for its whole lifetime
         auto transitionCmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
-        transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eUndefined,vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        transitionImageLayout(transitionCmdBuffer,image,vk::ImageLayout::eUndefined,vk::ImageLayout::eColorAttachmentOptimal);
         endOneTimeCmdBuffer(transitionCmdBuffer,graphicsCmdPool,graphicsQueue);
-        return{image,view,memory};
+        return {image,view,memory};
     }
 
-    vk::RenderPass TGAVulkan::makeRenderPass(vk::Format colorFormat,ClearOperation clearOps, vk::ImageLayout layout)
+    std::vector<vk::AttachmentDescription> TGAVulkan::makeAttachments(const RenderPassInfo &renderPassInfo, const std::vector<vk::Format> &colorFormats,
+        vk::ImageLayout initialLayout, vk::ImageLayout finalLayout, vk::Format depthFormat, const std::vector<vk::Format> &intermediateFormats,
+        vk::SampleCountFlagBits samples)
     {
+        auto clearOps = renderPassInfo.clearOperations;
+        auto &depthConfig = renderPassInfo.depthConfig;
         auto colorLoadOp = vk::AttachmentLoadOp::eLoad;
-        auto depthLoadOp = vk::AttachmentLoadOp::eLoad;
-        if(clearOps==ClearOperation::all||clearOps==ClearOperation::color)
+        auto depthLoadOp = determineLoadOp(depthConfig.loadOperation);
+        bool clearsColor = clearOps==ClearOperation::all||clearOps==ClearOperation::color;
+        if(clearsColor)
             colorLoadOp = vk::AttachmentLoadOp::eClear;
         if(clearOps==ClearOperation::all||clearOps==ClearOperation::depth)
             depthLoadOp = vk::AttachmentLoadOp::eClear;
-        std::vector<vk::AttachmentDescription> attachments{
-        {{},colorFormat,vk::SampleCountFlagBits::e1,colorLoadOp, vk::AttachmentStoreOp::eStore,
-            vk::AttachmentLoadOp::eDontCare,vk::AttachmentStoreOp::eDontCare,layout,layout},
-        {{},findDepthFormat(),vk::SampleCountFlagBits::e1,depthLoadOp, vk::AttachmentStoreOp::eStore,
-          vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
-          vk::ImageLayout::eDepthStencilAttachmentOptimal,vk::ImageLayout::eDepthStencilAttachmentOptimal}
+        bool hasDepth = depthFormat != vk::Format::eUndefined;
+        bool multisampled = samples != vk::SampleCountFlagBits::e1;
+        std::vector<vk::AttachmentDescription> targets{
+        {{},colorFormats[0],vk::SampleCountFlagBits::e1,colorLoadOp, vk::AttachmentStoreOp::eStore,
+            vk::AttachmentLoadOp::eDontCare,vk::AttachmentStoreOp::eDontCare,initialLayout,finalLayout}
         };
-        vk::AttachmentReference colorAttachmentRef{0, vk::ImageLayout::eColorAttachmentOptimal};
-        vk::AttachmentReference depthAttachmentRef{1, vk::ImageLayout::eDepthStencilAttachmentOptimal};
-        vk::SubpassDescription subpass{{},vk::PipelineBindPoint::eGraphics,0,0,1,&colorAttachmentRef,0,&depthAttachmentRef};
+        for(uint32_t i = 1; i < colorFormats.size(); i++){
+            auto &colorTarget = renderPassInfo.additionalTargets[i-1];
+            auto loadOp = clearsColor?vk::AttachmentLoadOp::eClear:determineLoadOp(colorTarget.loadOperation);
+            targets.emplace_back(vk::AttachmentDescriptionFlags(),colorFormats[i],vk::SampleCountFlagBits::e1,loadOp,
+                determineStoreOp(colorTarget.storeOperation),vk::AttachmentLoadOp::eDontCare,vk::AttachmentStoreOp::eDontCare,
+                vk::ImageLayout::eColorAttachmentOptimal,vk::ImageLayout::eColorAttachmentOptimal);
+        }
+        //Multisampled passes draw into attachments of their own in place of the targets, the targets become resolve attachments after depth.
+        //Their content is discarded once it is resolved
+        std::vector<vk::AttachmentDescription> attachments = targets;
+        if(multisampled){
+            for(auto &attachment : attachments){
+                attachment.samples = samples;
+                attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+                attachment.initialLayout = vk::ImageLayout::eColorAttachmentOptimal;
+                attachment.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+            }
+            for(auto &target : targets)
+                target.loadOp = vk::AttachmentLoadOp::eDontCare;
+        }
+        //Intermediate attachments never leave the render pass
+        for(auto format : intermediateFormats)
+            attachments.emplace_back(vk::AttachmentDescriptionFlags(),format,samples,
+                colorLoadOp == vk::AttachmentLoadOp::eClear?vk::AttachmentLoadOp::eClear:vk::AttachmentLoadOp::eDontCare,
+                vk::AttachmentStoreOp::eDontCare,vk::AttachmentLoadOp::eDontCare,vk::AttachmentStoreOp::eDontCare,
+                vk::ImageLayout::eUndefined,vk::ImageLayout::eColorAttachmentOptimal);
+        if(hasDepth)
+            attachments.emplace_back(vk::AttachmentDescriptionFlags(),depthFormat,samples,depthLoadOp,
+                determineStoreOp(depthConfig.storeOperation),vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
+                vk::ImageLayout::eDepthStencilAttachmentOptimal,vk::ImageLayout::eDepthStencilAttachmentOptimal);
+        if(multisampled)
+            attachments.insert(attachments.end(),targets.begin(),targets.end());
+        return attachments;
+    }
+
+    void TGAVulkan::validateSubpasses(const std::vector<SubpassInfo> &subpasses, uint32_t colorCount, uint32_t intermediateCount)
+    {
+        uint32_t firstIntermediate = colorCount;
+        uint32_t depthAttachment = colorCount+intermediateCount;
+        for(auto &subpass : subpasses){
+            for(auto attachment : subpass.colorAttachments)
+                if(attachment >= depthAttachment)
+                    throw std::runtime_error("[TGA Vulkan] Subpass writes an attachment the render pass does not have");
+            for(auto attachment : subpass.inputAttachments){
+                if(attachment < firstIntermediate || attachment >= depthAttachment)
+                    throw std::runtime_error("[TGA Vulkan] Only intermediate attachments can be read as input attachments");
+                if(std::count(subpass.colorAttachments.begin(),subpass.colorAttachments.end(),attachment))
+                    throw std::runtime_error("[TGA Vulkan] Subpass reads an attachment it writes");
+            }
+        }
+    }
+
+    vk::RenderPass TGAVulkan::makeRenderPass(const std::vector<vk::AttachmentDescription> &attachments, uint32_t colorCount, uint32_t intermediateCount,
+        bool hasDepth, const std::vector<SubpassInfo> &subpasses)
+    {
+        bool multisampled = attachments[0].samples != vk::SampleCountFlagBits::e1;
+        uint32_t firstIntermediate = colorCount;
+        uint32_t depthAttachment = colorCount+intermediateCount;
+        uint32_t firstResolve = depthAttachment+(hasDepth?1:0);
+
+        //References have to outlive the descriptions that point to them
+        std::vector<std::vector<vk::AttachmentReference>> colorRefs(subpasses.size());
+        std::vector<std::vector<vk::AttachmentReference>> inputRefs(subpasses.size());
+        std::vector<std::vector<vk::AttachmentReference>> resolveRefs(subpasses.size());
+        std::vector<std::vector<uint32_t>> preserveRefs(subpasses.size());
+        vk::AttachmentReference depthAttachmentRef{depthAttachment, vk::ImageLayout::eDepthStencilAttachmentOptimal};
+        std::vector<vk::SubpassDescription> subpassDescriptions{};
+        auto uses = [&](uint32_t subpass, uint32_t attachment){
+            auto &info = subpasses[subpass];
+            return std::count(info.colorAttachments.begin(),info.colorAttachments.end(),attachment) > 0
+                || std::count(info.inputAttachments.begin(),info.inputAttachments.end(),attachment) > 0;
+        };
+        for(uint32_t s = 0; s < subpasses.size(); s++){
+            for(auto attachment : subpasses[s].colorAttachments)
+                colorRefs[s].emplace_back(attachment,vk::ImageLayout::eColorAttachmentOptimal);
+            //A target is resolved once, at the end of the last subpass that writes it
+            bool resolves = false;
+            for(auto attachment : subpasses[s].colorAttachments){
+                bool lastWrite = multisampled && attachment < firstIntermediate;
+                for(uint32_t other = s+1; other < subpasses.size() && lastWrite; other++)
+                    lastWrite = !std::count(subpasses[other].colorAttachments.begin(),subpasses[other].colorAttachments.end(),attachment);
+                resolveRefs[s].emplace_back(lastWrite?firstResolve+attachment:VK_ATTACHMENT_UNUSED,vk::ImageLayout::eColorAttachmentOptimal);
+                resolves = resolves || lastWrite;
+            }
+            for(auto attachment : subpasses[s].inputAttachments)
+                inputRefs[s].emplace_back(attachment,vk::ImageLayout::eShaderReadOnlyOptimal);
+            //Content written before and read after this subpass has to survive it
+            for(uint32_t attachment = 0; attachment < depthAttachment; attachment++){
+                bool before = false, after = false;
+                for(uint32_t other = 0; other < s; other++)
+                    before = before || uses(other,attachment);
+                for(uint32_t other = s+1; other < subpasses.size(); other++)
+                    after = after || uses(other,attachment);
+                if(before && after && !uses(s,attachment))
+                    preserveRefs[s].push_back(attachment);
+            }
+            subpassDescriptions.emplace_back(vk::SubpassDescriptionFlags(),vk::PipelineBindPoint::eGraphics,
+                uint32_t(inputRefs[s].size()),inputRefs[s].data(),uint32_t(colorRefs[s].size()),colorRefs[s].data(),
+                resolves?resolveRefs[s].data():nullptr,
+                hasDepth?&depthAttachmentRef:nullptr,uint32_t(preserveRefs[s].size()),preserveRefs[s].data());
+        }
         
+        //Shared depth buffers are written by passes of other targets, so earlier depth writes have to finish first
         vk::PipelineStageFlags pipelineStageFlags = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        vk::SubpassDependency subDependency{VK_SUBPASS_EXTERNAL,0,pipelineStageFlags,pipelineStageFlags,{},
-            vk::AccessFlagBits::eColorAttachmentRead|vk::AccessFlagBits::eColorAttachmentWrite};
-        return device.createRenderPass({{},uint32_t(attachments.size()),attachments.data(),1,&subpass,1,&subDependency});
+        vk::AccessFlags srcAccess = vk::AccessFlagBits::eColorAttachmentWrite;
+        vk::AccessFlags dstAccess = vk::AccessFlagBits::eColorAttachmentRead|vk::AccessFlagBits::eColorAttachmentWrite;
+        if(hasDepth){
+            pipelineStageFlags |= vk::PipelineStageFlagBits::eEarlyFragmentTests|vk::PipelineStageFlagBits::eLateFragmentTests;
+            srcAccess |= vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+            dstAccess |= vk::AccessFlagBits::eDepthStencilAttachmentRead|vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        }
+        std::vector<vk::SubpassDependency> dependencies{{VK_SUBPASS_EXTERNAL,0,pipelineStageFlags,pipelineStageFlags,srcAccess,dstAccess}};
+        //Each subpass waits for the attachment writes of the one before, per pixel so tilers can stay on chip
+        for(uint32_t s = 1; s < subpasses.size(); s++)
+            dependencies.emplace_back(s-1,s,pipelineStageFlags,pipelineStageFlags|vk::PipelineStageFlagBits::eFragmentShader,srcAccess,
+                dstAccess|vk::AccessFlagBits::eInputAttachmentRead,vk::DependencyFlagBits::eByRegion);
+        return device.createRenderPass({{},uint32_t(attachments.size()),attachments.data(),uint32_t(subpassDescriptions.size()),subpassDescriptions.data(),
+            uint32_t(dependencies.size()),dependencies.data()});
     }
 
     std::vector<vk::DescriptorSetLayout> TGAVulkan::decodeInputLayout(const InputLayout &inputLayout)
@@ -550,17 +1603,53 @@ namespace tga
         return descSetLayouts;
     }
 
-    vk::Pipeline TGAVulkan::makeGraphicsPipeline(const RenderPassInfo &renderPassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass)
+    Subpass_TV TGAVulkan::makeSubpass(const SubpassInfo &subpassInfo, uint32_t subpass, vk::SampleCountFlagBits samples, vk::RenderPass renderPass,
+        const std::vector<ColorTarget> &additionalTargets, const std::vector<Attachment_TV> &intermediateAttachments, const void *pNext)
+    {
+        Subpass_TV subpass_tv{};
+        subpass_tv.setLayouts = decodeInputLayout(subpassInfo.inputLayout);
+        for(auto &setLayout : subpassInfo.inputLayout.setLayouts){
+            std::vector<vk::DescriptorType> types{};
+            for(auto &bindingLayout : setLayout.bindingLayouts)
+                types.push_back(determineDescriptorType(bindingLayout.type));
+            subpass_tv.descriptorTypes.push_back(types);
+        }
+        auto inputCount = uint32_t(subpassInfo.inputAttachments.size());
+        if(inputCount > 0){
+            std::vector<vk::DescriptorSetLayoutBinding> bindings{};
+            for(uint32_t i = 0; i < inputCount; i++)
+                bindings.emplace_back(i,vk::DescriptorType::eInputAttachment,1,vk::ShaderStageFlagBits::eFragment);
+            subpass_tv.setLayouts.push_back(device.createDescriptorSetLayout({{},uint32_t(bindings.size()),bindings.data()}));
+        }
+        subpass_tv.pipelineLayout = device.createPipelineLayout({{},uint32_t(subpass_tv.setLayouts.size()),subpass_tv.setLayouts.data()});
+        subpass_tv.pipeline = makePipeline(subpassInfo,subpass_tv.pipelineLayout,renderPass,subpass,samples,additionalTargets,pNext);
+        if(inputCount > 0){
+            vk::DescriptorPoolSize poolSize{vk::DescriptorType::eInputAttachment,inputCount};
+            subpass_tv.inputAttachmentPool = device.createDescriptorPool({{},1,1,&poolSize});
+            countEvent(&PerformanceCounters::descriptorPoolsCreated);
+            subpass_tv.inputAttachmentSet = device.allocateDescriptorSets({subpass_tv.inputAttachmentPool,1,&subpass_tv.setLayouts.back()})[0];
+            for(uint32_t i = 0; i < inputCount; i++){
+                vk::DescriptorImageInfo imageInfo{{},intermediateAttachments[subpassInfo.inputAttachments[i]-1-additionalTargets.size()].imageView,
+                    vk::ImageLayout::eShaderReadOnlyOptimal};
+                vk::WriteDescriptorSet writeSet{subpass_tv.inputAttachmentSet,i,0,1,vk::DescriptorType::eInputAttachment,&imageInfo};
+                device.updateDescriptorSets({writeSet},{});
+            }
+        }
+        return subpass_tv;
+    }
+
+    vk::Pipeline TGAVulkan::makeGraphicsPipeline(const SubpassInfo &subpassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass, uint32_t subpass,
+        vk::SampleCountFlagBits samples, const std::vector<ColorTarget> &additionalTargets, const void *pNext)
     {
         std::vector<vk::PipelineShaderStageCreateInfo> shaderStages{};
-        for(auto &stage: renderPassInfo.shaderStages)
+        for(auto &stage: subpassInfo.shaderStages)
         {
             auto &shader = shaders[stage];
             shaderStages.emplace_back(vk::PipelineShaderStageCreateInfo({},determineShaderStage(shader.type),shader.module,"main"));
         }
-        vk::VertexInputBindingDescription vertexBinding{0,uint32_t(renderPassInfo.vertexLayout.vertexSize),vk::VertexInputRate::eVertex};
-        uint32_t bindingCount = ((renderPassInfo.vertexLayout.vertexSize>0)?1:0);
-        auto vertexAttributes = determineVertexAttributes(renderPassInfo.vertexLayout.vertexAttributes);
+        vk::VertexInputBindingDescription vertexBinding{0,uint32_t(subpassInfo.vertexLayout.vertexSize),vk::VertexInputRate::eVertex};
+        uint32_t bindingCount = ((subpassInfo.vertexLayout.vertexSize>0)?1:0);
+        auto vertexAttributes = determineVertexAttributes(subpassInfo.vertexLayout.vertexAttributes);
         vk::PipelineVertexInputStateCreateInfo vertexInputInfo{{},bindingCount,&vertexBinding,uint32_t(vertexAttributes.size()),vertexAttributes.data()};
 
         vk::PipelineInputAssemblyStateCreateInfo inputAssembly{{},vk::PrimitiveTopology::eTriangleList,VK_FALSE};
@@ -569,28 +1658,43 @@ namespace tga
         vk::PipelineDynamicStateCreateInfo dynamicState{{},dynamicStates.size(),dynamicStates.data()};
         vk::Viewport viewport{0,0,1,1,0,1}; vk::Rect2D scissor{{0,0},{1,1}};
         vk::PipelineViewportStateCreateInfo viewportState{{},1,&viewport,1,&scissor};
-        auto rasterizer = determineRasterizerState(renderPassInfo.rasterizerConfig);
-        vk::PipelineMultisampleStateCreateInfo multisampling{};
-        vk::Bool32 depthTest = (renderPassInfo.rasterizerConfig.depthCompareOp != CompareOperation::ignore)?VK_TRUE:VK_FALSE;
-        auto compOp = determineDepthCompareOp(renderPassInfo.rasterizerConfig.depthCompareOp);
+        auto rasterizer = determineRasterizerState(subpassInfo.rasterizerConfig);
+        vk::PipelineMultisampleStateCreateInfo multisampling{{},samples};
+        vk::Bool32 depthTest = (subpassInfo.rasterizerConfig.depthCompareOp != CompareOperation::ignore)?VK_TRUE:VK_FALSE;
+        auto compOp = determineDepthCompareOp(subpassInfo.rasterizerConfig.depthCompareOp);
         vk::PipelineDepthStencilStateCreateInfo depthStencil{{},depthTest,depthTest,compOp};
         
-        auto colorBlendAttachment = determineColorBlending(renderPassInfo.rasterizerConfig);
-        vk::PipelineColorBlendStateCreateInfo colorBlending{{},VK_FALSE,vk::LogicOp::eCopy,1,&colorBlendAttachment,{0,0,0,0} };
+        //Additional targets carry their own blend state, the render target and intermediates use the rasterizer config
+        std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachments{};
+        for(auto attachment : subpassInfo.colorAttachments){
+            if(attachment >= 1 && attachment <= additionalTargets.size()){
+                auto &colorTarget = additionalTargets[attachment-1];
+                colorBlendAttachments.push_back(determineColorBlending(colorTarget.blendEnabled,colorTarget.srcBlend,colorTarget.dstBlend));
+            }
+            else
+                colorBlendAttachments.push_back(determineColorBlending(subpassInfo.rasterizerConfig));
+        }
+        countEvent(&PerformanceCounters::pipelinesCreated);
+        vk::PipelineColorBlendStateCreateInfo colorBlending{{},VK_FALSE,vk::LogicOp::eCopy,uint32_t(colorBlendAttachments.size()),
+            colorBlendAttachments.data(),{0,0,0,0} };
        
-        return device.createGraphicsPipeline({},{{},uint32_t(shaderStages.size()),shaderStages.data(),&vertexInputInfo,&inputAssembly,
-            nullptr,&viewportState,&rasterizer,&multisampling,&depthStencil,&colorBlending,&dynamicState,pipelineLayout,renderPass});
+        vk::GraphicsPipelineCreateInfo pipelineInfo{{},uint32_t(shaderStages.size()),shaderStages.data(),&vertexInputInfo,&inputAssembly,
+            nullptr,&viewportState,&rasterizer,&multisampling,&depthStencil,&colorBlending,&dynamicState,pipelineLayout,renderPass,subpass};
+        pipelineInfo.pNext = pNext;
+        return device.createGraphicsPipeline({},pipelineInfo);
     }
-    vk::Pipeline TGAVulkan::makePipeline(const RenderPassInfo &renderPassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass)
+    vk::Pipeline TGAVulkan::makePipeline(const SubpassInfo &subpassInfo,vk::PipelineLayout pipelineLayout, vk::RenderPass renderPass, uint32_t subpass,
+        vk::SampleCountFlagBits samples, const std::vector<ColorTarget> &additionalTargets, const void *pNext)
     {
-        bool isValid = renderPassInfo.shaderStages.size()>0;
+        bool isValid = subpassInfo.shaderStages.size()>0;
         bool vertexPresent{false};
         bool fragmentPresent{false};
-        for(auto stage: renderPassInfo.shaderStages)
+        for(auto stage: subpassInfo.shaderStages)
         {
             const auto& shader = shaders[stage];
             if(shader.type == ShaderType::compute){
-                if(renderPassInfo.shaderStages.size()==1){
+                if(subpassInfo.shaderStages.size()==1){
+                    countEvent(&PerformanceCounters::pipelinesCreated);
                     return device.createComputePipeline({},{{},{{},vk::ShaderStageFlagBits::eCompute,shader.module,"main"},pipelineLayout});
                 }
                 else{
@@ -613,25 +1717,150 @@ namespace tga
         }
         if(!isValid)
             throw std::runtime_error("Invalid Shader Stage Configuration");
-        return makeGraphicsPipeline(renderPassInfo,pipelineLayout,renderPass);
+        return makeGraphicsPipeline(subpassInfo,pipelineLayout,renderPass,subpass,samples,additionalTargets,pNext);
     }
 
     vk::CommandBuffer TGAVulkan::beginOneTimeCmdBuffer(vk::CommandPool &cmdPool)
     {
         vk::CommandBuffer cmdBuffer = device.allocateCommandBuffers({cmdPool,vk::CommandBufferLevel::ePrimary,1})[0];
         cmdBuffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        countEvent(&PerformanceCounters::oneTimeCommandBuffers);
         return cmdBuffer;
     }
     void TGAVulkan::endOneTimeCmdBuffer(vk::CommandBuffer &cmdBuffer,vk::CommandPool &cmdPool, vk::Queue &submitQueue)
     {
         cmdBuffer.end();
-        submitQueue.submit({{0,nullptr,nullptr,1,&cmdBuffer}},{});
-        submitQueue.waitIdle();
+        {
+            TraceSpan span(*this,"submit");
+            if(&submitQueue == &graphicsQueue)
+                submitGraphics(cmdBuffer,{});
+            else
+                submitQueue.submit({{0,nullptr,nullptr,1,&cmdBuffer}},{});
+        }
+        {
+            TraceSpan span(*this,"waitIdle");
+            submitQueue.waitIdle();
+        }
+        countEvent(&PerformanceCounters::queueSubmissions);
+        countEvent(&PerformanceCounters::waitIdles);
         device.freeCommandBuffers(cmdPool,1,&cmdBuffer);
     }
 
+    void TGAVulkan::createProfilingResources()
+    {
+        auto queueFamilies = pDevice.getQueueFamilyProperties();
+        uint32_t validBits = queueFamilies[queueIndices.graphics].timestampValidBits;
+        if(validBits == 0){
+            std::cerr << "[TGA VULKAN]: Graphics queue does not support timestamps, profiling disabled\n";
+            return;
+        }
+        timestampMask = validBits >= 64?~uint64_t(0):(uint64_t(1)<<validBits)-1;
+        timestampPeriod = pDevice.getProperties().limits.timestampPeriod;
+        //The last query is reserved for calibrating against the CPU clock
+        timestampPool = device.createQueryPool({{},vk::QueryType::eTimestamp,2*maxProfiledPasses+1});
+        if(vulkanInfo.profiling && pDevice.getFeatures().pipelineStatisticsQuery){
+            statisticsPool = device.createQueryPool({{},vk::QueryType::ePipelineStatistics,maxProfiledPasses,
+                vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations|vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations});
+        }
+        for(uint32_t i = maxProfiledPasses; i > 0; i--)
+            freeQuerySlots.push_back(i-1);
+        loadDebugLabelFunctions(instance);
+        if(vulkanInfo.tracing){
+            if(deviceExtensionSupported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)){
+                loadCalibrationFunctions(instance,device);
+                uint32_t domainCount = 0;
+                vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(VkPhysicalDevice(pDevice),&domainCount,nullptr);
+                std::vector<VkTimeDomainEXT> domains(domainCount);
+                vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(VkPhysicalDevice(pDevice),&domainCount,domains.data());
+                //steady_clock is CLOCK_MONOTONIC on Linux, other platforms use the fallback
+                calibratedTimestamps = std::count(domains.begin(),domains.end(),VK_TIME_DOMAIN_DEVICE_EXT) > 0
+                    && std::count(domains.begin(),domains.end(),VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) > 0;
+            }
+            calibrateTimestamps();
+        }
+    }
+
+    void TGAVulkan::calibrateTimestamps()
+    {
+        lastCalibration = std::chrono::steady_clock::now();
+        if(calibratedTimestamps){
+            std::array<VkCalibratedTimestampInfoEXT,2> infos{{
+                {VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,nullptr,VK_TIME_DOMAIN_DEVICE_EXT},
+                {VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,nullptr,VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT}}};
+            std::array<uint64_t,2> timestamps{};
+            uint64_t maxDeviation = 0;
+            if(vkGetCalibratedTimestampsEXT(VkDevice(device),uint32_t(infos.size()),infos.data(),timestamps.data(),&maxDeviation) == VK_SUCCESS){
+                gpuCalibrationTicks = timestamps[0];
+                cpuCalibrationMicro = traceMicro(std::chrono::steady_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(timestamps[1]))));
+                return;
+            }
+            calibratedTimestamps = false;
+        }
+        //Fallback: a timestamp written by an otherwise idle queue is taken to lie halfway between submit and completion
+        uint32_t calibrationQuery = 2*maxProfiledPasses;
+        auto cmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
+        cmdBuffer.resetQueryPool(timestampPool,calibrationQuery,1);
+        cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,timestampPool,calibrationQuery);
+        cmdBuffer.end();
+        graphicsQueue.waitIdle();
+        auto submitTime = std::chrono::steady_clock::now();
+        graphicsQueue.submit({{0,nullptr,nullptr,1,&cmdBuffer}},{});
+        graphicsQueue.waitIdle();
+        auto completionTime = std::chrono::steady_clock::now();
+        countEvent(&PerformanceCounters::queueSubmissions);
+        countEvent(&PerformanceCounters::waitIdles,2);
+        device.freeCommandBuffers(graphicsCmdPool,1,&cmdBuffer);
+        uint64_t ticks = 0;
+        (void)device.getQueryPoolResults(timestampPool,calibrationQuery,1,sizeof(ticks),&ticks,sizeof(uint64_t),
+            vk::QueryResultFlagBits::e64|vk::QueryResultFlagBits::eWait);
+        gpuCalibrationTicks = ticks;
+        cpuCalibrationMicro = (traceMicro(submitTime)+traceMicro(completionTime))/2.;
+    }
+
+    void TGAVulkan::harvestProfiles(CommandBuffer waitFor)
+    {
+        if(calibratedTimestamps && std::chrono::steady_clock::now()-lastCalibration > std::chrono::seconds(1))
+            calibrateTimestamps();
+        for(auto it = pendingProfiles.begin(); it != pendingProfiles.end();){
+            if(it->commandBuffer == waitFor){
+                TraceSpan span(*this,"fenceWait");
+                (void)device.waitForFences({it->fence},VK_TRUE,std::numeric_limits<uint64_t>::max());
+            }
+            if(device.getFenceStatus(it->fence) != vk::Result::eSuccess){
+                it++;
+                continue;
+            }
+            auto &cmdBuffer = commandBuffers[it->commandBuffer];
+            FrameProfile profile{it->frame,it->commandBuffer,{}};
+            for(auto &query : cmdBuffer.passQueries){
+                std::array<uint64_t,2> timestamps{};
+                (void)device.getQueryPoolResults(timestampPool,2*query.querySlot,2,sizeof(timestamps),timestamps.data(),
+                    sizeof(uint64_t),vk::QueryResultFlagBits::e64);
+                std::array<uint64_t,2> statistics{};
+                if(statisticsPool)
+                    (void)device.getQueryPoolResults(statisticsPool,query.querySlot,1,sizeof(statistics),statistics.data(),
+                        sizeof(statistics),vk::QueryResultFlagBits::e64);
+                double gpuTime = double((timestamps[1]-timestamps[0])&timestampMask)*double(timestampPeriod)/1e6;
+                profile.passes.push_back({query.renderPass,gpuTime,statistics[0],statistics[1]});
+                if(vulkanInfo.tracing){
+                    std::ostringstream name;
+                    name << "RenderPass " << TgaRenderPass(query.renderPass);
+                    addTraceEvent(name.str(),TraceTrack::gpu,gpuTicksToTraceMicro(timestamps[0]),gpuTime*1000.);
+                }
+            }
+            finishedProfiles.push_back(std::move(profile));
+            if(finishedProfiles.size() > maxFinishedProfiles)
+                finishedProfiles.erase(finishedProfiles.begin());
+            device.resetFences({it->fence});
+            profileFences.push_back(it->fence);
+            it = pendingProfiles.erase(it);
+        }
+    }
+
     void TGAVulkan::fillBuffer(size_t size,const uint8_t *data,uint32_t offset,vk::Buffer target)
     {
+        countEvent(&PerformanceCounters::bytesUploaded,size);
         auto copyCmdBuffer = beginOneTimeCmdBuffer(transferCmdPool);
         if(size <= 65536 && (size%4)==0) //Quick Path
         {
@@ -641,7 +1870,7 @@ namespace tga
         else //Staging Buffer
         {
             auto buffer = allocateBuffer(size,vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+            vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent,ResourceKind::staging);
             auto mapping = device.mapMemory(buffer.memory,0,size,{});
             std::memcpy(mapping,data,size);
             device.unmapMemory(buffer.memory);
@@ -649,18 +1878,20 @@ namespace tga
             copyCmdBuffer.copyBuffer(buffer.buffer,target,{region});
             endOneTimeCmdBuffer(copyCmdBuffer,transferCmdPool,transferQueue);
             device.destroy(buffer.buffer);
-            device.free(buffer.memory);
+            freeMemory(buffer.memory);
         }
         
     }
 
-    void TGAVulkan::transitionImageLayout(vk::CommandBuffer cmdBuffer,vk::Image image,vk::ImageLayout oldLayout,vk::ImageLayout newLayout)
+    void TGAVulkan::transitionImageLayout(vk::CommandBuffer cmdBuffer,vk::Image image,vk::ImageLayout oldLayout,vk::ImageLayout newLayout,
+        vk::Format depthFormat)
     {
         vk::ImageAspectFlags imageAspects{};
         if(newLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal
             ||newLayout == vk::ImageLayout::eDepthAttachmentOptimal
             ||newLayout == vk::ImageLayout::eStencilAttachmentOptimal){
-                auto depthFormat = findDepthFormat();
+                if(depthFormat == vk::Format::eUndefined)
+                    depthFormat = findDepthFormat();
                 imageAspects = vk::ImageAspectFlagBits::eDepth;
                 if((depthFormat == vk::Format::eD32SfloatS8Uint)||(depthFormat == vk::Format::eD24UnormS8Uint))
                     imageAspects |= vk::ImageAspectFlagBits::eStencil;
@@ -680,10 +1911,46 @@ namespace tga
             {imageAspects,0,1,0,1}}});
     }
 
+    ImageState_TV TGAVulkan::layoutState(vk::ImageLayout layout)
+    {
+        return {layout,layoutToAccessFlags(layout),layoutToPipelineStageFlags(layout)};
+    }
+
+    void TGAVulkan::requireTextureState(Texture texture, vk::ImageLayout layout, bool discardContent)
+    {
+        const vk::AccessFlags writeAccess = vk::AccessFlagBits::eShaderWrite|vk::AccessFlagBits::eColorAttachmentWrite|
+            vk::AccessFlagBits::eDepthStencilAttachmentWrite|vk::AccessFlagBits::eTransferWrite|
+            vk::AccessFlagBits::eHostWrite|vk::AccessFlagBits::eMemoryWrite;
+        auto it = currentRecording.textureStates.find(texture);
+        auto current = it != currentRecording.textureStates.end()?it->second:layoutState(restingTextureLayout);
+        auto target = layoutState(layout);
+        //Read after read in the same layout needs no barrier
+        if(current.layout == layout && !(current.access & writeAccess) && !(target.access & writeAccess))
+            return;
+        auto &handle = textures[texture];
+        currentRecording.barriers.push_back({current.access & writeAccess,target.access,
+            discardContent?vk::ImageLayout::eUndefined:current.layout,layout,
+            VK_QUEUE_FAMILY_IGNORED,VK_QUEUE_FAMILY_IGNORED,handle.image,{vk::ImageAspectFlagBits::eColor,0,1,0,1}});
+        currentRecording.barrierSrcStages |= current.stages;
+        currentRecording.barrierDstStages |= target.stages;
+        currentRecording.textureStates[texture] = target;
+    }
+
+    void TGAVulkan::flushBarriers()
+    {
+        auto &recording = currentRecording;
+        if(!recording.barriers.empty())
+            recording.cmdBuffer.pipelineBarrier(recording.barrierSrcStages,recording.barrierDstStages,{},{},{},recording.barriers);
+        recording.barriers.clear();
+        recording.barrierSrcStages = vk::PipelineStageFlags();
+        recording.barrierDstStages = vk::PipelineStageFlags();
+    }
+
     void TGAVulkan::fillTexture(size_t size,const uint8_t *data, uint32_t width, uint32_t height, vk::Image target)
     {
+        countEvent(&PerformanceCounters::bytesUploaded,size);
         auto buffer = allocateBuffer(size,vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent);
+            vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent,ResourceKind::staging);
         auto mapping = device.mapMemory(buffer.memory,0,size,{});
         std::memcpy(mapping,data,size);
         device.unmapMemory(buffer.memory);
@@ -692,7 +1959,219 @@ namespace tga
         uploadCmd.copyBufferToImage(buffer.buffer,target,vk::ImageLayout::eTransferDstOptimal,{region}); 
         endOneTimeCmdBuffer(uploadCmd,graphicsCmdPool,graphicsQueue);
         device.destroy(buffer.buffer);
-        device.free(buffer.memory);
+        freeMemory(buffer.memory);
+    }
+
+    Readback_TV TGAVulkan::acquireReadbackSlot(vk::DeviceSize size)
+    {
+        auto best = readbackPool.end();
+        for(auto it = readbackPool.begin(); it != readbackPool.end(); it++){
+            if(it->capacity >= size && (best == readbackPool.end() || it->capacity < best->capacity))
+                best = it;
+        }
+        if(best != readbackPool.end()){
+            Readback_TV readback = *best;
+            readbackPool.erase(best);
+            device.resetFences({readback.fence});
+            readback.size = size;
+            return readback;
+        }
+        //Persistently mapped, cached memory is preferred since the host reads from it
+        auto buffer = allocateBuffer(size,vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent,ResourceKind::readback,vk::MemoryPropertyFlagBits::eHostCached);
+        auto mapping = static_cast<uint8_t*>(device.mapMemory(buffer.memory,0,size,{}));
+        return {buffer.buffer,buffer.memory,mapping,size,size,device.createFence({}),vk::CommandBuffer()};
+    }
+
+    Readback TGAVulkan::submitReadback(Readback_TV &readback)
+    {
+        vk::MemoryBarrier hostBarrier{vk::AccessFlagBits::eTransferWrite,vk::AccessFlagBits::eHostRead};
+        readback.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,vk::PipelineStageFlagBits::eHost,{},{hostBarrier},{},{});
+        readback.cmdBuffer.end();
+        {
+            TraceSpan span(*this,"submit");
+            submitGraphics(readback.cmdBuffer,readback.fence);
+        }
+        countEvent(&PerformanceCounters::queueSubmissions);
+        Readback handle = Readback(TgaReadback(VkFence(readback.fence)));
+        readbacks.emplace(handle,readback);
+        return handle;
+    }
+
+    StagingRegion TGAVulkan::acquireStaging(size_t size)
+    {
+        recycleStaging();
+        auto best = stagingPool.end();
+        for(auto it = stagingPool.begin(); it != stagingPool.end(); it++){
+            if(it->capacity >= size && (best == stagingPool.end() || it->capacity < best->capacity))
+                best = it;
+        }
+        Staging_TV staging{};
+        if(best != stagingPool.end()){
+            staging = *best;
+            stagingPool.erase(best);
+        }
+        else{
+            auto buffer = allocateBuffer(std::max<vk::DeviceSize>(size,1),vk::BufferUsageFlagBits::eTransferSrc,
+                vk::MemoryPropertyFlagBits::eHostVisible|vk::MemoryPropertyFlagBits::eHostCoherent,ResourceKind::staging);
+            auto mapping = static_cast<uint8_t*>(device.mapMemory(buffer.memory,0,VK_WHOLE_SIZE,{}));
+            staging = {buffer.buffer,buffer.memory,mapping,std::max<vk::DeviceSize>(size,1),device.createFence({}),vk::CommandBuffer()};
+        }
+        uint64_t id = nextStagingId++;
+        stagingRegions.emplace(id,staging);
+        return {staging.mapping,size,id};
+    }
+
+    void TGAVulkan::uploadStaging(const StagingRegion &region, Buffer buffer, uint32_t offset)
+    {
+        auto &handle = buffers[buffer];
+        checkStaging(region);
+        if(uint64_t(offset)+region.size > handle.size)
+            throw std::runtime_error("[TGA Vulkan] Staging upload exceeds the size of the buffer");
+        auto staging = takeStaging(region);
+        staging.cmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
+        staging.cmdBuffer.copyBuffer(staging.buffer,handle.buffer,{vk::BufferCopy{0,offset,region.size}});
+        submitStaging(staging,region.size);
+    }
+
+    void TGAVulkan::uploadStaging(const StagingRegion &region, Texture texture)
+    {
+        auto &handle = textures[texture];
+        if(region.size < handle.extent.width*handle.extent.height*determineFormatSize(handle.format))
+            throw std::runtime_error("[TGA Vulkan] Staging region is smaller than the texture");
+        checkStaging(region);
+        auto staging = takeStaging(region);
+        staging.cmdBuffer = beginOneTimeCmdBuffer(graphicsCmdPool);
+        transitionImageLayout(staging.cmdBuffer,handle.image,restingTextureLayout,vk::ImageLayout::eTransferDstOptimal);
+        vk::BufferImageCopy copy{0,0,0,{vk::ImageAspectFlagBits::eColor,0,0,1},{0,0,0},handle.extent};
+        staging.cmdBuffer.copyBufferToImage(staging.buffer,handle.image,vk::ImageLayout::eTransferDstOptimal,{copy});
+        transitionImageLayout(staging.cmdBuffer,handle.image,vk::ImageLayout::eTransferDstOptimal,restingTextureLayout);
+        submitStaging(staging,region.size);
+    }
+
+    void TGAVulkan::releaseStaging(const StagingRegion &region)
+    {
+        stagingPool.push_back(takeStaging(region));
+    }
+
+    //Validates before anything is recorded, so a rejected region stays owned by the caller
+    void TGAVulkan::checkStaging(const StagingRegion &region)
+    {
+        auto it = stagingRegions.find(region.id);
+        if(it == stagingRegions.end())
+            throw std::runtime_error("[TGA Vulkan] Staging region was already handed over");
+        if(region.size > it->second.capacity)
+            throw std::runtime_error("[TGA Vulkan] Staging region is larger than its allocation");
+    }
+
+    Staging_TV TGAVulkan::takeStaging(const StagingRegion &region)
+    {
+        checkStaging(region);
+        auto it = stagingRegions.find(region.id);
+        auto staging = it->second;
+        stagingRegions.erase(it);
+        return staging;
+    }
+
+    void TGAVulkan::submitStaging(Staging_TV &staging, size_t size)
+    {
+        //Uploads go through the graphics queue, so executions submitted afterwards see the data
+        vk::MemoryBarrier uploadBarrier{vk::AccessFlagBits::eTransferWrite,vk::AccessFlagBits::eMemoryRead};
+        staging.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,vk::PipelineStageFlagBits::eAllCommands,{},{uploadBarrier},{},{});
+        staging.cmdBuffer.end();
+        {
+            TraceSpan span(*this,"submit");
+            submitGraphics(staging.cmdBuffer,staging.fence,false);
+        }
+        countEvent(&PerformanceCounters::queueSubmissions);
+        countEvent(&PerformanceCounters::bytesUploaded,size);
+        stagingInFlight.push_back(staging);
+    }
+
+    void TGAVulkan::recycleStaging()
+    {
+        for(auto it = stagingInFlight.begin(); it != stagingInFlight.end();){
+            if(device.getFenceStatus(it->fence) != vk::Result::eSuccess){
+                it++;
+                continue;
+            }
+            device.resetFences({it->fence});
+            device.freeCommandBuffers(graphicsCmdPool,{it->cmdBuffer});
+            it->cmdBuffer = vk::CommandBuffer();
+            stagingPool.push_back(*it);
+            it = stagingInFlight.erase(it);
+        }
+    }
+
+    void TGAVulkan::submitGraphics(vk::CommandBuffer cmdBuffer, vk::Fence fence, bool waitForCompute, vk::Semaphore signal)
+    {
+        std::vector<vk::Semaphore> waitSemaphores{};
+        std::vector<vk::PipelineStageFlags> waitStages{};
+        std::vector<vk::CommandBuffer> cmdBuffers{};
+        if(waitForCompute){
+            for(auto &wait : pendingComputeWaits){
+                waitSemaphores.push_back(wait.semaphore);
+                waitStages.push_back(computeResultStages);
+                if(wait.acquire)
+                    cmdBuffers.push_back(wait.acquire);
+            }
+            pendingComputeWaits.clear();
+        }
+        if(cmdBuffer)
+            cmdBuffers.push_back(cmdBuffer);
+        graphicsQueue.submit({{uint32_t(waitSemaphores.size()),waitSemaphores.data(),waitStages.data(),
+            uint32_t(cmdBuffers.size()),cmdBuffers.data(),signal?1u:0u,&signal}},fence);
+    }
+
+    void TGAVulkan::submitAsyncCompute(const CommandBuffer_TV &commandBuffer)
+    {
+        auto &sync = *commandBuffer.computeSync;
+        //The compute work starts after the graphics work submitted before it, later graphics work overlaps with it.
+        //Unconsumed results of earlier async compute are taken over first, their semaphores may be signaled again
+        {
+            TraceSpan span(*this,"submit");
+            submitGraphics(sync.graphicsRelease,{},true,sync.graphicsReleased);
+            vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eComputeShader;
+            computeQueue.submit({{1,&sync.graphicsReleased,&waitStage,1,&commandBuffer.cmdBuffer,1,&sync.computeFinished}},{});
+        }
+        countEvent(&PerformanceCounters::queueSubmissions);
+        pendingComputeWaits.push_back({sync.computeFinished,sync.graphicsAcquire});
+    }
+
+    vk::ImageMemoryBarrier TGAVulkan::ownershipTransfer(Texture texture, uint32_t srcFamily, uint32_t dstFamily, vk::AccessFlags dstAccess)
+    {
+        //Writes were made available when the texture returned to its resting layout
+        return {{},dstAccess,restingTextureLayout,restingTextureLayout,srcFamily,dstFamily,textures[texture].image,
+            {vk::ImageAspectFlagBits::eColor,0,1,0,1}};
+    }
+
+    ComputeSync_TV TGAVulkan::createComputeSync(const std::vector<Texture> &sampledTextures)
+    {
+        ComputeSync_TV sync{device.createSemaphore({}),device.createSemaphore({}),vk::CommandBuffer(),vk::CommandBuffer()};
+        if(sampledTextures.empty())
+            return sync;
+        std::vector<vk::ImageMemoryBarrier> computeReleases{};
+        std::vector<vk::ImageMemoryBarrier> graphicsReleases{};
+        std::vector<vk::ImageMemoryBarrier> graphicsAcquires{};
+        for(auto &texture : sampledTextures){
+            computeReleases.push_back(ownershipTransfer(texture,queueIndices.compute,queueIndices.graphics,{}));
+            graphicsReleases.push_back(ownershipTransfer(texture,queueIndices.graphics,queueIndices.compute,{}));
+            graphicsAcquires.push_back(ownershipTransfer(texture,queueIndices.compute,queueIndices.graphics,vk::AccessFlagBits::eShaderRead));
+        }
+        currentRecording.cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,vk::PipelineStageFlagBits::eBottomOfPipe,
+            {},{},{},computeReleases);
+        auto cmdBuffers = device.allocateCommandBuffers({graphicsCmdPool,vk::CommandBufferLevel::ePrimary,2});
+        sync.graphicsRelease = cmdBuffers[0];
+        sync.graphicsRelease.begin({vk::CommandBufferUsageFlagBits::eSimultaneousUse});
+        sync.graphicsRelease.pipelineBarrier(layoutToPipelineStageFlags(restingTextureLayout),vk::PipelineStageFlagBits::eBottomOfPipe,
+            {},{},{},graphicsReleases);
+        sync.graphicsRelease.end();
+        //Chained to the semaphore wait of the submission it is prepended to
+        sync.graphicsAcquire = cmdBuffers[1];
+        sync.graphicsAcquire.begin({vk::CommandBufferUsageFlagBits::eSimultaneousUse});
+        sync.graphicsAcquire.pipelineBarrier(computeResultStages,layoutToPipelineStageFlags(restingTextureLayout),{},{},{},graphicsAcquires);
+        sync.graphicsAcquire.end();
+        return sync;
     }
 
 
@@ -700,7 +2179,7 @@ namespace tga
     {
         if(usage == BufferUsage::undefined)
             throw std::runtime_error("Buffer usage is undefined!");
-        vk::BufferUsageFlags usageFlags = vk::BufferUsageFlagBits::eTransferDst;
+        vk::BufferUsageFlags usageFlags = vk::BufferUsageFlagBits::eTransferDst|vk::BufferUsageFlagBits::eTransferSrc;
         if(usage & tga::BufferUsage::uniform){
             usageFlags |= vk::BufferUsageFlagBits::eUniformBuffer;
         }
@@ -710,6 +2189,9 @@ namespace tga
         if(usage & tga::BufferUsage::index){
             usageFlags |= vk::BufferUsageFlagBits::eIndexBuffer;
         }
+        if(usage & tga::BufferUsage::storage){
+            usageFlags |= vk::BufferUsageFlagBits::eStorageBuffer;
+        }
         return usageFlags;
     }
 
@@ -721,7 +2203,7 @@ namespace tga
             case Format::r8_sint: return vk::Format::eR8Sint;
             case Format::r8_srgb: return vk::Format::eR8Srgb;
             case Format::r8_unorm: return vk::Format::eR8Unorm;
-            case Format::r8_snorm: return vk::Format::eR8G8Snorm;
+            case Format::r8_snorm: return vk::Format::eR8Snorm;
             case Format::r8g8_uint: return vk::Format::eR8G8Uint;
             case Format::r8g8_sint: return vk::Format::eR8G8Sint;
             case Format::r8g8_srgb: return vk::Format::eR8G8Srgb;
@@ -737,6 +2219,26 @@ namespace tga
             case Format::r8g8b8a8_srgb: return vk::Format::eR8G8B8A8Srgb;
             case Format::r8g8b8a8_unorm: return vk::Format::eR8G8B8A8Unorm;
             case Format::r8g8b8a8_snorm: return vk::Format::eR8G8B8A8Snorm;
+            case Format::r16_uint: return vk::Format::eR16Uint;
+            case Format::r16_sint: return vk::Format::eR16Sint;
+            case Format::r16_unorm: return vk::Format::eR16Unorm;
+            case Format::r16_snorm: return vk::Format::eR16Snorm;
+            case Format::r16_sfloat: return vk::Format::eR16Sfloat;
+            case Format::r16g16_uint: return vk::Format::eR16G16Uint;
+            case Format::r16g16_sint: return vk::Format::eR16G16Sint;
+            case Format::r16g16_unorm: return vk::Format::eR16G16Unorm;
+            case Format::r16g16_snorm: return vk::Format::eR16G16Snorm;
+            case Format::r16g16_sfloat: return vk::Format::eR16G16Sfloat;
+            case Format::r16g16b16_uint: return vk::Format::eR16G16B16Uint;
+            case Format::r16g16b16_sint: return vk::Format::eR16G16B16Sint;
+            case Format::r16g16b16_unorm: return vk::Format::eR16G16B16Unorm;
+            case Format::r16g16b16_snorm: return vk::Format::eR16G16B16Snorm;
+            case Format::r16g16b16_sfloat: return vk::Format::eR16G16B16Sfloat;
+            case Format::r16g16b16a16_uint: return vk::Format::eR16G16B16A16Uint;
+            case Format::r16g16b16a16_sint: return vk::Format::eR16G16B16A16Sint;
+            case Format::r16g16b16a16_unorm: return vk::Format::eR16G16B16A16Unorm;
+            case Format::r16g16b16a16_snorm: return vk::Format::eR16G16B16A16Snorm;
+            case Format::r16g16b16a16_sfloat: return vk::Format::eR16G16B16A16Sfloat;
             case Format::r32_uint: return vk::Format::eR32Uint;
             case Format::r32_sint: return vk::Format::eR32Sint;
             case Format::r32_sfloat: return vk::Format::eR32Sfloat;
@@ -749,10 +2251,80 @@ namespace tga
             case Format::r32g32b32a32_uint: return vk::Format::eR32G32B32A32Uint;
             case Format::r32g32b32a32_sint: return vk::Format::eR32G32B32A32Sint;
             case Format::r32g32b32a32_sfloat: return vk::Format::eR32G32B32A32Sfloat;
+            case Format::a2b10g10r10_uint_pack32: return vk::Format::eA2B10G10R10UintPack32;
+            case Format::a2b10g10r10_unorm_pack32: return vk::Format::eA2B10G10R10UnormPack32;
+            case Format::a2b10g10r10_snorm_pack32: return vk::Format::eA2B10G10R10SnormPack32;
+            case Format::b10g11r11_ufloat_pack32: return vk::Format::eB10G11R11UfloatPack32;
             default: return vk::Format::eUndefined;
         }
     }
 
+    vk::DeviceSize TGAVulkan::determineFormatSize(vk::Format format)
+    {
+        switch (format)
+        {
+            case vk::Format::eR8Uint: return 1;
+            case vk::Format::eR8Sint: return 1;
+            case vk::Format::eR8Srgb: return 1;
+            case vk::Format::eR8Unorm: return 1;
+            case vk::Format::eR8Snorm: return 1;
+            case vk::Format::eR8G8Uint: return 2;
+            case vk::Format::eR8G8Sint: return 2;
+            case vk::Format::eR8G8Srgb: return 2;
+            case vk::Format::eR8G8Unorm: return 2;
+            case vk::Format::eR8G8Snorm: return 2;
+            case vk::Format::eR8G8B8Uint: return 3;
+            case vk::Format::eR8G8B8Sint: return 3;
+            case vk::Format::eR8G8B8Srgb: return 3;
+            case vk::Format::eR8G8B8Unorm: return 3;
+            case vk::Format::eR8G8B8Snorm: return 3;
+            case vk::Format::eR8G8B8A8Uint: return 4;
+            case vk::Format::eR8G8B8A8Sint: return 4;
+            case vk::Format::eR8G8B8A8Srgb: return 4;
+            case vk::Format::eR8G8B8A8Unorm: return 4;
+            case vk::Format::eR8G8B8A8Snorm: return 4;
+            case vk::Format::eB8G8R8A8Srgb: return 4;
+            case vk::Format::eB8G8R8A8Unorm: return 4;
+            case vk::Format::eR16Uint: return 2;
+            case vk::Format::eR16Sint: return 2;
+            case vk::Format::eR16Unorm: return 2;
+            case vk::Format::eR16Snorm: return 2;
+            case vk::Format::eR16Sfloat: return 2;
+            case vk::Format::eR16G16Uint: return 4;
+            case vk::Format::eR16G16Sint: return 4;
+            case vk::Format::eR16G16Unorm: return 4;
+            case vk::Format::eR16G16Snorm: return 4;
+            case vk::Format::eR16G16Sfloat: return 4;
+            case vk::Format::eR16G16B16Uint: return 6;
+            case vk::Format::eR16G16B16Sint: return 6;
+            case vk::Format::eR16G16B16Unorm: return 6;
+            case vk::Format::eR16G16B16Snorm: return 6;
+            case vk::Format::eR16G16B16Sfloat: return 6;
+            case vk::Format::eR16G16B16A16Uint: return 8;
+            case vk::Format::eR16G16B16A16Sint: return 8;
+            case vk::Format::eR16G16B16A16Unorm: return 8;
+            case vk::Format::eR16G16B16A16Snorm: return 8;
+            case vk::Format::eR16G16B16A16Sfloat: return 8;
+            case vk::Format::eR32Uint: return 4;
+            case vk::Format::eR32Sint: return 4;
+            case vk::Format::eR32Sfloat: return 4;
+            case vk::Format::eR32G32Uint: return 8;
+            case vk::Format::eR32G32Sint: return 8;
+            case vk::Format::eR32G32Sfloat: return 8;
+            case vk::Format::eR32G32B32Uint: return 12;
+            case vk::Format::eR32G32B32Sint: return 12;
+            case vk::Format::eR32G32B32Sfloat: return 12;
+            case vk::Format::eR32G32B32A32Uint: return 16;
+            case vk::Format::eR32G32B32A32Sint: return 16;
+            case vk::Format::eR32G32B32A32Sfloat: return 16;
+            case vk::Format::eA2B10G10R10UintPack32: return 4;
+            case vk::Format::eA2B10G10R10UnormPack32: return 4;
+            case vk::Format::eA2B10G10R10SnormPack32: return 4;
+            case vk::Format::eB10G11R11UfloatPack32: return 4;
+            default: throw std::runtime_error("Format size is unknown");
+        }
+    }
+
     std::tuple<vk::Filter, vk::SamplerAddressMode> TGAVulkan::determineSamplerInfo(const TextureInfo &textureInfo)
     {
         auto filter = vk::Filter::eNearest;
@@ -834,6 +2406,74 @@ namespace tga
         }
    }
 
+   vk::Format TGAVulkan::determineDepthFormat(DepthFormat depthFormat, bool depthTested)
+   {
+        auto supported = [&](vk::Format format){
+            auto props = pDevice.getFormatProperties(format);
+            return bool(props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+        };
+        switch (depthFormat)
+        {
+            case DepthFormat::none: return vk::Format::eUndefined;
+            case DepthFormat::d16: return vk::Format::eD16Unorm;
+            case DepthFormat::d32:
+                if(supported(vk::Format::eD32Sfloat))
+                    return vk::Format::eD32Sfloat;
+                if(supported(vk::Format::eD32SfloatS8Uint))
+                    return vk::Format::eD32SfloatS8Uint;
+                throw std::runtime_error("[TGA Vulkan] D32 depth is not supported on this system");
+            default:
+                if(!depthTested)
+                    return vk::Format::eUndefined;
+                return findDepthFormat();
+        }
+   }
+
+   vk::PhysicalDeviceType TGAVulkan::determineDeviceType(DeviceType deviceType)
+   {
+        switch (deviceType)
+        {
+            case DeviceType::discrete: return vk::PhysicalDeviceType::eDiscreteGpu;
+            case DeviceType::integrated: return vk::PhysicalDeviceType::eIntegratedGpu;
+            case DeviceType::virtualGpu: return vk::PhysicalDeviceType::eVirtualGpu;
+            case DeviceType::cpu: return vk::PhysicalDeviceType::eCpu;
+            default: return vk::PhysicalDeviceType::eOther;
+        }
+   }
+
+   vk::SampleCountFlagBits TGAVulkan::determineSampleCount(SampleCount sampleCount, bool hasDepth)
+   {
+        auto limits = pDevice.getProperties().limits;
+        vk::SampleCountFlags supported = limits.framebufferColorSampleCounts;
+        if(hasDepth)
+            supported &= limits.framebufferDepthSampleCounts;
+        std::array<vk::SampleCountFlagBits,4> counts{vk::SampleCountFlagBits::e1,vk::SampleCountFlagBits::e2,
+            vk::SampleCountFlagBits::e4,vk::SampleCountFlagBits::e8};
+        for(auto i = int(sampleCount); i > 0; i--)
+            if(supported & counts[i])
+                return counts[i];
+        return vk::SampleCountFlagBits::e1;
+   }
+
+   vk::AttachmentLoadOp TGAVulkan::determineLoadOp(LoadOperation loadOperation)
+   {
+        switch (loadOperation)
+        {
+            case LoadOperation::clear: return vk::AttachmentLoadOp::eClear;
+            case LoadOperation::discard: return vk::AttachmentLoadOp::eDontCare;
+            default: return vk::AttachmentLoadOp::eLoad;
+        }
+   }
+
+   vk::AttachmentStoreOp TGAVulkan::determineStoreOp(StoreOperation storeOperation)
+   {
+        switch (storeOperation)
+        {
+            case StoreOperation::discard: return vk::AttachmentStoreOp::eDontCare;
+            default: return vk::AttachmentStoreOp::eStore;
+        }
+   }
+
    vk::BlendFactor TGAVulkan::determineBlendFactor(BlendFactor blendFactor)
    {
         switch (blendFactor)
@@ -850,9 +2490,14 @@ namespace tga
 
    vk::PipelineColorBlendAttachmentState TGAVulkan::determineColorBlending(const RasterizerConfig &config)
    {
-        vk::Bool32 enabled = config.blendEnabled?VK_TRUE:VK_FALSE;
-        vk::BlendFactor srcBlendFac = determineBlendFactor(config.srcBlend);
-        vk::BlendFactor dstBlendFac = determineBlendFactor(config.dstBlend);
+        return determineColorBlending(config.blendEnabled,config.srcBlend,config.dstBlend);
+   }
+
+   vk::PipelineColorBlendAttachmentState TGAVulkan::determineColorBlending(bool blendEnabled, BlendFactor srcBlend, BlendFactor dstBlend)
+   {
+        vk::Bool32 enabled = blendEnabled?VK_TRUE:VK_FALSE;
+        vk::BlendFactor srcBlendFac = determineBlendFactor(srcBlend);
+        vk::BlendFactor dstBlendFac = determineBlendFactor(dstBlend);
         return {enabled,srcBlendFac,dstBlendFac,vk::BlendOp::eAdd,srcBlendFac,dstBlendFac,vk::BlendOp::eAdd,
             vk::ColorComponentFlagBits::eR|vk::ColorComponentFlagBits::eG|vk::ColorComponentFlagBits::eB|vk::ColorComponentFlagBits::eA};
    }
@@ -863,6 +2508,7 @@ namespace tga
         {
             case BindingType::uniformBuffer: return vk::DescriptorType::eUniformBuffer;
             case BindingType::sampler2D: return vk::DescriptorType::eCombinedImageSampler;
+            case BindingType::storageBuffer: return vk::DescriptorType::eStorageBuffer;
             default: return vk::DescriptorType::eInputAttachment;
         }
    }
@@ -886,24 +2532,30 @@ namespace tga
     }
     vk::PipelineStageFlags TGAVulkan::layoutToPipelineStageFlags(vk::ImageLayout layout)
     {
+        const vk::PipelineStageFlags shaderStages = vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader|
+            vk::PipelineStageFlagBits::eComputeShader;
+        const vk::PipelineStageFlags depthStages = vk::PipelineStageFlagBits::eEarlyFragmentTests|vk::PipelineStageFlagBits::eLateFragmentTests;
         switch (layout)
         {
             case vk::ImageLayout::eUndefined: return vk::PipelineStageFlagBits::eTopOfPipe;
             case vk::ImageLayout::eTransferDstOptimal: return vk::PipelineStageFlagBits::eTransfer;
             case vk::ImageLayout::eTransferSrcOptimal: return vk::PipelineStageFlagBits::eTransfer;
-            case vk::ImageLayout::eShaderReadOnlyOptimal: return vk::PipelineStageFlagBits::eVertexShader;
-            case vk::ImageLayout::eColorAttachmentOptimal: return vk::PipelineStageFlagBits::eFragmentShader;
-            case vk::ImageLayout::ePresentSrcKHR: return vk::PipelineStageFlagBits::eAllGraphics;
-            case vk::ImageLayout::eGeneral: return vk::PipelineStageFlagBits::eAllCommands;
-            case vk::ImageLayout::eDepthStencilAttachmentOptimal: return vk::PipelineStageFlagBits::eEarlyFragmentTests;
-            case vk::ImageLayout::eDepthAttachmentOptimal: return vk::PipelineStageFlagBits::eEarlyFragmentTests;
-            case vk::ImageLayout::eStencilAttachmentOptimal: return vk::PipelineStageFlagBits::eEarlyFragmentTests;
+            case vk::ImageLayout::eShaderReadOnlyOptimal: return shaderStages;
+            case vk::ImageLayout::eColorAttachmentOptimal: return vk::PipelineStageFlagBits::eColorAttachmentOutput;
+            case vk::ImageLayout::ePresentSrcKHR: return vk::PipelineStageFlagBits::eBottomOfPipe;
+            case vk::ImageLayout::eGeneral: return shaderStages;
+            case vk::ImageLayout::eDepthStencilAttachmentOptimal: return depthStages;
+            case vk::ImageLayout::eDepthAttachmentOptimal: return depthStages;
+            case vk::ImageLayout::eStencilAttachmentOptimal: return depthStages;
             default: throw std::runtime_error("Layout to PipelineStageFlags transition not supported");
         }
     }
 
     vk::PipelineStageFlags TGAVulkan::accessToPipelineStageFlags(vk::AccessFlags accessFlags)
     {
+        const vk::PipelineStageFlags shaderStages = vk::PipelineStageFlagBits::eVertexShader|vk::PipelineStageFlagBits::eFragmentShader|
+            vk::PipelineStageFlagBits::eComputeShader;
+        const vk::PipelineStageFlags depthStages = vk::PipelineStageFlagBits::eEarlyFragmentTests|vk::PipelineStageFlagBits::eLateFragmentTests;
         if(accessFlags == vk::AccessFlags{})
             return vk::PipelineStageFlagBits::eTopOfPipe;
         vk::PipelineStageFlags pipelineStageFlags{};
@@ -914,11 +2566,11 @@ namespace tga
         if((accessFlags & vk::AccessFlagBits::eVertexAttributeRead )==vk::AccessFlagBits::eVertexAttributeRead)
             pipelineStageFlags |= vk::PipelineStageFlagBits::eVertexInput;
         if((accessFlags & vk::AccessFlagBits::eUniformRead )==vk::AccessFlagBits::eUniformRead)
-            pipelineStageFlags |= vk::PipelineStageFlagBits::eVertexShader;
+            pipelineStageFlags |= shaderStages;
         if((accessFlags & vk::AccessFlagBits::eShaderRead )==vk::AccessFlagBits::eShaderRead)
-            pipelineStageFlags |= vk::PipelineStageFlagBits::eVertexShader;
+            pipelineStageFlags |= shaderStages;
         if((accessFlags & vk::AccessFlagBits::eShaderWrite )==vk::AccessFlagBits::eShaderWrite)
-            pipelineStageFlags |= vk::PipelineStageFlagBits::eVertexShader;
+            pipelineStageFlags |= shaderStages;
         if((accessFlags & vk::AccessFlagBits::eInputAttachmentRead )==vk::AccessFlagBits::eInputAttachmentRead)
             pipelineStageFlags |= vk::PipelineStageFlagBits::eFragmentShader;
         if((accessFlags & vk::AccessFlagBits::eColorAttachmentRead )==vk::AccessFlagBits::eColorAttachmentRead)
@@ -926,9 +2578,9 @@ namespace tga
         if((accessFlags & vk::AccessFlagBits::eColorAttachmentWrite )==vk::AccessFlagBits::eColorAttachmentWrite)
             pipelineStageFlags |= vk::PipelineStageFlagBits::eColorAttachmentOutput;
         if((accessFlags & vk::AccessFlagBits::eDepthStencilAttachmentRead )==vk::AccessFlagBits::eDepthStencilAttachmentRead)
-            pipelineStageFlags |= vk::PipelineStageFlagBits::eEarlyFragmentTests;
+            pipelineStageFlags |= depthStages;
         if((accessFlags & vk::AccessFlagBits::eDepthStencilAttachmentWrite )==vk::AccessFlagBits::eDepthStencilAttachmentWrite)
-            pipelineStageFlags |= vk::PipelineStageFlagBits::eEarlyFragmentTests;
+            pipelineStageFlags |= depthStages;
         if((accessFlags & vk::AccessFlagBits::eTransferRead )==vk::AccessFlagBits::eTransferRead)
             pipelineStageFlags |= vk::PipelineStageFlagBits::eTransfer;
         if((accessFlags & vk::AccessFlagBits::eTransferWrite )==vk::AccessFlagBits::eTransferWrite)